@@ -0,0 +1,869 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "intrinsics.h"
+#if defined( _WIN32 )
+    #include "win32_platform.cpp"
+#else
+    #include "posix_platform.cpp"
+#endif
+
+#include "work_queue.cpp"
+#include "stats.cpp"
+#include "chunk_arena.cpp"
+#include "simd_scan.cpp"
+#include "string_intern.cpp"
+#include "parser.cpp"
+#include "msgpack.cpp"
+#include "declaration_encoder.cpp"
+#include "workspace_generator.cpp"
+
+#define BENCHMARK_MAX_THREADS    64
+#define BENCHMARK_REFRESH_RUNS   9
+#define BENCHMARK_ENCODE_RUNS    5
+#define BENCHMARK_ROUND_TRIPS    1000
+#define BENCHMARK_LARGE_HEADERS  16
+#define BENCHMARK_TOKENIZER_ROUNDS 40
+
+inline f64 GetSecondsElapsed( u64 start, u64 end, u64 frequency )
+{
+    f64 result = ( f64 ) ( end - start ) / ( f64 ) frequency;
+    return result;
+}
+
+inline f64 GetSecondsSince( u64 start, u64 frequency )
+{
+    return GetSecondsElapsed( start, ReadTimer(), frequency );
+}
+
+// NOTE: sorts the samples in place
+internal f64 GetPercentile( f64 *samples, u32 count, u32 percent )
+{
+    for ( u32 index = 1; index < count; ++index )
+    {
+        f64 value = samples[ index ];
+        u32 at = index;
+        while ( at > 0 && samples[ at - 1 ] > value )
+        {
+            samples[ at ] = samples[ at - 1 ];
+            --at;
+        }
+        samples[ at ] = value;
+    }
+
+    f64 result = 0;
+    if ( count > 0 )
+    {
+        u32 rank = ( u32 ) ( ( u64 ) ( count - 1 ) * percent / 100 );
+        result = samples[ rank ];
+    }
+    return result;
+}
+
+// NOTE: everything one run measured, printed as it goes and written out as JSON at the end
+struct Benchmark_Results
+{
+    char *directory;
+    bool generated;
+    Workspace_Config workspaceConfig;
+    Workspace_Summary workspace;
+    f64 generateSeconds;
+
+    u32 fileCount;
+    u64 declarationCount;
+
+    bool lazyDetails;
+    f64 detailsSeconds;
+
+    u32 threadRunCount;
+    u32 threads[ BENCHMARK_MAX_THREADS ];
+    f64 coldParseSeconds[ BENCHMARK_MAX_THREADS ];
+
+    f64 noOpRefreshSeconds;
+    f64 editRefreshSeconds;
+    bool editMeasured;
+
+    u64 encodedBytes;
+    f64 encodeSeconds;
+    f64 cachedEncodeSeconds;
+
+    u32 largeHeaderCount;
+    u64 largeHeaderBytes;
+    u64 largeHeaderTokens;
+    u64 largeHeaderParseTokens;
+    f64 largeHeaderParseSeconds;
+
+    u32 tokenizerKernelCount;
+    char *tokenizerKernels[ ScanLevel_Count ];
+    f64 tokenizerMegabytesPerSecond[ ScanLevel_Count ];
+    bool tokenizerMatches;
+
+    bool roundTripMeasured;
+    u32 roundTripCount;
+    f64 roundTripMedianMicroseconds;
+    f64 roundTripP99Microseconds;
+    f64 fullDeclarationsSeconds;
+    u64 fullDeclarationsBytes;
+};
+
+struct Tokenizer_Run
+{
+    u64 tokenCount;
+    u32 lineCount;
+};
+
+internal Tokenizer_Run TokenizeFiles( Mapped_File *files, u32 fileCount )
+{
+    Tokenizer_Run result = {};
+    for ( u32 fileIndex = 0; fileIndex < fileCount; ++fileIndex )
+    {
+        Tokenizer tokenizer = {};
+        tokenizer.at = files[ fileIndex ].content;
+        tokenizer.end = files[ fileIndex ].content + files[ fileIndex ].size;
+        while ( GetToken( &tokenizer ).type != Token_Type::EndOfStream )
+        {
+            ++result.tokenCount;
+        }
+        result.lineCount += tokenizer.lineCount;
+    }
+    return result;
+}
+
+// NOTE: raw GetToken throughput over every source file in the tree for each kernel level the CPU
+// supports. Point it at a directory of big headers (the Windows SDK, a large library) to get
+// numbers that aren't dominated by per-file overhead.
+internal void BenchmarkTokenizer( Parse_State *parseState, u64 frequency, Benchmark_Results *results )
+{
+    u32 fileCount = 0;
+    u64 totalBytes = 0;
+    Mapped_File *files = ( Mapped_File * ) PlatformAllocateMemory( parseState->fileCount * sizeof( Mapped_File ) );
+    for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+    {
+        File_State *file = parseState->files.states[ fileIndex ];
+        if ( fileCount < parseState->fileCount && MapEntireFile( file->name, files + fileCount ) )
+        {
+            totalBytes += files[ fileCount++ ].size;
+        }
+    }
+
+    if ( totalBytes == 0 )
+    {
+        printf( "No source files to tokenize\n" );
+        return;
+    }
+
+    // NOTE: about 32MB through each kernel set per round. The kernels take turns round by round and
+    // each one keeps its fastest round, so clock changes and other load hit all of them alike
+    // instead of whichever one happened to run at the time.
+    u32 repetitions = ( u32 ) ( Megabytes( 32 ) / totalBytes ) + 1;
+
+    printf( "\nTokenizer throughput over %u files, %.2f MB, best of %u rounds of %u repetitions\n", fileCount,
+            ( f64 ) totalBytes / Megabytes( 1 ), BENCHMARK_TOKENIZER_ROUNDS, repetitions );
+    printf( "%8s %10s %12s %8s\n", "kernels", "MB/s", "tokens", "check" );
+
+    Scan_Level selectedLevel = GetSelectedScanLevel();
+    u32 levelCount = ( u32 ) GetMaxScanLevel() + 1;
+    Tokenizer_Run runs[ ScanLevel_Count ];
+    u64 bestTicks[ ScanLevel_Count ];
+    for ( u32 level = ScanLevel_Scalar; level < levelCount; ++level )
+    {
+        SelectScanKernels( ( Scan_Level ) level );
+        runs[ level ] = TokenizeFiles( files, fileCount );
+        bestTicks[ level ] = 0;
+    }
+
+    for ( u32 round = 0; round < BENCHMARK_TOKENIZER_ROUNDS; ++round )
+    {
+        for ( u32 level = ScanLevel_Scalar; level < levelCount; ++level )
+        {
+            SelectScanKernels( ( Scan_Level ) level );
+            u64 start = ReadTimer();
+            for ( u32 repetition = 0; repetition < repetitions; ++repetition )
+            {
+                TokenizeFiles( files, fileCount );
+            }
+            u64 ticks = ReadTimer() - start;
+            if ( bestTicks[ level ] == 0 || ticks < bestTicks[ level ] )
+            {
+                bestTicks[ level ] = ticks;
+            }
+        }
+    }
+
+    results->tokenizerMatches = true;
+    for ( u32 level = ScanLevel_Scalar; level < levelCount; ++level )
+    {
+        f64 seconds = GetSecondsElapsed( 0, bestTicks[ level ], frequency );
+        f64 megabytesPerSecond = ( f64 ) totalBytes * repetitions / Megabytes( 1 ) / seconds;
+        Tokenizer_Run *run = runs + level;
+        bool matches = run->tokenCount == runs[ 0 ].tokenCount && run->lineCount == runs[ 0 ].lineCount;
+        char *name = GlobalScanKernelTable[ level ].name;
+        printf( "%8s %10.1f %12llu %8s%s\n", name, megabytesPerSecond, run->tokenCount, matches ? "ok" : "MISMATCH",
+                level == ( u32 ) selectedLevel ? "  (selected)" : "" );
+
+        results->tokenizerKernels[ results->tokenizerKernelCount ] = name;
+        results->tokenizerMegabytesPerSecond[ results->tokenizerKernelCount ] = megabytesPerSecond;
+        results->tokenizerKernelCount += 1;
+        results->tokenizerMatches = results->tokenizerMatches && matches;
+    }
+
+    SelectScanKernels( selectedLevel );
+    for ( u32 fileIndex = 0; fileIndex < fileCount; ++fileIndex )
+    {
+        UnmapFile( files + fileIndex );
+    }
+    PlatformFreeMemory( files );
+}
+
+// NOTE: how often the parser tokenizes the same bytes. The largest headers are parsed again on their
+// own and the tokens the parse asked for are compared with a plain tokenizer pass over the same files,
+// a single pass parser asks for exactly as many.
+internal void BenchmarkParseTokens( Parse_State *parseState, u64 frequency, Benchmark_Results *results )
+{
+    File_State *headers[ BENCHMARK_LARGE_HEADERS ];
+    u32 headerCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+    {
+        File_State *file = parseState->files.states[ fileIndex ];
+        if ( file->removed || !StringEndsWith( file->name, ".h" ) )
+        {
+            continue;
+        }
+
+        // NOTE: insertion into a short list sorted by size, largest first
+        u32 at = headerCount < BENCHMARK_LARGE_HEADERS ? headerCount++ : BENCHMARK_LARGE_HEADERS;
+        while ( at > 0 && headers[ at - 1 ]->fileSize < file->fileSize )
+        {
+            if ( at < BENCHMARK_LARGE_HEADERS )
+            {
+                headers[ at ] = headers[ at - 1 ];
+            }
+            --at;
+        }
+        if ( at < BENCHMARK_LARGE_HEADERS )
+        {
+            headers[ at ] = file;
+        }
+    }
+
+    if ( headerCount == 0 )
+    {
+        return;
+    }
+
+    u64 parseTicks = 0;
+    for ( u32 headerIndex = 0; headerIndex < headerCount; ++headerIndex )
+    {
+        Mapped_File source;
+        if ( !MapEntireFile( headers[ headerIndex ]->name, &source ) )
+        {
+            continue;
+        }
+        results->largeHeaderTokens += TokenizeFiles( &source, 1 ).tokenCount;
+        results->largeHeaderBytes += source.size;
+        UnmapFile( &source );
+
+        File_State file = {};
+        file.name = headers[ headerIndex ]->name;
+        u64 tokensBefore = GetCounter( StatCounter_TokensParsed );
+        u64 start = ReadTimer();
+        ParseFile( &file );
+        parseTicks += ReadTimer() - start;
+        results->largeHeaderParseTokens += GetCounter( StatCounter_TokensParsed ) - tokensBefore;
+        results->largeHeaderCount += 1;
+        ResetChunkedArena( &file.arena );
+    }
+    results->largeHeaderParseSeconds = GetSecondsElapsed( 0, parseTicks, frequency );
+
+    f64 bytes = ( f64 ) results->largeHeaderBytes;
+    printf( "\nParse of the %u largest headers, %.2f MB in %.3f ms\n", results->largeHeaderCount, bytes / Megabytes( 1 ),
+            results->largeHeaderParseSeconds * 1000.0 );
+    printf( "%12llu tokens in the source, %.4f per byte\n", results->largeHeaderTokens, ( f64 ) results->largeHeaderTokens / bytes );
+    printf( "%12llu tokens read by the parser, %.4f per byte, %.2fx the source\n", results->largeHeaderParseTokens,
+            ( f64 ) results->largeHeaderParseTokens / bytes, ( f64 ) results->largeHeaderParseTokens / ( f64 ) results->largeHeaderTokens );
+}
+
+// NOTE: a refresh where nothing changed on disk, this is what every poll from an idle editor costs
+internal void BenchmarkNoOpRefresh( Parse_State *parseState, Memory_Arena *arena, char *directory, u64 frequency, Benchmark_Results *results )
+{
+    f64 samples[ BENCHMARK_REFRESH_RUNS ];
+    for ( u32 run = 0; run < BENCHMARK_REFRESH_RUNS; ++run )
+    {
+        u64 start = ReadTimer();
+        ParseFiles( parseState, arena, directory );
+        samples[ run ] = GetSecondsSince( start, frequency );
+    }
+    results->noOpRefreshSeconds = GetPercentile( samples, BENCHMARK_REFRESH_RUNS, 50 );
+    printf( "No-op refresh: %.3f ms\n", results->noOpRefreshSeconds * 1000.0 );
+}
+
+// NOTE: only on generated trees, it rewrites one of the files. Every run alternates between the
+// original content and one with an extra function, so each refresh has exactly one file to reparse.
+internal void BenchmarkEditRefresh( Parse_State *parseState, Memory_Arena *arena, char *directory, u64 frequency, Benchmark_Results *results )
+{
+    File_State *target = 0;
+    for ( u32 fileIndex = 0; fileIndex < parseState->files.count && !target; ++fileIndex )
+    {
+        if ( !parseState->files.states[ fileIndex ]->removed )
+        {
+            target = parseState->files.states[ fileIndex ];
+        }
+    }
+
+    Mapped_File source;
+    if ( !target || !MapEntireFile( target->name, &source ) )
+    {
+        return;
+    }
+
+    u32 originalSize = source.size;
+    char *edited = ( char * ) PlatformAllocateMemory( originalSize + Kilobytes( 1 ) );
+    if ( originalSize )
+    {
+        memcpy( edited, source.content, originalSize );
+    }
+    UnmapFile( &source );
+
+    char *addition = "\ninternal u32 BenchmarkEditedFunction( u32 value )\n{\n    return value + 1;\n}\n";
+    u32 additionLength = ( u32 ) strlen( addition );
+    memcpy( edited + originalSize, addition, additionLength );
+
+    f64 samples[ BENCHMARK_REFRESH_RUNS ];
+    u32 sampleCount = 0;
+    for ( u32 run = 0; run < BENCHMARK_REFRESH_RUNS; ++run )
+    {
+        u32 size = ( run & 1 ) ? originalSize : originalSize + additionLength;
+        if ( !PlatformWriteEntireFile( target->name, edited, size ) )
+        {
+            break;
+        }
+
+        u64 start = ReadTimer();
+        ParseFiles( parseState, arena, directory );
+        samples[ sampleCount++ ] = GetSecondsSince( start, frequency );
+    }
+
+    // NOTE: an odd run count ends on the original content, write it back anyway in case a write failed
+    PlatformWriteEntireFile( target->name, edited, originalSize );
+    PlatformFreeMemory( edited );
+
+    if ( sampleCount > 0 )
+    {
+        results->editMeasured = true;
+        results->editRefreshSeconds = GetPercentile( samples, sampleCount, 50 );
+        printf( "Single file edit refresh: %.3f ms\n", results->editRefreshSeconds * 1000.0 );
+    }
+}
+
+// NOTE: a full GetDeclarations snapshot, once encoded from the tables and once from the per file
+// fragments the server caches after the first request
+internal void BenchmarkEncode( Parse_State *parseState, u64 frequency, Benchmark_Results *results )
+{
+    MP_Block_Pool pool = {};
+    f64 samples[ BENCHMARK_ENCODE_RUNS ];
+
+    for ( u32 cached = 0; cached < 2; ++cached )
+    {
+        for ( u32 run = 0; run < BENCHMARK_ENCODE_RUNS; ++run )
+        {
+            u64 start = ReadTimer();
+
+            MP_Encoder encoder = {};
+            BeginEncoder( &encoder, &pool );
+            if ( cached )
+            {
+                EncodeDeclarationsDelta( parseState, parseState->epoch, 0, &encoder );
+            }
+            else
+            {
+                EncodeMap( parseState->fileCount, &encoder );
+                for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+                {
+                    File_State *file = parseState->files.states[ fileIndex ];
+                    if ( !file->removed )
+                    {
+                        EncodeString( file->name, &encoder );
+                        EncodeFileDeclarations( file, &encoder );
+                    }
+                }
+            }
+            CloseEncoderRun( &encoder );
+
+            samples[ run ] = GetSecondsSince( start, frequency );
+            if ( !cached )
+            {
+                results->encodedBytes = encoder.length;
+            }
+            EndEncoder( &encoder );
+        }
+
+        if ( cached )
+        {
+            results->cachedEncodeSeconds = GetPercentile( samples, BENCHMARK_ENCODE_RUNS, 50 );
+        }
+        else
+        {
+            results->encodeSeconds = GetPercentile( samples, BENCHMARK_ENCODE_RUNS, 50 );
+        }
+    }
+    ReleaseBlockPool( &pool );
+
+    f64 megabytes = ( f64 ) results->encodedBytes / Megabytes( 1 );
+    printf( "Encode all declarations: %.2f MB, %.3f ms (%.1f MB/s), from cached fragments %.3f ms (%.1f MB/s)\n",
+            megabytes, results->encodeSeconds * 1000.0, megabytes / results->encodeSeconds,
+            results->cachedEncodeSeconds * 1000.0, megabytes / results->cachedEncodeSeconds );
+}
+
+// NOTE: lazy mode moves the argument and field extraction out of the cold parse, this is what it
+// costs when every file's details end up being asked for
+internal void BenchmarkDetails( Parse_State *parseState, u64 frequency, Benchmark_Results *results )
+{
+    u64 start = ReadTimer();
+    u32 resolvedCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+    {
+        File_State *file = parseState->files.states[ fileIndex ];
+        if ( file->detailsPending && ParseFileDetails( file ) )
+        {
+            resolvedCount += 1;
+        }
+    }
+    results->detailsSeconds = GetSecondsSince( start, frequency );
+    printf( "Details of every file: %u files in %.3f ms\n", resolvedCount, results->detailsSeconds * 1000.0 );
+}
+
+internal bool SendWholeEncoder( Platform_Socket connection, MP_Encoder *encoder, u8 *buffer )
+{
+    CopyEncoderOutput( encoder, buffer );
+    return PlatformSend( connection, buffer, encoder->length );
+}
+
+// NOTE: reads until one complete message is in the buffer, returns its size or 0 on failure
+internal u32 ReceiveMessage( Platform_Socket connection, u8 *buffer, u32 bufferSize )
+{
+    MP_Frame_Scanner scanner;
+    ResetFrameScanner( &scanner );
+    u32 received = 0;
+    for ( ;; )
+    {
+        MP_Frame_Result frame = ScanFrame( &scanner, buffer, received );
+        if ( frame == MP_Frame_Complete )
+        {
+            return scanner.offset;
+        }
+        if ( frame == MP_Frame_Invalid || received == bufferSize )
+        {
+            return 0;
+        }
+
+        int result = PlatformReceive( connection, buffer + received, bufferSize - received );
+        if ( result <= 0 )
+        {
+            return 0;
+        }
+        received += ( u32 ) result;
+    }
+}
+
+// NOTE: against a server that is already running, round trips of a small request back to back
+// and one full GetDeclarations snapshot. The server has to be serving the same tree to compare.
+internal void BenchmarkRoundTrip( char *port, u64 frequency, Benchmark_Results *results )
+{
+    if ( !PlatformInitializeSockets() )
+    {
+        return;
+    }
+
+    Platform_Socket connection = PlatformConnect( "localhost", port );
+    if ( connection == PLATFORM_INVALID_SOCKET )
+    {
+        printf( "Could not connect to the server on port %s\n", port );
+        PlatformShutdownSockets();
+        return;
+    }
+
+    u32 bufferSize = ( u32 ) MAX_REQUEST_SIZE;
+    u8 *buffer = ( u8 * ) PlatformAllocateMemory( bufferSize );
+    MP_Block_Pool pool = {};
+    f64 *samples = ( f64 * ) PlatformAllocateMemory( BENCHMARK_ROUND_TRIPS * sizeof( f64 ) );
+
+    bool ok = true;
+    u32 roundTrips = 0;
+    for ( u32 requestIndex = 0; ok && requestIndex < BENCHMARK_ROUND_TRIPS + 1; ++requestIndex )
+    {
+        bool full = requestIndex == BENCHMARK_ROUND_TRIPS;
+        MP_Encoder encoder = {};
+        BeginEncoder( &encoder, &pool );
+        EncodeArray( 4, &encoder );
+        EncodeUInt( 0, &encoder );
+        EncodeUInt( requestIndex, &encoder );
+        EncodeString( ( char * ) ( full ? "GetDeclarations" : "GoToDefinition" ), &encoder );
+        EncodeArray( 1, &encoder );
+        if ( full )
+        {
+            EncodeUInt( 0, &encoder );
+        }
+        else
+        {
+            EncodeString( "SharedFunction1", &encoder );
+        }
+
+        u64 start = ReadTimer();
+        ok = SendWholeEncoder( connection, &encoder, buffer );
+        EndEncoder( &encoder );
+        u32 responseSize = ok ? ReceiveMessage( connection, buffer, bufferSize ) : 0;
+        f64 seconds = GetSecondsSince( start, frequency );
+        ok = responseSize > 0;
+
+        if ( ok && full )
+        {
+            results->fullDeclarationsSeconds = seconds;
+            results->fullDeclarationsBytes = responseSize;
+        }
+        else if ( ok )
+        {
+            samples[ roundTrips++ ] = seconds * 1000000.0;
+        }
+    }
+
+    if ( roundTrips > 0 )
+    {
+        results->roundTripMeasured = true;
+        results->roundTripCount = roundTrips;
+        results->roundTripMedianMicroseconds = GetPercentile( samples, roundTrips, 50 );
+        results->roundTripP99Microseconds = GetPercentile( samples, roundTrips, 99 );
+        printf( "\nRound trip over %u requests: median %.1f us, p99 %.1f us\n", roundTrips,
+                results->roundTripMedianMicroseconds, results->roundTripP99Microseconds );
+    }
+    if ( results->fullDeclarationsBytes )
+    {
+        printf( "Full GetDeclarations: %.2f MB in %.3f ms\n", ( f64 ) results->fullDeclarationsBytes / Megabytes( 1 ),
+                results->fullDeclarationsSeconds * 1000.0 );
+    }
+
+    ReleaseBlockPool( &pool );
+    PlatformFreeMemory( samples );
+    PlatformFreeMemory( buffer );
+    PlatformCloseSocket( connection );
+    PlatformShutdownSockets();
+}
+
+inline void WriteJsonString( FILE *file, char *text )
+{
+    fputc( '"', file );
+    for ( char *at = text; *at; ++at )
+    {
+        if ( *at == '"' || *at == '\\' )
+        {
+            fputc( '\\', file );
+        }
+        fputc( *at, file );
+    }
+    fputc( '"', file );
+}
+
+// NOTE: one flat document per run, times in seconds unless the key says otherwise
+internal bool WriteJsonResults( char *path, Benchmark_Results *results )
+{
+    FILE *file = 0;
+    if ( fopen_s( &file, path, "wb" ) != 0 || !file )
+    {
+        printf( "Failed to write %s\n", path );
+        return false;
+    }
+
+    fprintf( file, "{\n  \"directory\": " );
+    WriteJsonString( file, results->directory );
+    fprintf( file, ",\n  \"files\": %u,\n  \"declarations\": %llu,\n", results->fileCount, results->declarationCount );
+
+    if ( results->generated )
+    {
+        Workspace_Config *config = &results->workspaceConfig;
+        fprintf( file, "  \"generated\": { \"files\": %u, \"directories\": %u, \"bytes\": %llu, \"declarations\": %llu, "
+                       "\"file_size\": %u, \"density\": %u, \"macro_header_percent\": %u, \"depth\": %u, \"nesting\": %u, "
+                       "\"seed\": %u, \"seconds\": %.6f },\n",
+                 results->workspace.fileCount, results->workspace.directoryCount, results->workspace.totalBytes,
+                 results->workspace.declarationCount, config->fileSize, config->declarationDensity, config->macroHeaderPercent,
+                 config->directoryDepth, config->blockNesting, config->seed, results->generateSeconds );
+    }
+
+    fprintf( file, "  \"lazy_details\": %s,\n", results->lazyDetails ? "true" : "false" );
+    if ( results->lazyDetails )
+    {
+        fprintf( file, "  \"details_seconds\": %.6f,\n", results->detailsSeconds );
+    }
+
+    fprintf( file, "  \"cold_parse\": [" );
+    for ( u32 runIndex = 0; runIndex < results->threadRunCount; ++runIndex )
+    {
+        fprintf( file, "%s\n    { \"threads\": %u, \"seconds\": %.6f }", runIndex ? "," : "", results->threads[ runIndex ],
+                 results->coldParseSeconds[ runIndex ] );
+    }
+    fprintf( file, "\n  ],\n" );
+
+    fprintf( file, "  \"no_op_refresh_seconds\": %.6f,\n", results->noOpRefreshSeconds );
+    if ( results->editMeasured )
+    {
+        fprintf( file, "  \"edit_refresh_seconds\": %.6f,\n", results->editRefreshSeconds );
+    }
+    fprintf( file, "  \"encode\": { \"bytes\": %llu, \"seconds\": %.6f, \"cached_seconds\": %.6f },\n",
+             results->encodedBytes, results->encodeSeconds, results->cachedEncodeSeconds );
+
+    if ( results->largeHeaderCount )
+    {
+        fprintf( file, "  \"large_headers\": { \"files\": %u, \"bytes\": %llu, \"source_tokens\": %llu, \"parse_tokens\": %llu, "
+                       "\"parse_tokens_per_byte\": %.4f, \"seconds\": %.6f },\n",
+                 results->largeHeaderCount, results->largeHeaderBytes, results->largeHeaderTokens, results->largeHeaderParseTokens,
+                 ( f64 ) results->largeHeaderParseTokens / ( f64 ) results->largeHeaderBytes, results->largeHeaderParseSeconds );
+    }
+
+    fprintf( file, "  \"tokenizer\": { \"matches\": %s, \"kernels\": [", results->tokenizerMatches ? "true" : "false" );
+    for ( u32 kernelIndex = 0; kernelIndex < results->tokenizerKernelCount; ++kernelIndex )
+    {
+        fprintf( file, "%s { \"name\": ", kernelIndex ? "," : "" );
+        WriteJsonString( file, results->tokenizerKernels[ kernelIndex ] );
+        fprintf( file, ", \"megabytes_per_second\": %.1f }", results->tokenizerMegabytesPerSecond[ kernelIndex ] );
+    }
+    fprintf( file, " ] }" );
+
+    if ( results->roundTripMeasured )
+    {
+        fprintf( file, ",\n  \"round_trip\": { \"requests\": %u, \"median_us\": %.1f, \"p99_us\": %.1f, "
+                       "\"full_declarations_bytes\": %llu, \"full_declarations_seconds\": %.6f }",
+                 results->roundTripCount, results->roundTripMedianMicroseconds, results->roundTripP99Microseconds,
+                 results->fullDeclarationsBytes, results->fullDeclarationsSeconds );
+    }
+
+    fprintf( file, ",\n  \"phases\": {" );
+    for ( u32 phase = 0; phase < StatPhase_Count; ++phase )
+    {
+        Latency_Summary summary = SummarizeLatency( ( Stat_Phase ) phase );
+        fprintf( file, "%s\n    \"%s\": { \"count\": %llu, \"total_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu }",
+                 phase ? "," : "", StatPhaseNames[ phase ], summary.count, summary.totalNanoseconds, summary.p50Nanoseconds,
+                 summary.p99Nanoseconds, summary.maxNanoseconds );
+    }
+    fprintf( file, "\n  }\n}\n" );
+
+    fclose( file );
+    printf( "\nResults written to %s\n", path );
+    return true;
+}
+
+// NOTE: parses the whole tree from scratch with 1 to N cores and reports the speedup over one core,
+// then measures refreshes, encoding and the tokenizer on the last run's state
+// usage: nvim-cpp-bench.exe [directory] [max threads] [options]
+//   --generate files       write a synthetic tree with that many files into directory first
+//   --file-size bytes      average size of a generated file, 16384 by default
+//   --density n            declarations per KB of generated source, 4 by default
+//   --macro-headers pct    share of generated headers that are mostly macros, 10 by default
+//   --depth n              directory levels of the generated tree, 3 by default
+//   --nesting n            block nesting inside generated function bodies, 3 by default
+//   --server port          also measure round trips against a server running on localhost
+//   --json path            write the results as JSON
+//   --lazy-details         leave arguments and fields out of the parse like the server's --lazy-details,
+//                          and measure filling them in for every file afterwards
+//   --scan-kernels name    tokenizer kernels for the parse runs, like the server's --scan-kernels,
+//                          the tokenizer measurement still runs every kernel set
+// The edit refresh rewrites one file, so it only runs on trees made with --generate.
+int main( int argc, char **argv )
+{
+    InitializeStats();
+    InitializeScanKernels();
+
+    local_persist Benchmark_Results results;
+    char directory[ 256 ] = {};
+    u32 maxThreads = PlatformGetProcessorCount();
+    char *jsonPath = 0;
+    char *serverPort = 0;
+
+    Workspace_Config workspaceConfig = {};
+    workspaceConfig.fileSize = Kilobytes( 16 );
+    workspaceConfig.declarationDensity = 4;
+    workspaceConfig.macroHeaderPercent = 10;
+    workspaceConfig.directoryDepth = 3;
+    workspaceConfig.blockNesting = 3;
+
+    u32 positionalCount = 0;
+    for ( int argumentIndex = 1; argumentIndex < argc; ++argumentIndex )
+    {
+        char *argument = argv[ argumentIndex ];
+        char *value = argumentIndex + 1 < argc ? argv[ argumentIndex + 1 ] : 0;
+        if ( strcmp( argument, "--lazy-details" ) == 0 )
+        {
+            GlobalLazyDetails = true;
+            results.lazyDetails = true;
+            continue;
+        }
+        if ( argument[ 0 ] == '-' && argument[ 1 ] == '-' && !value )
+        {
+            printf( "Missing value for %s\n", argument );
+            return 1;
+        }
+
+        if ( strcmp( argument, "--generate" ) == 0 ) { workspaceConfig.fileCount = ( u32 ) atoi( value ); ++argumentIndex; }
+        else if ( strcmp( argument, "--file-size" ) == 0 ) { workspaceConfig.fileSize = ( u32 ) atoi( value ); ++argumentIndex; }
+        else if ( strcmp( argument, "--density" ) == 0 ) { workspaceConfig.declarationDensity = ( u32 ) atoi( value ); ++argumentIndex; }
+        else if ( strcmp( argument, "--macro-headers" ) == 0 ) { workspaceConfig.macroHeaderPercent = ( u32 ) atoi( value ); ++argumentIndex; }
+        else if ( strcmp( argument, "--depth" ) == 0 ) { workspaceConfig.directoryDepth = ( u32 ) atoi( value ); ++argumentIndex; }
+        else if ( strcmp( argument, "--nesting" ) == 0 ) { workspaceConfig.blockNesting = ( u32 ) atoi( value ); ++argumentIndex; }
+        else if ( strcmp( argument, "--server" ) == 0 ) { serverPort = value; ++argumentIndex; }
+        else if ( strcmp( argument, "--json" ) == 0 ) { jsonPath = value; ++argumentIndex; }
+        else if ( strcmp( argument, "--scan-kernels" ) == 0 )
+        {
+            Scan_Level level;
+            if ( !FindScanLevel( value, &level ) )
+            {
+                printf( "Unknown tokenizer kernels %s\n", value );
+                return 1;
+            }
+            SelectScanKernels( level );
+            ++argumentIndex;
+        }
+        else if ( positionalCount == 0 )
+        {
+            strcpy_s( directory, sizeof( directory ), argument );
+            ++positionalCount;
+        }
+        else if ( positionalCount == 1 )
+        {
+            maxThreads = ( u32 ) atoi( argument );
+            ++positionalCount;
+        }
+    }
+
+    if ( !directory[ 0 ] )
+    {
+        PlatformGetCurrentDirectory( directory, sizeof( directory ) );
+    }
+    if ( maxThreads < 1 )
+    {
+        maxThreads = 1;
+    }
+    if ( maxThreads >= BENCHMARK_MAX_THREADS )
+    {
+        maxThreads = BENCHMARK_MAX_THREADS - 1;
+    }
+    InitializeInternTable( maxThreads );
+    results.directory = directory;
+
+    u64 frequency = GlobalStats.timerFrequency;
+
+    if ( workspaceConfig.fileCount > 0 )
+    {
+        u64 start = ReadTimer();
+        if ( !GenerateWorkspace( directory, &workspaceConfig, &results.workspace ) )
+        {
+            printf( "Failed to generate the workspace in %s\n", directory );
+            return 1;
+        }
+        results.generateSeconds = GetSecondsSince( start, frequency );
+        results.generated = true;
+        results.workspaceConfig = workspaceConfig;
+        printf( "Generated %u files, %.2f MB, %llu declarations in %s (%.2f s)\n\n", results.workspace.fileCount,
+                ( f64 ) results.workspace.totalBytes / Megabytes( 1 ), results.workspace.declarationCount, directory,
+                results.generateSeconds );
+    }
+
+    memory_index memorySize = Gigabytes( 2 );
+    void *memoryBase = PlatformAllocateMemory( memorySize );
+    if ( !memoryBase )
+    {
+        printf( "Failed to allocate benchmark memory\n" );
+        return 1;
+    }
+
+    // NOTE: worker threads never exit, so every run gets its own queue outside the arena we reset
+    Work_Queue *queues = ( Work_Queue * ) PlatformAllocateMemory( ( maxThreads + 1 ) * sizeof( Work_Queue ) );
+
+    GlobalLogParsing = false;
+
+    printf( "Cold parse of %s\n", directory );
+    printf( "%8s %10s %8s %8s\n", "threads", "seconds", "files", "speedup" );
+
+    f64 singleThreadSeconds = 0;
+    // NOTE: run 0 only warms up the OS file cache so every measured run reads from memory
+    for ( u32 threadCount = 0; threadCount <= maxThreads; ++threadCount )
+    {
+        Memory_Arena arena;
+        InitializeArena( &arena, memorySize, memoryBase );
+
+        Parse_State *parseState = PushStruct( &arena, Parse_State );
+        parseState->workQueue = queues + threadCount;
+        InitializeWorkQueue( parseState->workQueue, threadCount > 0 ? threadCount - 1 : maxThreads - 1 );
+
+        // NOTE: the pool keeps the strings of earlier runs, only count what this run asked for
+        Intern_Stats statsBefore = GetInternStats();
+
+        u64 start = ReadTimer();
+        ParseFiles( parseState, &arena, directory );
+        u64 end = ReadTimer();
+
+        f64 seconds = GetSecondsElapsed( start, end, frequency );
+        if ( threadCount == 1 )
+        {
+            singleThreadSeconds = seconds;
+        }
+
+        if ( threadCount > 0 )
+        {
+            printf( "%8u %10.4f %8u %7.2fx\n", threadCount, seconds, parseState->fileCount, singleThreadSeconds / seconds );
+            results.threads[ results.threadRunCount ] = threadCount;
+            results.coldParseSeconds[ results.threadRunCount ] = seconds;
+            results.threadRunCount += 1;
+        }
+
+        if ( threadCount == maxThreads )
+        {
+            results.fileCount = parseState->fileCount;
+            for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+            {
+                results.declarationCount += parseState->files.states[ fileIndex ]->declarations.count;
+            }
+
+            Intern_Stats stats = GetInternStats();
+            stats.requestCount -= statsBefore.requestCount;
+            stats.requestedBytes -= statsBefore.requestedBytes;
+            printf( "\n" );
+            PrintInternStats( stats );
+            PrintChunkPoolStats( GetChunkPoolStats() );
+
+            printf( "\n" );
+            BenchmarkNoOpRefresh( parseState, &arena, directory, frequency, &results );
+            if ( results.generated )
+            {
+                BenchmarkEditRefresh( parseState, &arena, directory, frequency, &results );
+            }
+            BenchmarkEncode( parseState, frequency, &results );
+            if ( results.lazyDetails )
+            {
+                BenchmarkDetails( parseState, frequency, &results );
+            }
+            BenchmarkParseTokens( parseState, frequency, &results );
+            BenchmarkTokenizer( parseState, frequency, &results );
+
+            printf( "\nPhase timings over every run\n" );
+            PrintStats();
+        }
+
+        // NOTE: the file states go away with the arena, give their chunks back so the next run reuses them
+        for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+        {
+            File_State *file = parseState->files.states[ fileIndex ];
+            ResetChunkedArena( &file->arena );
+        }
+        ReleaseFileTable( &parseState->files );
+        memset( memoryBase, 0, arena.used );
+    }
+
+    if ( serverPort )
+    {
+        BenchmarkRoundTrip( serverPort, frequency, &results );
+    }
+
+    if ( jsonPath )
+    {
+        WriteJsonResults( jsonPath, &results );
+    }
+
+    return 0;
+}
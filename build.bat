@@ -2,7 +2,6 @@
 if not exist build mkdir build
 
 set compiler_args=^
--Fe:"nvim-cpp.exe" ^
 -nologo ^
 -GR- ^
 -EHa- ^
@@ -24,6 +23,10 @@ set linker_libs=Ws2_32.lib Shell32.lib
 
 pushd build
 
-cl %compiler_args% -MTd  ../main.cpp /link %linker_args% %linker_libs% && echo Build succesfull || echo Build failed
+cl %compiler_args% -Fe:"nvim-cpp.exe" -MTd  ../main.cpp /link %linker_args% %linker_libs% && echo Build succesfull || echo Build failed
+cl %compiler_args% -Fe:"nvim-cpp-bench.exe" -MTd  ../benchmark.cpp /link %linker_args% Ws2_32.lib && echo Benchmark build succesfull || echo Benchmark build failed
+cl %compiler_args% -Fe:"nvim-cpp-parser-tests.exe" -MTd  ../parser_tests.cpp /link %linker_args% && echo Parser tests build succesfull || echo Parser tests build failed
+cl %compiler_args% -Fe:"nvim-cpp-msgpack-tests.exe" -MTd  ../msgpack_tests.cpp /link %linker_args% && echo Msgpack tests build succesfull || echo Msgpack tests build failed
+cl %compiler_args% -Fe:"nvim-cpp-state-tests.exe" -MTd  ../state_tests.cpp /link %linker_args% && echo State tests build succesfull || echo State tests build failed
 
 popd
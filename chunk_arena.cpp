@@ -0,0 +1,196 @@
+// NOTE: per file arenas are a list of chunks taken from a global pool instead of a fixed block
+// carved out of the main arena. A file grows by whatever it needs, and resetting or dropping it
+// hands its chunks back to the pool's free list for the next file to reuse. Pushes only clear the
+// bytes they hand out, so a reparse doesn't pay for zeroing memory it never touches.
+//
+// Standard chunks are recycled, a push bigger than a standard chunk gets a dedicated chunk that
+// goes back to the OS when it is released.
+
+struct Arena_Chunk
+{
+    Arena_Chunk *next;
+    memory_index size;
+    memory_index used;
+};
+
+// NOTE: one page with both headers, most files keep their declarations in a single allocation that fits
+#define ARENA_CHUNK_SIZE            ( Kilobytes( 4 ) - sizeof( Arena_Chunk ) - PLATFORM_ALLOCATION_HEADER )
+#define CHUNK_POOL_MAX_FREE_BYTES   Megabytes( 64 )
+
+struct Chunked_Arena
+{
+    Arena_Chunk *current;
+    memory_index used;
+};
+
+struct Chunk_Pool
+{
+    u32 volatile lock;
+
+    Arena_Chunk *freeList;
+    u32 freeCount;
+    u32 chunkCount;
+
+    memory_index committedBytes;
+    memory_index inUseBytes;
+    memory_index peakCommittedBytes;
+    memory_index peakInUseBytes;
+};
+
+struct Chunk_Pool_Stats
+{
+    u32 chunkCount;
+    u32 freeCount;
+    // NOTE: in use is what arenas hold right now, committed adds the free list
+    memory_index inUseBytes;
+    memory_index freeBytes;
+    memory_index committedBytes;
+    memory_index peakInUseBytes;
+    memory_index peakCommittedBytes;
+};
+
+global_variable Chunk_Pool GlobalChunkPool;
+
+// NOTE: what the OS actually maps for the chunk, committed bytes are reported from this
+inline memory_index ChunkAllocationSize( Arena_Chunk *chunk )
+{
+    return PLATFORM_ALLOCATION_HEADER + sizeof( Arena_Chunk ) + chunk->size;
+}
+
+internal Arena_Chunk *AcquireChunk( memory_index minimumSize )
+{
+    Chunk_Pool *pool = &GlobalChunkPool;
+    Arena_Chunk *result = 0;
+
+    AcquireSpinLock( &pool->lock );
+    if ( minimumSize <= ARENA_CHUNK_SIZE && pool->freeList )
+    {
+        result = pool->freeList;
+        pool->freeList = result->next;
+        pool->freeCount -= 1;
+    }
+    ReleaseSpinLock( &pool->lock );
+
+    if ( !result )
+    {
+        memory_index size = minimumSize > ARENA_CHUNK_SIZE ? minimumSize : ARENA_CHUNK_SIZE;
+        result = ( Arena_Chunk * ) PlatformAllocateMemory( sizeof( Arena_Chunk ) + size );
+        if ( !result )
+        {
+            return 0;
+        }
+        result->size = size;
+
+        AcquireSpinLock( &pool->lock );
+        pool->chunkCount += 1;
+        pool->committedBytes += ChunkAllocationSize( result );
+        if ( pool->committedBytes > pool->peakCommittedBytes )
+        {
+            pool->peakCommittedBytes = pool->committedBytes;
+        }
+        ReleaseSpinLock( &pool->lock );
+    }
+
+    result->next = 0;
+    result->used = 0;
+
+    AcquireSpinLock( &pool->lock );
+    pool->inUseBytes += ChunkAllocationSize( result );
+    if ( pool->inUseBytes > pool->peakInUseBytes )
+    {
+        pool->peakInUseBytes = pool->inUseBytes;
+    }
+    ReleaseSpinLock( &pool->lock );
+
+    return result;
+}
+
+internal void ReleaseChunk( Arena_Chunk *chunk )
+{
+    Chunk_Pool *pool = &GlobalChunkPool;
+    memory_index allocationSize = ChunkAllocationSize( chunk );
+
+    AcquireSpinLock( &pool->lock );
+    pool->inUseBytes -= allocationSize;
+
+    // NOTE: the free list is capped so deleting a big tree doesn't pin its memory forever
+    bool keep = chunk->size == ARENA_CHUNK_SIZE && ( pool->freeCount + 1 ) * allocationSize <= CHUNK_POOL_MAX_FREE_BYTES;
+    if ( keep )
+    {
+        chunk->next = pool->freeList;
+        pool->freeList = chunk;
+        pool->freeCount += 1;
+    }
+    else
+    {
+        pool->chunkCount -= 1;
+        pool->committedBytes -= allocationSize;
+    }
+    ReleaseSpinLock( &pool->lock );
+
+    if ( !keep )
+    {
+        PlatformFreeMemory( chunk );
+    }
+}
+
+inline void *_PushSize( Chunked_Arena *arena, memory_index size )
+{
+    // NOTE: keep everything 8 byte aligned, the chunk header already is
+    size = ( size + 7 ) & ~( memory_index ) 7;
+
+    Arena_Chunk *chunk = arena->current;
+    if ( !chunk || chunk->used + size > chunk->size )
+    {
+        // NOTE: the tail of the old chunk is wasted, it is less than one declaration
+        chunk = AcquireChunk( size );
+        Assert( chunk );
+        chunk->next = arena->current;
+        arena->current = chunk;
+    }
+
+    void *result = ( u8 * ) ( chunk + 1 ) + chunk->used;
+    memset( result, 0, size );
+    chunk->used += size;
+    arena->used += size;
+    return result;
+}
+
+internal void ResetChunkedArena( Chunked_Arena *arena )
+{
+    Arena_Chunk *chunk = arena->current;
+    while ( chunk )
+    {
+        Arena_Chunk *next = chunk->next;
+        ReleaseChunk( chunk );
+        chunk = next;
+    }
+    arena->current = 0;
+    arena->used = 0;
+}
+
+internal Chunk_Pool_Stats GetChunkPoolStats()
+{
+    Chunk_Pool *pool = &GlobalChunkPool;
+    Chunk_Pool_Stats result = {};
+
+    AcquireSpinLock( &pool->lock );
+    result.chunkCount = pool->chunkCount;
+    result.freeCount = pool->freeCount;
+    result.inUseBytes = pool->inUseBytes;
+    result.freeBytes = pool->committedBytes - pool->inUseBytes;
+    result.committedBytes = pool->committedBytes;
+    result.peakInUseBytes = pool->peakInUseBytes;
+    result.peakCommittedBytes = pool->peakCommittedBytes;
+    ReleaseSpinLock( &pool->lock );
+
+    return result;
+}
+
+internal void PrintChunkPoolStats( Chunk_Pool_Stats stats )
+{
+    printf( "File arenas: %u chunks, %.2f MB in use (peak %.2f MB), %.2f MB free, %.2f MB committed (peak %.2f MB)\n",
+            stats.chunkCount, ( f64 ) stats.inUseBytes / Megabytes( 1 ), ( f64 ) stats.peakInUseBytes / Megabytes( 1 ),
+            ( f64 ) stats.freeBytes / Megabytes( 1 ), ( f64 ) stats.committedBytes / Megabytes( 1 ),
+            ( f64 ) stats.peakCommittedBytes / Megabytes( 1 ) );
+}
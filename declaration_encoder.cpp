@@ -0,0 +1,227 @@
+// NOTE: declarations as the client sees them, the same maps go out in GetDeclarations, FindSymbols,
+// GetFileDeclarations and the declarations_changed notification
+
+// NOTE: { { type = t, name = n }, ... }, enum values have no type. Lazy mode leaves this empty until
+// ParseFileDetails ran for the file.
+internal void EncodeDeclarationFields( Declaration_Table *table, u32 index, MP_Encoder *encoder )
+{
+    u32 firstField = table->firstFields[ index ];
+    u32 onePastLastField = firstField + table->fieldCounts[ index ];
+    EncodeArray( table->fieldCounts[ index ], encoder );
+    for ( u32 fieldIndex = firstField; fieldIndex < onePastLastField; ++fieldIndex )
+    {
+        EncodeMap( 2, encoder );
+
+        EncodeString( "type", encoder );
+        if ( table->fieldTypes[ fieldIndex ] )
+        {
+            EncodeString( table->fieldTypes[ fieldIndex ], encoder );
+        }
+        else
+        {
+            EncodeNil( encoder );
+        }
+
+        EncodeString( "name", encoder );
+        EncodeString( table->fieldNames[ fieldIndex ], encoder );
+    }
+}
+
+internal void EncodeFunctionDeclaration( Declaration_Table *table, u32 index, MP_Encoder *encoder )
+{
+    EncodeMap( 4, encoder );
+
+    EncodeString( "line", encoder );
+    EncodeUInt( table->lines[ index ], encoder );
+
+    EncodeString( "name", encoder );
+    EncodeString( table->names[ index ], encoder );
+
+    EncodeString( "return_type", encoder );
+    EncodeString( table->types[ index ], encoder );
+
+    EncodeString( "arguments", encoder );
+    EncodeDeclarationFields( table, index, encoder );
+}
+
+inline char *GetStructTypeName( Declaration_Table *table, u32 index )
+{
+    char *type = "struct";
+    if ( table->kinds[ index ] == DeclarationKind_Union )
+    {
+        type = "union";
+    }
+    else if ( table->kinds[ index ] == DeclarationKind_Enum )
+    {
+        type = "enum";
+    }
+    return type;
+}
+
+internal void EncodeStructDeclaration( Declaration_Table *table, u32 index, MP_Encoder *encoder )
+{
+    EncodeMap( 4, encoder );
+
+    EncodeString( "line", encoder );
+    EncodeUInt( table->lines[ index ], encoder );
+
+    EncodeString( "name", encoder );
+    EncodeString( table->names[ index ], encoder );
+
+    EncodeString( "type", encoder );
+    EncodeString( GetStructTypeName( table, index ), encoder );
+
+    EncodeString( "fields", encoder );
+    EncodeDeclarationFields( table, index, encoder );
+}
+
+internal void EncodeMacroDeclaration( Declaration_Table *table, u32 index, MP_Encoder *encoder )
+{
+    EncodeMap( 2, encoder );
+
+    EncodeString( "line", encoder );
+    EncodeUInt( table->lines[ index ], encoder );
+
+    EncodeString( "name", encoder );
+    EncodeString( table->names[ index ], encoder );
+}
+
+internal void EncodeDeclaration( Declaration_Table *table, u32 index, MP_Encoder *encoder )
+{
+    switch ( table->kinds[ index ] )
+    {
+        case DeclarationKind_Function: EncodeFunctionDeclaration( table, index, encoder ); break;
+        case DeclarationKind_Macro: EncodeMacroDeclaration( table, index, encoder ); break;
+        default: EncodeStructDeclaration( table, index, encoder ); break;
+    }
+}
+
+// NOTE: the table keeps functions, structs and macros in consecutive ranges, so each array is one
+// straight run over the columns
+internal void EncodeFileDeclarations( File_State *file, MP_Encoder *encoder )
+{
+    Declaration_Table *table = &file->declarations;
+    u32 firstStruct = file->functionCount;
+    u32 firstMacro = firstStruct + file->structCount;
+
+    EncodeMap( 3, encoder );
+    {
+        EncodeString( "functions", encoder );
+        EncodeArray( file->functionCount, encoder );
+        for ( u32 index = 0; index < firstStruct; ++index )
+        {
+            EncodeFunctionDeclaration( table, index, encoder );
+        }
+
+        EncodeString( "structs", encoder );
+        EncodeArray( file->structCount, encoder );
+        for ( u32 index = firstStruct; index < firstMacro; ++index )
+        {
+            EncodeStructDeclaration( table, index, encoder );
+        }
+
+        EncodeString( "macros", encoder );
+        EncodeArray( file->macroCount, encoder );
+        for ( u32 index = firstMacro; index < table->count; ++index )
+        {
+            EncodeMacroDeclaration( table, index, encoder );
+        }
+    }
+}
+
+// NOTE: scratch blocks for encoding file fragments, only the main thread encodes
+global_variable MP_Block_Pool GlobalFragmentBlocks;
+
+// NOTE: the file's name -> declarations pair, encoded once after each parse and then sent straight
+// out of the file arena for every GetDeclarations that includes the file
+internal void EncodeCachedFileDeclarations( File_State *file, MP_Encoder *encoder )
+{
+    if ( !file->encodedDeclarations )
+    {
+        MP_Encoder fragment = {};
+        BeginEncoder( &fragment, &GlobalFragmentBlocks );
+        EncodeString( file->name, &fragment );
+        EncodeFileDeclarations( file, &fragment );
+
+        file->encodedDeclarations = ( u8 * ) PushSize( &file->arena, fragment.length );
+        file->encodedDeclarationsLength = fragment.length;
+        CopyEncoderOutput( &fragment, file->encodedDeclarations );
+        EndEncoder( &fragment );
+        AddToCounter( StatCounter_FragmentsEncoded, 1 );
+    }
+
+    EncodeReference( file->encodedDeclarations, file->encodedDeclarationsLength, encoder );
+}
+
+// NOTE: GetDeclarations( sinceGeneration, epoch ) response:
+// { epoch = N, generation = N, full = bool, files = { name = declarations }, removed = { names } }
+// A sinceGeneration of 0, one the server doesn't know about, or one from another epoch asks for a
+// full snapshot. Generations restart with every server process, so without the epoch a client that
+// outlived a restart would get a delta against numbers that meant something else.
+internal void EncodeDeclarationsDelta( Parse_State *state, u32 sinceEpoch, u32 sinceGeneration, MP_Encoder *encoder )
+{
+    bool full = sinceEpoch != state->epoch || sinceGeneration == 0 || sinceGeneration > state->generation;
+    if ( !full && sinceGeneration == state->generation )
+    {
+        EncodeMap( 5, encoder );
+        EncodeString( "epoch", encoder );
+        EncodeUInt( state->epoch, encoder );
+        EncodeString( "generation", encoder );
+        EncodeUInt( state->generation, encoder );
+        EncodeString( "full", encoder );
+        EncodeBool( false, encoder );
+        EncodeString( "files", encoder );
+        EncodeMap( 0, encoder );
+        EncodeString( "removed", encoder );
+        EncodeArray( 0, encoder );
+        return;
+    }
+
+    u32 changedCount = 0;
+    u32 removedCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed )
+        {
+            if ( !full && file->generation > sinceGeneration ) { removedCount += 1; }
+        }
+        else if ( full || file->generation > sinceGeneration )
+        {
+            changedCount += 1;
+        }
+    }
+
+    EncodeMap( 5, encoder );
+
+    EncodeString( "epoch", encoder );
+    EncodeUInt( state->epoch, encoder );
+
+    EncodeString( "generation", encoder );
+    EncodeUInt( state->generation, encoder );
+
+    EncodeString( "full", encoder );
+    EncodeBool( full, encoder );
+
+    EncodeString( "files", encoder );
+    EncodeMap( changedCount, encoder );
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( !file->removed && ( full || file->generation > sinceGeneration ) )
+        {
+            EncodeCachedFileDeclarations( file, encoder );
+        }
+    }
+
+    EncodeString( "removed", encoder );
+    EncodeArray( removedCount, encoder );
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed && !full && file->generation > sinceGeneration )
+        {
+            EncodeString( file->name, encoder );
+        }
+    }
+}
@@ -0,0 +1,526 @@
+#define INDEX_FILE_NAME    ".nvim-cpp.index"
+#define INDEX_MAGIC        0x49435644 // "DVCI"
+#define INDEX_VERSION      2
+#define INDEX_NULL_STRING  0xFFFFFFFF
+
+// NOTE: on-disk declaration index, everything is stored as offsets from the start of the file so it
+// can be used straight from the mapping. Layout:
+// header | file records | functions | structs | macros | fields | strings
+struct Index_Header
+{
+    u32 magic;
+    u32 version;
+    u64 totalSize;
+
+    u32 fileCount;
+    u32 functionCount;
+    u32 structCount;
+    u32 macroCount;
+    u32 fieldCount;
+    u32 stringsSize;
+};
+
+struct Index_File
+{
+    u32 name;
+    u32 functionCount;
+    u32 structCount;
+    u32 macroCount;
+
+    u64 lastWrite;
+    u64 fileSize;
+    u64 contentHash;
+
+    u32 firstFunction;
+    u32 firstStruct;
+    u32 firstMacro;
+    // NOTE: written in lazy mode, some declarations have a detail offset instead of their fields
+    u32 detailsPending;
+};
+
+struct Index_Function
+{
+    u32 line;
+    u32 name;
+    u32 returnType;
+    u32 argumentCount;
+    u32 firstArgument;
+    u32 detailOffset;
+};
+
+struct Index_Struct
+{
+    u32 line;
+    u32 type;
+    u32 name;
+    u32 fieldCount;
+    u32 firstField;
+    u32 detailOffset;
+};
+
+struct Index_Macro
+{
+    u32 line;
+    u32 name;
+};
+
+struct Index_Field
+{
+    u32 type;
+    u32 name;
+};
+
+struct Index_Layout
+{
+    Index_Header header;
+
+    u64 filesOffset;
+    u64 functionsOffset;
+    u64 structsOffset;
+    u64 macrosOffset;
+    u64 fieldsOffset;
+    u64 stringsOffset;
+};
+
+inline void ComputeIndexOffsets( Index_Layout *layout )
+{
+    Index_Header *header = &layout->header;
+    layout->filesOffset = sizeof( Index_Header );
+    layout->functionsOffset = layout->filesOffset + header->fileCount * sizeof( Index_File );
+    layout->structsOffset = layout->functionsOffset + header->functionCount * sizeof( Index_Function );
+    layout->macrosOffset = layout->structsOffset + header->structCount * sizeof( Index_Struct );
+    layout->fieldsOffset = layout->macrosOffset + header->macroCount * sizeof( Index_Macro );
+    layout->stringsOffset = layout->fieldsOffset + header->fieldCount * sizeof( Index_Field );
+    header->totalSize = layout->stringsOffset + header->stringsSize;
+}
+
+inline u32 StringSizeForIndex( char *string )
+{
+    u32 result = string ? ( u32 ) strlen( string ) + 1 : 0;
+    return result;
+}
+
+inline u32 WriteIndexString( u8 *strings, u32 *stringsUsed, char *string )
+{
+    if ( !string )
+    {
+        return INDEX_NULL_STRING;
+    }
+
+    u32 result = *stringsUsed;
+    u32 size = ( u32 ) strlen( string ) + 1;
+    memcpy( strings + result, string, size );
+    *stringsUsed += size;
+    return result;
+}
+
+// NOTE: the arguments or fields of one declaration, returns how many records were written
+internal u32 WriteIndexFields( Declaration_Table *table, u32 index, Index_Field *fields, u8 *strings, u32 *stringsUsed )
+{
+    u32 firstField = table->firstFields[ index ];
+    u32 fieldCount = table->fieldCounts[ index ];
+    for ( u32 fieldIndex = 0; fieldIndex < fieldCount; ++fieldIndex )
+    {
+        fields[ fieldIndex ].type = WriteIndexString( strings, stringsUsed, table->fieldTypes[ firstField + fieldIndex ] );
+        fields[ fieldIndex ].name = WriteIndexString( strings, stringsUsed, table->fieldNames[ firstField + fieldIndex ] );
+    }
+    return fieldCount;
+}
+
+inline u32 GetDetailOffset( Declaration_Table *table, u32 index )
+{
+    u32 result = table->detailOffsets ? table->detailOffsets[ index ] : DETAIL_OFFSET_NONE;
+    return result;
+}
+
+inline char *ReadIndexString( char *strings, u32 offset )
+{
+    if ( offset == INDEX_NULL_STRING )
+    {
+        return 0;
+    }
+
+    char *result = InternString( strings + offset );
+    return result;
+}
+
+internal bool WriteDeclarationIndex( Parse_State *state, char *directory )
+{
+    Index_Layout layout = {};
+    Index_Header *header = &layout.header;
+    header->magic = INDEX_MAGIC;
+    header->version = INDEX_VERSION;
+
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed )
+        {
+            continue;
+        }
+
+        header->fileCount += 1;
+        header->stringsSize += StringSizeForIndex( file->name );
+
+        Declaration_Table *table = &file->declarations;
+        header->functionCount += file->functionCount;
+        header->structCount += file->structCount;
+        header->macroCount += file->macroCount;
+        header->fieldCount += table->fieldCount;
+        for ( u32 index = 0; index < table->count; ++index )
+        {
+            header->stringsSize += StringSizeForIndex( table->names[ index ] ) + StringSizeForIndex( table->types[ index ] );
+        }
+        for ( u32 fieldIndex = 0; fieldIndex < table->fieldCount; ++fieldIndex )
+        {
+            header->stringsSize += StringSizeForIndex( table->fieldTypes[ fieldIndex ] ) + StringSizeForIndex( table->fieldNames[ fieldIndex ] );
+        }
+    }
+    ComputeIndexOffsets( &layout );
+
+    u8 *base = ( u8 * ) PlatformAllocateMemory( header->totalSize );
+    if ( !base )
+    {
+        return false;
+    }
+
+    memcpy( base, header, sizeof( Index_Header ) );
+    Index_File *files = ( Index_File * ) ( base + layout.filesOffset );
+    Index_Function *functions = ( Index_Function * ) ( base + layout.functionsOffset );
+    Index_Struct *structs = ( Index_Struct * ) ( base + layout.structsOffset );
+    Index_Macro *macros = ( Index_Macro * ) ( base + layout.macrosOffset );
+    Index_Field *fields = ( Index_Field * ) ( base + layout.fieldsOffset );
+    u8 *strings = base + layout.stringsOffset;
+
+    u32 fileCount = 0;
+    u32 functionCount = 0;
+    u32 structCount = 0;
+    u32 macroCount = 0;
+    u32 fieldCount = 0;
+    u32 stringsUsed = 0;
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed )
+        {
+            continue;
+        }
+
+        Index_File *indexFile = files + fileCount++;
+        indexFile->name = WriteIndexString( strings, &stringsUsed, file->name );
+        indexFile->lastWrite = file->lastWrite;
+        indexFile->fileSize = file->fileSize;
+        indexFile->contentHash = file->contentHash;
+        indexFile->detailsPending = file->detailsPending;
+
+        Declaration_Table *table = &file->declarations;
+        u32 firstStruct = file->functionCount;
+        u32 firstMacro = firstStruct + file->structCount;
+
+        indexFile->functionCount = file->functionCount;
+        indexFile->firstFunction = functionCount;
+        for ( u32 index = 0; index < firstStruct; ++index )
+        {
+            Index_Function *indexFunction = functions + functionCount++;
+            indexFunction->line = table->lines[ index ];
+            indexFunction->name = WriteIndexString( strings, &stringsUsed, table->names[ index ] );
+            indexFunction->returnType = WriteIndexString( strings, &stringsUsed, table->types[ index ] );
+            indexFunction->argumentCount = table->fieldCounts[ index ];
+            indexFunction->firstArgument = fieldCount;
+            indexFunction->detailOffset = GetDetailOffset( table, index );
+            fieldCount += WriteIndexFields( table, index, fields + fieldCount, strings, &stringsUsed );
+        }
+
+        indexFile->structCount = file->structCount;
+        indexFile->firstStruct = structCount;
+        for ( u32 index = firstStruct; index < firstMacro; ++index )
+        {
+            Index_Struct *indexStruct = structs + structCount++;
+            indexStruct->line = table->lines[ index ];
+            indexStruct->type = ( u32 ) ( table->kinds[ index ] - DeclarationKind_Struct );
+            indexStruct->name = WriteIndexString( strings, &stringsUsed, table->names[ index ] );
+            indexStruct->fieldCount = table->fieldCounts[ index ];
+            indexStruct->firstField = fieldCount;
+            indexStruct->detailOffset = GetDetailOffset( table, index );
+            fieldCount += WriteIndexFields( table, index, fields + fieldCount, strings, &stringsUsed );
+        }
+
+        indexFile->macroCount = file->macroCount;
+        indexFile->firstMacro = macroCount;
+        for ( u32 index = firstMacro; index < table->count; ++index )
+        {
+            Index_Macro *indexMacro = macros + macroCount++;
+            indexMacro->line = table->lines[ index ];
+            indexMacro->name = WriteIndexString( strings, &stringsUsed, table->names[ index ] );
+        }
+    }
+    Assert( stringsUsed == header->stringsSize );
+
+    // NOTE: write to a temporary file and swap it in so a crash never leaves a half written index
+    char indexPath[ 256 ];
+    char tempPath[ 256 ];
+    sprintf_s( indexPath, sizeof( indexPath ), "%s%c%s", directory, PLATFORM_PATH_SEPARATOR, INDEX_FILE_NAME );
+    sprintf_s( tempPath, sizeof( tempPath ), "%s%c%s.tmp", directory, PLATFORM_PATH_SEPARATOR, INDEX_FILE_NAME );
+
+    bool result = false;
+    if ( PlatformWriteEntireFile( tempPath, base, header->totalSize ) && PlatformReplaceFile( tempPath, indexPath ) )
+    {
+        printf( "Wrote declaration index: %d files, %llu bytes\n", header->fileCount, header->totalSize );
+        result = true;
+    }
+    else
+    {
+        printf( "Failed to write declaration index: %d\n", PlatformGetLastError() );
+        PlatformDeleteFile( tempPath );
+    }
+
+    PlatformFreeMemory( base );
+    return result;
+}
+
+// NOTE: null or the start of a string inside the strings section, the section ends in a terminator
+// so every string that starts inside it also ends inside it
+inline bool IndexStringIsValid( Index_Header *header, u32 offset )
+{
+    bool result = offset == INDEX_NULL_STRING || offset < header->stringsSize;
+    return result;
+}
+
+inline bool DetailOffsetIsValid( Index_File *indexFile, u32 detailOffset )
+{
+    bool result = detailOffset == DETAIL_OFFSET_NONE || detailOffset <= indexFile->fileSize;
+    return result;
+}
+
+// NOTE: the index is only trusted after every record range and string offset in it checked out, one
+// bad record throws the whole index away. Every range has to start where the previous one ended
+// and together they have to cover each section exactly, the way the writer lays them out, so no
+// two declarations can share records and every range stays inside its section.
+internal bool ValidateDeclarationIndex( Index_Layout *layout, u8 *base )
+{
+    Index_Header *header = &layout->header;
+    Index_File *files = ( Index_File * ) ( base + layout->filesOffset );
+    Index_Function *functions = ( Index_Function * ) ( base + layout->functionsOffset );
+    Index_Struct *structs = ( Index_Struct * ) ( base + layout->structsOffset );
+    Index_Macro *macros = ( Index_Macro * ) ( base + layout->macrosOffset );
+    Index_Field *fields = ( Index_Field * ) ( base + layout->fieldsOffset );
+    char *strings = ( char * ) ( base + layout->stringsOffset );
+
+    if ( header->stringsSize > 0 && strings[ header->stringsSize - 1 ] != 0 )
+    {
+        return false;
+    }
+
+    for ( u32 fieldIndex = 0; fieldIndex < header->fieldCount; ++fieldIndex )
+    {
+        if ( !IndexStringIsValid( header, fields[ fieldIndex ].type ) || !IndexStringIsValid( header, fields[ fieldIndex ].name ) )
+        {
+            return false;
+        }
+    }
+
+    u64 functionCount = 0;
+    u64 structCount = 0;
+    u64 macroCount = 0;
+    u64 fieldCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < header->fileCount; ++fileIndex )
+    {
+        Index_File *indexFile = files + fileIndex;
+        if ( indexFile->name == INDEX_NULL_STRING || !IndexStringIsValid( header, indexFile->name ) ||
+             indexFile->firstFunction != functionCount || indexFile->firstStruct != structCount ||
+             indexFile->firstMacro != macroCount )
+        {
+            return false;
+        }
+        functionCount += indexFile->functionCount;
+        structCount += indexFile->structCount;
+        macroCount += indexFile->macroCount;
+        if ( functionCount > header->functionCount || structCount > header->structCount || macroCount > header->macroCount )
+        {
+            return false;
+        }
+
+        for ( u32 functionIndex = 0; functionIndex < indexFile->functionCount; ++functionIndex )
+        {
+            Index_Function *indexFunction = functions + indexFile->firstFunction + functionIndex;
+            if ( !IndexStringIsValid( header, indexFunction->name ) || !IndexStringIsValid( header, indexFunction->returnType ) ||
+                 indexFunction->firstArgument != fieldCount || fieldCount + indexFunction->argumentCount > header->fieldCount ||
+                 !DetailOffsetIsValid( indexFile, indexFunction->detailOffset ) )
+            {
+                return false;
+            }
+            fieldCount += indexFunction->argumentCount;
+        }
+
+        for ( u32 structIndex = 0; structIndex < indexFile->structCount; ++structIndex )
+        {
+            Index_Struct *indexStruct = structs + indexFile->firstStruct + structIndex;
+            if ( !IndexStringIsValid( header, indexStruct->name ) || indexStruct->type > DeclarationKind_Union - DeclarationKind_Struct ||
+                 indexStruct->firstField != fieldCount || fieldCount + indexStruct->fieldCount > header->fieldCount ||
+                 !DetailOffsetIsValid( indexFile, indexStruct->detailOffset ) )
+            {
+                return false;
+            }
+            fieldCount += indexStruct->fieldCount;
+        }
+
+        for ( u32 macroIndex = 0; macroIndex < indexFile->macroCount; ++macroIndex )
+        {
+            if ( !IndexStringIsValid( header, macros[ indexFile->firstMacro + macroIndex ].name ) )
+            {
+                return false;
+            }
+        }
+    }
+
+    bool result = functionCount == header->functionCount && structCount == header->structCount &&
+                  macroCount == header->macroCount && fieldCount == header->fieldCount;
+    return result;
+}
+
+// NOTE: fills the parse state from the index so the first scan only reparses files whose write time
+// changed since the index was written. Anything that doesn't validate is ignored and we parse from scratch.
+internal bool LoadDeclarationIndex( Parse_State *state, Memory_Arena *arena, char *directory )
+{
+    char indexPath[ 256 ];
+    sprintf_s( indexPath, sizeof( indexPath ), "%s%c%s", directory, PLATFORM_PATH_SEPARATOR, INDEX_FILE_NAME );
+
+    Mapped_File indexFileMapping;
+    if ( !MapEntireFile( indexPath, &indexFileMapping ) )
+    {
+        return false;
+    }
+
+    bool result = false;
+    u8 *base = ( u8 * ) indexFileMapping.content;
+    if ( indexFileMapping.size >= sizeof( Index_Header ) )
+    {
+        Index_Layout layout = {};
+        layout.header = *( Index_Header * ) base;
+        Index_Header *header = &layout.header;
+        u64 storedSize = header->totalSize;
+        ComputeIndexOffsets( &layout );
+
+        if ( header->magic != INDEX_MAGIC || header->version != INDEX_VERSION ||
+             storedSize != header->totalSize || header->totalSize != indexFileMapping.size )
+        {
+            printf( "Ignoring stale declaration index %s\n", indexPath );
+        }
+        else if ( !ValidateDeclarationIndex( &layout, base ) )
+        {
+            printf( "Ignoring corrupt declaration index %s\n", indexPath );
+        }
+        else
+        {
+            Index_File *files = ( Index_File * ) ( base + layout.filesOffset );
+            Index_Function *functions = ( Index_Function * ) ( base + layout.functionsOffset );
+            Index_Struct *structs = ( Index_Struct * ) ( base + layout.structsOffset );
+            Index_Macro *macros = ( Index_Macro * ) ( base + layout.macrosOffset );
+            Index_Field *fields = ( Index_Field * ) ( base + layout.fieldsOffset );
+            char *strings = ( char * ) ( base + layout.stringsOffset );
+
+            for ( u32 fileIndex = 0; fileIndex < header->fileCount; ++fileIndex )
+            {
+                Index_File *indexFile = files + fileIndex;
+                char *name = strings + indexFile->name;
+                if ( FindFileState( state, name ) )
+                {
+                    continue;
+                }
+                // NOTE: without lazy mode nothing would ever fill in the details, parse it from scratch instead
+                bool detailsPending = indexFile->detailsPending != 0;
+                if ( detailsPending && !GlobalLazyDetails )
+                {
+                    continue;
+                }
+
+                File_State *file = CreateFileState( state, arena, name );
+                file->lastWrite = indexFile->lastWrite;
+                file->fileSize = indexFile->fileSize;
+                file->contentHash = indexFile->contentHash;
+                file->generation = 1;
+
+                // NOTE: the records are in table order already, functions then structs then macros
+                u32 declarationCount = indexFile->functionCount + indexFile->structCount + indexFile->macroCount;
+                u32 fieldCount = 0;
+                for ( u32 functionIndex = 0; functionIndex < indexFile->functionCount; ++functionIndex )
+                {
+                    fieldCount += functions[ indexFile->firstFunction + functionIndex ].argumentCount;
+                }
+                for ( u32 structIndex = 0; structIndex < indexFile->structCount; ++structIndex )
+                {
+                    fieldCount += structs[ indexFile->firstStruct + structIndex ].fieldCount;
+                }
+
+                Declaration_Table *table = &file->declarations;
+                AllocateDeclarationTable( table, &file->arena, declarationCount, fieldCount, detailsPending );
+                file->detailsPending = detailsPending;
+                file->functionCount = indexFile->functionCount;
+                file->structCount = indexFile->structCount;
+                file->macroCount = indexFile->macroCount;
+
+                u32 index = 0;
+                u32 tableFieldIndex = 0;
+                for ( u32 functionIndex = 0; functionIndex < indexFile->functionCount; ++functionIndex, ++index )
+                {
+                    Index_Function *indexFunction = functions + indexFile->firstFunction + functionIndex;
+                    table->names[ index ] = ReadIndexString( strings, indexFunction->name );
+                    table->lines[ index ] = indexFunction->line;
+                    table->kinds[ index ] = DeclarationKind_Function;
+                    table->types[ index ] = ReadIndexString( strings, indexFunction->returnType );
+                    table->firstFields[ index ] = tableFieldIndex;
+                    table->fieldCounts[ index ] = indexFunction->argumentCount;
+                    if ( detailsPending )
+                    {
+                        table->detailOffsets[ index ] = indexFunction->detailOffset;
+                    }
+                    for ( u32 argIndex = 0; argIndex < indexFunction->argumentCount; ++argIndex, ++tableFieldIndex )
+                    {
+                        Index_Field *indexField = fields + indexFunction->firstArgument + argIndex;
+                        table->fieldTypes[ tableFieldIndex ] = ReadIndexString( strings, indexField->type );
+                        table->fieldNames[ tableFieldIndex ] = ReadIndexString( strings, indexField->name );
+                    }
+                }
+
+                for ( u32 structIndex = 0; structIndex < indexFile->structCount; ++structIndex, ++index )
+                {
+                    Index_Struct *indexStruct = structs + indexFile->firstStruct + structIndex;
+                    table->names[ index ] = ReadIndexString( strings, indexStruct->name );
+                    table->lines[ index ] = indexStruct->line;
+                    table->kinds[ index ] = ( u8 ) ( DeclarationKind_Struct + indexStruct->type );
+                    table->firstFields[ index ] = tableFieldIndex;
+                    table->fieldCounts[ index ] = indexStruct->fieldCount;
+                    if ( detailsPending )
+                    {
+                        table->detailOffsets[ index ] = indexStruct->detailOffset;
+                    }
+                    for ( u32 fieldIndex = 0; fieldIndex < indexStruct->fieldCount; ++fieldIndex, ++tableFieldIndex )
+                    {
+                        Index_Field *indexField = fields + indexStruct->firstField + fieldIndex;
+                        table->fieldTypes[ tableFieldIndex ] = ReadIndexString( strings, indexField->type );
+                        table->fieldNames[ tableFieldIndex ] = ReadIndexString( strings, indexField->name );
+                    }
+                }
+
+                for ( u32 macroIndex = 0; macroIndex < indexFile->macroCount; ++macroIndex, ++index )
+                {
+                    Index_Macro *indexMacro = macros + indexFile->firstMacro + macroIndex;
+                    table->names[ index ] = ReadIndexString( strings, indexMacro->name );
+                    table->lines[ index ] = indexMacro->line;
+                    table->kinds[ index ] = DeclarationKind_Macro;
+                    if ( detailsPending )
+                    {
+                        table->detailOffsets[ index ] = DETAIL_OFFSET_NONE;
+                    }
+                }
+            }
+
+            state->generation = 1;
+            printf( "Loaded declaration index: %d files\n", header->fileCount );
+            result = true;
+        }
+    }
+
+    UnmapFile( &indexFileMapping );
+    return result;
+}
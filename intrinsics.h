@@ -0,0 +1,130 @@
+#pragma once
+
+// NOTE: the compiler intrinsics the code base uses, MSVC on one side and GCC/Clang on the other.
+// ARCH_X64 is set on x86-64, that's the only place the SSE2 tokenizer kernels exist.
+// Everywhere else only the scalar kernels are built.
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define ARCH_X64 1
+#else
+    #define ARCH_X64 0
+#endif
+
+#if defined( _MSC_VER )
+    #include <intrin.h>
+#elif ARCH_X64
+    #include <x86intrin.h>
+#endif
+
+inline u16 ByteSwap16( u16 value )
+{
+#if defined( _MSC_VER )
+    return _byteswap_ushort( value );
+#else
+    return __builtin_bswap16( value );
+#endif
+}
+
+inline u32 ByteSwap32( u32 value )
+{
+#if defined( _MSC_VER )
+    return _byteswap_ulong( value );
+#else
+    return __builtin_bswap32( value );
+#endif
+}
+
+inline u64 ByteSwap64( u64 value )
+{
+#if defined( _MSC_VER )
+    return _byteswap_uint64( value );
+#else
+    return __builtin_bswap64( value );
+#endif
+}
+
+// NOTE: value must not be 0
+inline u32 FindHighestSetBit64( u64 value )
+{
+#if defined( _MSC_VER )
+    unsigned long index;
+    _BitScanReverse64( &index, value );
+    return index;
+#else
+    return 63 - __builtin_clzll( value );
+#endif
+}
+
+// NOTE: all of these are full barriers and return the value from before the operation
+inline u32 AtomicCompareExchangeU32( u32 volatile *value, u32 newValue, u32 expected )
+{
+#if defined( _MSC_VER )
+    return ( u32 ) _InterlockedCompareExchange( ( long volatile * ) value, ( long ) newValue, ( long ) expected );
+#else
+    return __sync_val_compare_and_swap( value, expected, newValue );
+#endif
+}
+
+inline u32 AtomicExchangeU32( u32 volatile *value, u32 newValue )
+{
+#if defined( _MSC_VER )
+    return ( u32 ) _InterlockedExchange( ( long volatile * ) value, ( long ) newValue );
+#else
+    return __atomic_exchange_n( value, newValue, __ATOMIC_SEQ_CST );
+#endif
+}
+
+inline u32 AtomicAddU32( u32 volatile *value, u32 addend )
+{
+#if defined( _MSC_VER )
+    return ( u32 ) _InterlockedExchangeAdd( ( long volatile * ) value, ( long ) addend );
+#else
+    return __sync_fetch_and_add( value, addend );
+#endif
+}
+
+inline u64 AtomicCompareExchangeU64( u64 volatile *value, u64 newValue, u64 expected )
+{
+#if defined( _MSC_VER )
+    return ( u64 ) _InterlockedCompareExchange64( ( __int64 volatile * ) value, ( __int64 ) newValue, ( __int64 ) expected );
+#else
+    return __sync_val_compare_and_swap( value, expected, newValue );
+#endif
+}
+
+inline u64 AtomicAddU64( u64 volatile *value, u64 addend )
+{
+#if defined( _MSC_VER )
+    return ( u64 ) _InterlockedExchangeAdd64( ( __int64 volatile * ) value, ( __int64 ) addend );
+#else
+    return __sync_fetch_and_add( value, addend );
+#endif
+}
+
+// NOTE: keeps the compiler from moving stores across it. x86 doesn't reorder stores with each
+// other, everywhere else the CPU needs a release fence as well.
+inline void CompletePreviousWritesBeforeFutureWrites()
+{
+#if ARCH_X64 && defined( _MSC_VER )
+    _WriteBarrier();
+#elif ARCH_X64
+    asm volatile( "" ::: "memory" );
+#elif defined( _MSC_VER )
+    __dmb( _ARM64_BARRIER_ISHST );
+#else
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+#endif
+}
+
+inline void SpinPause()
+{
+#if ARCH_X64
+    _mm_pause();
+#elif defined( _MSC_VER ) && defined( _M_ARM64 )
+    __yield();
+#elif defined( __aarch64__ ) || defined( __arm__ )
+    asm volatile( "yield" ::: "memory" );
+#else
+    asm volatile( "" ::: "memory" );
+#endif
+}
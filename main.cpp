@@ -1,995 +1,1912 @@
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <shellapi.h>
 #include <stdio.h>
-#include <intrin.h>
+#include <stdlib.h>
 #include "utils.h"
+#include "intrinsics.h"
+
+#if defined( _WIN32 )
+    #include "win32_platform.cpp"
+#else
+    #include "posix_platform.cpp"
+#endif
+
+#include "work_queue.cpp"
+#include "stats.cpp"
+#include "chunk_arena.cpp"
+#include "simd_scan.cpp"
+#include "string_intern.cpp"
+#include "parser.cpp"
+#include "watcher.cpp"
+#include "index_file.cpp"
+#include "symbol_search.cpp"
+#include "name_index.cpp"
+#include "msgpack.cpp"
+#include "declaration_encoder.cpp"
 
-struct Memory_Arena
+#define DEFAULT_PORT          "12345"
+#define DEFAULT_BUFFER_LENGTH Kilobytes( 4 )
+#define MAX_CONNECTIONS       ( PLATFORM_MAX_WAIT_SOCKETS - 1 )
+#define PIPELINE_FLUSH_SIZE   Megabytes( 4 )
+#define SEND_QUEUE_READ_LIMIT Megabytes( 4 )
+#define BUILD_POLL_INTERVAL_MS 50
+#define PUSH_POLL_INTERVAL_MS  100
+#define INDEX_WRITE_INTERVAL_MS 30000
+
+#define FIND_SYMBOLS_DEFAULT_LIMIT 50
+#define FIND_SYMBOLS_MAX_LIMIT     1000
+
+// NOTE: bytes between start and end haven't been dispatched yet, the buffer is compacted before each
+// read and doubles whenever a single request doesn't fit
+struct Stream_Buffer
 {
-    memory_index size;
     u8 *base;
-    memory_index used;
-
-    s32 tempCount;
+    u32 size;
+    u32 start;
+    u32 end;
 };
 
-inline void InitializeArena( Memory_Arena *arena, memory_index size, void *base )
+internal bool ReserveStreamSpace( Stream_Buffer *stream, u32 minimumFree )
+{
+    if ( stream->start > 0 )
+    {
+        memmove( stream->base, stream->base + stream->start, stream->end - stream->start );
+        stream->end -= stream->start;
+        stream->start = 0;
+    }
+
+    if ( stream->size - stream->end < minimumFree )
+    {
+        u32 newSize = stream->size ? stream->size : DEFAULT_BUFFER_LENGTH;
+        while ( newSize - stream->end < minimumFree )
+        {
+            newSize *= 2;
+        }
+        if ( newSize > 2 * MAX_REQUEST_SIZE )
+        {
+            return false;
+        }
+
+        u8 *newBase = ( u8 * ) PlatformAllocateMemory( newSize );
+        if ( !newBase )
+        {
+            return false;
+        }
+        if ( stream->base )
+        {
+            memcpy( newBase, stream->base, stream->end );
+            PlatformFreeMemory( stream->base );
+        }
+        stream->base = newBase;
+        stream->size = newSize;
+    }
+
+    return true;
+}
+
+inline bool StringsAreEqual( String a, char *b )
 {
-    arena->size = size;
-    arena->base = ( u8 * ) base;
-    arena->used = 0;
+    char *at = b;
+    for ( u64 index = 0; index < a.length; ++index, ++at )
+    {
+        if ( *at == '\0' || a.content[ index ] != *at )
+        {
+            return false;
+        }
+    }
 
-    arena->tempCount = 0;
+    bool result = *at == '\0';
+    return result;
 }
 
-#define PushStruct( arena, type )       ( type * ) _PushSize( arena, sizeof( type ) )
-#define PushArray( arena, count, type ) ( type * ) _PushSize( arena, count * sizeof( type ) )
-#define PushString( arena, size )       ( char * ) _PushSize( arena, size )
-#define PushSize( arena, size )         _PushSize( arena, size )
-inline void *_PushSize( Memory_Arena *arena, memory_index size )
+inline u32 StringToUInt( Token string )
 {
-    Assert( arena->used + size <= arena->size );
-    void *result = arena->base + arena->used;
-    arena->used += size;
+    u32 result = 0;
+    for ( u32 i = 0; i < string.textLength; ++i )
+    {
+        result += ( u32 ) ( pow( 10, ( f64 ) ( string.textLength - 1 - i ) ) ) * ( u32 ) ( string.text[ i ] - '0' );
+    }
     return result;
 }
 
-inline void SubArena( Memory_Arena *result, Memory_Arena *parentArena, memory_index size )
+inline u32 StringToUInt( String string )
 {
-    result->size = size;
-    result->base = ( u8 * ) PushSize( parentArena, size );
-    result->used = 0;
-    result->tempCount = 0;
+    u32 result = 0;
+    for ( u32 i = 0; i < string.length; ++i )
+    {
+        result += ( u32 ) ( pow( 10, ( f64 ) ( string.length - 1 - i ) ) ) * ( u32 ) ( string.content[ i ] - '0' );
+    }
+    return result;
 }
 
-#include "parser.cpp"
+// NOTE: FindSymbols( query, limit, kinds ) response, best match first:
+// { { kind = "function" | "struct" | "macro", file = name, declaration = same map as in GetDeclarations } }
+internal void EncodeSymbolMatches( Symbol_Match *matches, u32 matchCount, MP_Encoder *encoder )
+{
+    EncodeArray( matchCount, encoder );
+    for ( u32 matchIndex = 0; matchIndex < matchCount; ++matchIndex )
+    {
+        Symbol *symbol = matches[ matchIndex ].symbol;
+        EncodeMap( 3, encoder );
 
-#define DEFAULT_PORT          "12345"
-#define DEFAULT_BUFFER_LENGTH 512
-
-enum MP_Type : u8
-{
-    INVALID,
-    // https://github.com/msgpack/msgpack/blob/master/spec.md#formats
-    POSITIVE_FIX_INT = 0x00,
-    FIX_MAP = 0x80,
-    FIX_ARRAY = 0x90,
-    FIX_STRING = 0xa0,
-    NIL = 0xc0,
-    BOOL_FALSE = 0xc2,
-    BOOL_TRUE = 0xc3,
-    BINARY_8 = 0xc4,
-    BINARY_16 = 0xc5,
-    BINARY_32 = 0xc6,
-    EXT_8 = 0xc7,
-    EXT_16 = 0xc8,
-    EXT_32 = 0xc9,
-    FLOAT_32 = 0xca,
-    FLOAT_64 = 0xcb,
-    UINT_8 = 0xcc,
-    UINT_16 = 0xcd,
-    UINT_32 = 0xce,
-    UINT_64 = 0xcf,
-    INT_8 = 0xd0,
-    INT_16 = 0xd1,
-    INT_32 = 0xd2,
-    INT_64 = 0xd3,
-    FIX_EXT_1 = 0xd4,
-    FIX_EXT_2 = 0xd5,
-    FIX_EXT_4 = 0xd6,
-    FIX_EXT_8 = 0xd7,
-    FIX_EXT_16 = 0xd8,
-    STRING_8 = 0xd9,
-    STRING_16 = 0xda,
-    STRING_32 = 0xdb,
-    ARRAY_16 = 0xdc,
-    ARRAY_32 = 0xdd,
-    MAP_16 = 0xde,
-    MAP_32 = 0xdf,
-    NEGATIVE_FIX_INT = 0xe0,
+        EncodeString( "file", encoder );
+        EncodeString( symbol->file->name, encoder );
+
+        EncodeString( "kind", encoder );
+        switch ( symbol->kind )
+        {
+            case SymbolKind_Function:
+            {
+                EncodeString( "function", encoder );
+                EncodeString( "declaration", encoder );
+                EncodeFunctionDeclaration( &symbol->file->declarations, symbol->declarationIndex, encoder );
+            }
+            break;
+
+            case SymbolKind_Struct:
+            {
+                EncodeString( "struct", encoder );
+                EncodeString( "declaration", encoder );
+                EncodeStructDeclaration( &symbol->file->declarations, symbol->declarationIndex, encoder );
+            }
+            break;
+
+            default:
+            {
+                EncodeString( "macro", encoder );
+                EncodeString( "declaration", encoder );
+                EncodeMacroDeclaration( &symbol->file->declarations, symbol->declarationIndex, encoder );
+            }
+            break;
+        }
+    }
+}
+
+// NOTE: response bytes a full socket didn't take yet, followed by the bytes themselves. Encoder
+// segments can point into file arenas that the next refresh resets, so whatever has to wait is
+// copied out first.
+struct Send_Queue_Block
+{
+    Send_Queue_Block *next;
+    u32 size;
+    u32 sent;
+};
+
+inline u8 *GetQueuedData( Send_Queue_Block *block )
+{
+    return ( u8 * ) ( block + 1 );
+}
+
+// NOTE: every editor or script gets its own connection with its own buffers, the parse state and
+// the symbol index are shared between all of them
+struct Client_Connection
+{
+    Platform_Socket socket;
+    Stream_Buffer receive;
+    MP_Frame_Scanner scanner;
+    MP_Block_Pool responseBlocks;
+
+    // NOTE: sockets never block, what they don't take waits here, oldest first. Requests aren't read
+    // while more than SEND_QUEUE_READ_LIMIT is waiting, so a client that stops reading only holds up
+    // itself. waitEvents is what the socket set currently waits for on this connection.
+    Send_Queue_Block *firstQueued;
+    Send_Queue_Block *lastQueued;
+    u64 queuedBytes;
+    u32 waitEvents;
+
+    // NOTE: subscribed connections get a declarations_changed notification whenever the generation
+    // moves past the one they were last sent
+    bool subscribed;
+    u32 pushedGeneration;
+
+    // NOTE: set by Exit, the connection is closed once its responses went out
+    bool closing;
+};
+
+#define BUILD_MAX_LINE_LENGTH 2048
+
+struct Compile_Diagnostic
+{
+    String filename;
+    u32 line;
+    u32 column;
+    String number;
+    bool warning;
+    String message;
+};
+
+// NOTE: only one build at a time, its diagnostics go to the connection that started it
+struct Build_State
+{
+    bool running;
+    bool finished;
+    u32 buildId;
+    Platform_Process process;
+    Client_Connection *client;
+
+    u32 errorCount;
+    u32 warningCount;
+
+    u32 lineLength;
+    char line[ BUILD_MAX_LINE_LENGTH ];
 };
 
-struct MP_Parser
+struct Server_State
 {
-    u8 *at;
+    Memory_Arena arena;
+    char currentDirectory[ 256 ];
+    bool running;
+
+    Parse_State *parseState;
+    File_Watcher *watcher;
+    Symbol_Index *symbolIndex;
+    Name_Index *nameIndex;
+    Symbol_Match *symbolMatches;
+
+    // NOTE: the index is written back whenever the generation moved past the one it holds: after the
+    // first scan, at most every INDEX_WRITE_INTERVAL_MS while edits keep coming, when the last
+    // connection closes and on shutdown
+    u32 indexedGeneration;
+    u64 lastIndexWrite;
+    bool initialScanDone;
+
+    // NOTE: set while responses are queued up for one send, see RefreshParseState
+    bool holdSnapshot;
+    bool snapshotRefreshed;
+    // NOTE: time spent refreshing so far, lets request timings leave out the reparse they triggered
+    u64 refreshTicks;
+
+    // NOTE: 0 unless started with --stats <seconds>
+    u32 statsDumpSeconds;
+    u64 lastStatsDump;
+
+    Build_State build;
+
+    // NOTE: the listening socket is in the set with a null user, every connection with itself
+    Platform_Socket listenSocket;
+    Platform_Socket_Set socketSet;
+    u32 connectionCount;
+    Client_Connection *connections[ MAX_CONNECTIONS ];
 };
 
-internal MP_Type GetType( MP_Parser *parser )
+// NOTE: returns where the message starts after a GCC style "error: ", "fatal error: " or
+// "warning: ", 0 if severity doesn't start with one of them
+internal char *ParseGccSeverity( char *severity, bool *warning )
+{
+    *warning = false;
+    if ( StringStartsWith( severity, "error: " ) )
+    {
+        return severity + 7;
+    }
+    if ( StringStartsWith( severity, "fatal error: " ) )
+    {
+        return severity + 13;
+    }
+    if ( StringStartsWith( severity, "warning: " ) )
+    {
+        *warning = true;
+        return severity + 9;
+    }
+    return 0;
+}
+
+// NOTE: parses one line of GCC or clang output, e.g.
+// src/main.cpp:12:5: error: 'x' was not declared in this scope
+// main.cpp:3: fatal error: missing.h: No such file or directory
+// collect2: error: ld returned 1 exit status
+// The column is optional and there is no error number. Scanning for the first :<line> that is
+// followed by a severity keeps drive letters and odd characters in the path out of the way.
+internal bool ParseGccDiagnostic( char *text, Compile_Diagnostic *diagnostic )
 {
-    MP_Type result = MP_Type::INVALID;
-    u8 byte = *parser->at;
-    if ( byte >= 0x00 && byte <= 0x7f ) { result = MP_Type::POSITIVE_FIX_INT; }
-    else if ( byte >= 0x80 && byte <= 0x8f ) { result = MP_Type::FIX_MAP; }
-    else if ( byte >= 0x90 && byte <= 0x9f ) { result = MP_Type::FIX_ARRAY; }
-    else if ( byte >= 0xa0 && byte <= 0xbf ) { result = MP_Type::FIX_STRING; }
-    else if ( byte >= 0xe0 && byte <= 0xff ) { result = MP_Type::NEGATIVE_FIX_INT; }
+    bool warning;
+    char *message;
+
+    // NOTE: no location, a tool name without spaces comes first
+    char *toolEnd = text;
+    while ( *toolEnd && *toolEnd != ':' && !IsWhitespace( *toolEnd ) )
+    {
+        ++toolEnd;
+    }
+    if ( toolEnd > text && toolEnd[ 0 ] == ':' && toolEnd[ 1 ] == ' ' )
+    {
+        message = ParseGccSeverity( toolEnd + 2, &warning );
+        if ( message )
+        {
+            diagnostic->filename = String{ ( u32 ) ( toolEnd - text ), text };
+            diagnostic->line = 1;
+            diagnostic->column = 1;
+            diagnostic->number = String{ 0, toolEnd };
+            diagnostic->warning = warning;
+            diagnostic->message.content = message;
+            diagnostic->message.length = ( u32 ) strlen( message );
+            return true;
+        }
+    }
+
+    for ( char *at = text; *at; ++at )
+    {
+        if ( at[ 0 ] != ':' || !IsNumber( at[ 1 ] ) || at == text )
+        {
+            continue;
+        }
+
+        char *lineStart = at + 1;
+        char *cursor = lineStart;
+        while ( IsNumber( *cursor ) )
+        {
+            ++cursor;
+        }
+        String line = String{ ( u32 ) ( cursor - lineStart ), lineStart };
+
+        String column = String{ 0, cursor };
+        if ( cursor[ 0 ] == ':' && IsNumber( cursor[ 1 ] ) )
+        {
+            char *columnStart = cursor + 1;
+            cursor = columnStart;
+            while ( IsNumber( *cursor ) )
+            {
+                ++cursor;
+            }
+            column = String{ ( u32 ) ( cursor - columnStart ), columnStart };
+        }
+
+        if ( cursor[ 0 ] != ':' || cursor[ 1 ] != ' ' )
+        {
+            continue;
+        }
+
+        char *severity = cursor + 2;
+        message = ParseGccSeverity( severity, &warning );
+        if ( !message )
+        {
+            continue;
+        }
+
+        diagnostic->filename = String{ ( u32 ) ( at - text ), text };
+        diagnostic->line = StringToUInt( line );
+        diagnostic->column = column.length ? StringToUInt( column ) : 1;
+        diagnostic->number = String{ 0, severity };
+        diagnostic->warning = warning;
+        diagnostic->message.content = message;
+        diagnostic->message.length = ( u32 ) strlen( message );
+        return true;
+    }
+
+    return false;
+}
+
+// NOTE: parses one line of compiler output, GCC and clang through ParseGccDiagnostic, otherwise MSVC, e.g.
+// E:\\Projects\\nvim-cpp\\main.cpp(12,5): error C2065: 'x': undeclared identifier
+// LINK : fatal error LNK1168: cannot open nvim-cpp.exe for writing
+internal bool ParseCompileDiagnostic( char *text, Compile_Diagnostic *diagnostic )
+{
+    if ( ParseGccDiagnostic( text, diagnostic ) )
+    {
+        return true;
+    }
+
+    char *textEnd = text + strlen( text );
+    Tokenizer tokenizer = {};
+    tokenizer.at = text;
+    tokenizer.end = textEnd;
+    for ( ;; )
+    {
+        Token token = GetToken( &tokenizer );
+        if ( token.type == Token_Type::EndOfStream )
+        {
+            return false;
+        }
+
+        if ( token.type == Token_Type::Colon )
+        {
+            Token nextToken = GetToken( &tokenizer );
+            if ( nextToken.type == Token_Type::Identifier && ( TokenEquals( nextToken, "error" ) ||
+                                                               TokenEquals( nextToken, "fatal" ) ||
+                                                               TokenEquals( nextToken, "warning" ) ) )
+            {
+                break;
+            }
+        }
+    }
+
+    Tokenizer errorTokenizer = {};
+    errorTokenizer.at = text;
+    errorTokenizer.end = textEnd;
+
+    char *fileStart = text;
+    char *fileEnd = 0;
+    Token errorToken = GetToken( &errorTokenizer );
+    if ( TokenEquals( errorToken, "LINK" ) )
+    {
+        fileEnd = errorTokenizer.at;
+    }
+    else
+    {
+        while ( errorToken.type != Token_Type::OpenParen && errorToken.type != Token_Type::EndOfStream )
+        {
+            errorToken = GetToken( &errorTokenizer );
+        }
+
+        if ( errorToken.type == Token_Type::OpenParen )
+        {
+            fileEnd = errorTokenizer.at - 1;
+        }
+        else
+        {
+            // NOTE: no location, the tool name comes first like with LINK
+            errorTokenizer.at = text;
+            errorToken = GetToken( &errorTokenizer );
+            fileEnd = errorTokenizer.at;
+        }
+    }
+
+    diagnostic->filename.content = fileStart;
+    diagnostic->filename.length = ( u32 ) ( fileEnd - fileStart );
+
+    Token line = {};
+    Token column = {};
+    if ( errorToken.type == Token_Type::OpenParen )
+    {
+        line = GetToken( &errorTokenizer );
+        errorToken = GetToken( &errorTokenizer );
+        if ( errorToken.type == Token_Type::Comma )
+        {
+            column = GetToken( &errorTokenizer );
+            errorToken = GetToken( &errorTokenizer );
+        }
+    }
+
+    while ( errorToken.type != Token_Type::Colon && errorToken.type != Token_Type::EndOfStream )
+    {
+        errorToken = GetToken( &errorTokenizer );
+    }
+
+    errorToken = GetToken( &errorTokenizer ); // fatal or error
+    if ( TokenEquals( errorToken, "fatal" ) )
+    {
+        errorToken = GetToken( &errorTokenizer );
+    }
+
+    diagnostic->warning = TokenEquals( errorToken, "warning" );
+    Token errorNumber = GetToken( &errorTokenizer );
+    diagnostic->number = String{ ( u32 ) errorNumber.textLength, errorNumber.text };
+    errorToken = GetToken( &errorTokenizer ); // :
+
+    errorToken = GetToken( &errorTokenizer ); // message start
+    if ( errorToken.type == Token_Type::Character )
+    {
+        --errorToken.text;
+    }
+    char *messageStart = errorToken.text ? errorToken.text : errorTokenizer.at;
+    diagnostic->message.content = messageStart;
+    diagnostic->message.length = ( u32 ) strlen( messageStart );
+
+    diagnostic->line = line.text ? StringToUInt( line ) : 1;
+    diagnostic->column = column.text ? StringToUInt( column ) : 1;
+    if ( StringsAreEqual( diagnostic->filename, "LINK" ) || StringStartsWith( errorNumber.text, "LNK" ) )
+    {
+        diagnostic->filename = String{ 9, "build.bat" };
+    }
+
+    return true;
+}
+
+internal void EncodeCompileDiagnostic( Compile_Diagnostic *diagnostic, MP_Encoder *encoder )
+{
+    EncodeMap( 6, encoder );
+    EncodeString( "lnum", encoder );
+    EncodeUInt( diagnostic->line, encoder );
+    EncodeString( "col", encoder );
+    EncodeUInt( diagnostic->column, encoder );
+    EncodeString( "nr", encoder );
+    EncodeString( diagnostic->number, encoder );
+    EncodeString( "type", encoder );
+    EncodeString( ( char * ) ( diagnostic->warning ? "W" : "E" ), encoder );
+    EncodeString( "filename", encoder );
+    EncodeString( diagnostic->filename, encoder );
+    EncodeString( "text", encoder );
+    EncodeString( diagnostic->message, encoder );
+}
+
+// NOTE: notifications are [ 2, method, params ]. Neovim runs API calls coming in over an rpc channel,
+// so the event is delivered by calling NvimCpp.on_notification( event, payload ) through
+// nvim_exec_lua. The caller encodes the payload right after this.
+internal void EncodeNotificationHeader( char *event, MP_Encoder *encoder )
+{
+    EncodeArray( 3, encoder );
+    EncodeUInt( 2, encoder );
+    EncodeString( "nvim_exec_lua", encoder );
+    EncodeArray( 2, encoder );
+    EncodeString( "return NvimCpp.on_notification( ... )", encoder );
+    EncodeArray( 2, encoder );
+    EncodeString( event, encoder );
+}
+
+#define SEND_MAX_BUFFERS 256
+
+// NOTE: sends queued blocks until the socket is full or nothing is left, false once the connection
+// failed
+internal bool FlushSendQueue( Client_Connection *connection )
+{
+    bool result = true;
+    while ( result && connection->firstQueued )
+    {
+        Platform_Send_Buffer buffers[ SEND_MAX_BUFFERS ];
+        u32 bufferCount = 0;
+        u64 bufferedBytes = 0;
+        for ( Send_Queue_Block *block = connection->firstQueued; block && bufferCount < SEND_MAX_BUFFERS; block = block->next )
+        {
+            PlatformSetSendBuffer( buffers + bufferCount, GetQueuedData( block ) + block->sent, block->size - block->sent );
+            bufferedBytes += block->size - block->sent;
+            bufferCount += 1;
+        }
+
+        u32 bytesSent = 0;
+        if ( !PlatformSendGathered( connection->socket, buffers, bufferCount, &bytesSent ) )
+        {
+            printf( "Send failed: %d\n", PlatformGetSocketError() );
+            result = false;
+            break;
+        }
+
+        bool socketFull = bytesSent < bufferedBytes;
+        connection->queuedBytes -= bytesSent;
+        while ( bytesSent > 0 )
+        {
+            Send_Queue_Block *block = connection->firstQueued;
+            u32 remaining = block->size - block->sent;
+            if ( bytesSent < remaining )
+            {
+                block->sent += bytesSent;
+                break;
+            }
+            bytesSent -= remaining;
+            connection->firstQueued = block->next;
+            PlatformFreeMemory( block );
+        }
+        if ( !connection->firstQueued )
+        {
+            connection->lastQueued = 0;
+        }
+
+        if ( socketFull )
+        {
+            // NOTE: the event loop calls again once the socket is writable
+            break;
+        }
+    }
+    return result;
+}
+
+// NOTE: sends as much of the encoder as the socket takes right now with gathered writes, copies the
+// rest into the connection's send queue and releases the encoder's blocks. Responses go out in
+// order, so nothing is sent directly while older ones are still queued. False once the connection
+// failed.
+internal bool SendEncoder( Client_Connection *connection, MP_Encoder *encoder )
+{
+    CloseEncoderRun( encoder );
+    u64 sendStart = ReadTimer();
+    AddToCounter( StatCounter_BytesEncoded, encoder->length );
+
+    bool result = FlushSendQueue( connection );
+    MP_Segment *segments = encoder->pool->segments;
+    u32 segmentIndex = 0;
+    u32 segmentOffset = 0;
+    bool socketFull = connection->firstQueued != 0;
+    while ( result && !socketFull && segmentIndex < encoder->segmentCount )
+    {
+        Platform_Send_Buffer buffers[ SEND_MAX_BUFFERS ];
+        u32 bufferCount = 0;
+        u64 bufferedBytes = 0;
+        for ( u32 bufferSegment = segmentIndex; bufferSegment < encoder->segmentCount && bufferCount < SEND_MAX_BUFFERS; ++bufferSegment )
+        {
+            u32 skip = bufferSegment == segmentIndex ? segmentOffset : 0;
+            PlatformSetSendBuffer( buffers + bufferCount, segments[ bufferSegment ].data + skip, segments[ bufferSegment ].size - skip );
+            bufferedBytes += segments[ bufferSegment ].size - skip;
+            bufferCount += 1;
+        }
+
+        u32 bytesSent = 0;
+        if ( !PlatformSendGathered( connection->socket, buffers, bufferCount, &bytesSent ) )
+        {
+            printf( "Send failed: %d\n", PlatformGetSocketError() );
+            result = false;
+            break;
+        }
+        socketFull = bytesSent < bufferedBytes;
+
+        while ( bytesSent > 0 )
+        {
+            u32 remaining = segments[ segmentIndex ].size - segmentOffset;
+            if ( bytesSent < remaining )
+            {
+                segmentOffset += bytesSent;
+                break;
+            }
+            bytesSent -= remaining;
+            segmentIndex += 1;
+            segmentOffset = 0;
+        }
+    }
+
+    if ( result && segmentIndex < encoder->segmentCount )
+    {
+        u32 queuedSize = segments[ segmentIndex ].size - segmentOffset;
+        for ( u32 queuedSegment = segmentIndex + 1; queuedSegment < encoder->segmentCount; ++queuedSegment )
+        {
+            queuedSize += segments[ queuedSegment ].size;
+        }
+
+        Send_Queue_Block *block = ( Send_Queue_Block * ) PlatformAllocateMemory( sizeof( Send_Queue_Block ) + queuedSize );
+        if ( block )
+        {
+            block->size = queuedSize;
+            u8 *at = GetQueuedData( block );
+            memcpy( at, segments[ segmentIndex ].data + segmentOffset, segments[ segmentIndex ].size - segmentOffset );
+            at += segments[ segmentIndex ].size - segmentOffset;
+            for ( u32 queuedSegment = segmentIndex + 1; queuedSegment < encoder->segmentCount; ++queuedSegment )
+            {
+                memcpy( at, segments[ queuedSegment ].data, segments[ queuedSegment ].size );
+                at += segments[ queuedSegment ].size;
+            }
+
+            if ( connection->lastQueued )
+            {
+                connection->lastQueued->next = block;
+            }
+            else
+            {
+                connection->firstQueued = block;
+            }
+            connection->lastQueued = block;
+            connection->queuedBytes += queuedSize;
+            AddToCounter( StatCounter_BytesQueued, queuedSize );
+        }
+        else
+        {
+            printf( "Out of memory queueing a response\n" );
+            result = false;
+        }
+    }
+
+    EndPhase( StatPhase_Send, sendStart );
+    EndEncoder( encoder );
+    return result;
+}
+
+// NOTE: everything the build printed since the last poll, the complete lines are parsed and the
+// diagnostics found in them go out as one compile_diagnostics notification
+internal void ProcessBuildOutput( Build_State *build, char *data, u32 length )
+{
+    MP_Encoder encoder = {};
+    u32 diagnosticCount = 0;
+    u8 *arrayCountSpot = 0;
+    if ( build->client )
+    {
+        BeginEncoder( &encoder, &build->client->responseBlocks );
+        EncodeNotificationHeader( "compile_diagnostics", &encoder );
+        EncodeMap( 2, &encoder );
+        EncodeString( "id", &encoder );
+        EncodeUInt( build->buildId, &encoder );
+        EncodeString( "messages", &encoder );
+        // NOTE: the ARRAY_16 header goes where the reserve says, blocks never move so it can be
+        // patched once the count is known
+        arrayCountSpot = ReserveEncoderSpace( &encoder, 3 );
+        EncodeArray( UINT16_MAX, &encoder );
+    }
+
+    for ( u32 index = 0; index <= length; ++index )
+    {
+        bool endOfLine = index == length ? build->finished && build->lineLength > 0 : data[ index ] == '\n';
+        if ( !endOfLine )
+        {
+            if ( index < length && data[ index ] != '\r' && build->lineLength < sizeof( build->line ) - 1 )
+            {
+                build->line[ build->lineLength++ ] = data[ index ];
+            }
+            continue;
+        }
+
+        build->line[ build->lineLength ] = '\0';
+        Compile_Diagnostic diagnostic = {};
+        if ( ParseCompileDiagnostic( build->line, &diagnostic ) )
+        {
+            if ( diagnostic.warning )
+            {
+                build->warningCount += 1;
+            }
+            else
+            {
+                build->errorCount += 1;
+            }
+
+            if ( build->client && diagnosticCount < UINT16_MAX )
+            {
+                EncodeCompileDiagnostic( &diagnostic, &encoder );
+                diagnosticCount += 1;
+            }
+        }
+        build->lineLength = 0;
+    }
+
+    if ( build->client && diagnosticCount > 0 )
+    {
+        StoreBigEndian16( arrayCountSpot + 1, ( u16 ) diagnosticCount );
+        SendEncoder( build->client, &encoder );
+    }
+    else if ( build->client )
+    {
+        EndEncoder( &encoder );
+    }
+}
+
+// NOTE: called from the event loop while a build is running, never blocks on the pipe
+internal void PollBuild( Build_State *build )
+{
+    local_persist char chunk[ Kilobytes( 16 ) ];
+
+    for ( ;; )
+    {
+        int bytesRead = PlatformReadProcessOutput( &build->process, chunk, sizeof( chunk ) );
+        if ( bytesRead < 0 )
+        {
+            build->finished = true;
+            break;
+        }
+        if ( bytesRead == 0 )
+        {
+            break;
+        }
+        ProcessBuildOutput( build, chunk, ( u32 ) bytesRead );
+    }
+
+    if ( build->finished )
+    {
+        ProcessBuildOutput( build, chunk, 0 );
+
+        u32 exitCode = PlatformFinishProcess( &build->process );
+        build->running = false;
+
+        printf( "Build %d finished with exit code %d, %d errors, %d warnings\n", build->buildId, exitCode, build->errorCount, build->warningCount );
+
+        if ( build->client )
+        {
+            MP_Encoder encoder = {};
+            BeginEncoder( &encoder, &build->client->responseBlocks );
+            EncodeNotificationHeader( "compile_finished", &encoder );
+            EncodeMap( 4, &encoder );
+            EncodeString( "id", &encoder );
+            EncodeUInt( build->buildId, &encoder );
+            EncodeString( "exit_code", &encoder );
+            EncodeUInt( exitCode, &encoder );
+            EncodeString( "errors", &encoder );
+            EncodeUInt( build->errorCount, &encoder );
+            EncodeString( "warnings", &encoder );
+            EncodeUInt( build->warningCount, &encoder );
+            SendEncoder( build->client, &encoder );
+        }
+        build->client = 0;
+    }
+}
+
+// NOTE: every response queued for one send sees the same snapshot. The first refresh parses what
+// changed, later ones are skipped until the send, so no file arena that a queued reference points
+// into gets reset under it.
+internal bool RefreshParseState( Server_State *server )
+{
+    bool result = false;
+    if ( !server->holdSnapshot || !server->snapshotRefreshed )
+    {
+        u64 refreshStart = ReadTimer();
+        result = ParseChangedFiles( server->parseState, &server->arena, server->watcher );
+        server->refreshTicks += EndPhase( StatPhase_Refresh, refreshStart );
+        server->snapshotRefreshed = true;
+    }
+    return result;
+}
+
+// NOTE: starts the project's build script (build.bat, or build.sh outside of Windows) with its output
+// piped back to us and answers right away, the diagnostics arrive as notifications while the server
+// keeps handling requests
+internal void HandleCompile( Server_State *server, Client_Connection *connection, MP_Encoder *encoder )
+{
+    Build_State *build = &server->build;
+    bool started = false;
+    if ( !build->running )
+    {
+        started = PlatformStartProcess( PLATFORM_BUILD_COMMAND, &build->process );
+        if ( started )
+        {
+            build->client = connection;
+            build->buildId += 1;
+            build->running = true;
+            build->finished = false;
+            build->errorCount = 0;
+            build->warningCount = 0;
+            build->lineLength = 0;
+        }
+    }
+
+    EncodeMap( 3, encoder );
+    EncodeString( "started", encoder );
+    EncodeBool( started, encoder );
+    EncodeString( "running", encoder );
+    EncodeBool( build->running, encoder );
+    EncodeString( "id", encoder );
+    EncodeUInt( build->buildId, encoder );
+}
+
+internal void HandleFindSymbols( Server_State *server, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
+{
+    String query = {};
+    u32 limit = FIND_SYMBOLS_DEFAULT_LIMIT;
+    u8 kindMask = SymbolKind_All;
+    if ( argumentCount > 0 )
+    {
+        query = ParseString( parser );
+    }
+    if ( argumentCount > 1 && !ParseNil( parser ) )
+    {
+        limit = ParseUInt( parser );
+    }
+    if ( argumentCount > 2 && !ParseNil( parser ) )
+    {
+        u32 kindCount = ParseArrayLength( parser );
+        if ( kindCount > 0 )
+        {
+            kindMask = 0;
+        }
+        for ( u32 kindIndex = 0; kindIndex < kindCount; ++kindIndex )
+        {
+            String kind = ParseString( parser );
+            if ( StringsAreEqual( kind, "function" ) ) { kindMask |= SymbolKind_Function; }
+            else if ( StringsAreEqual( kind, "struct" ) ) { kindMask |= SymbolKind_Struct; }
+            else if ( StringsAreEqual( kind, "macro" ) ) { kindMask |= SymbolKind_Macro; }
+        }
+    }
+    if ( limit > FIND_SYMBOLS_MAX_LIMIT )
+    {
+        limit = FIND_SYMBOLS_MAX_LIMIT;
+    }
+
+    Parse_State *parseState = server->parseState;
+    RefreshParseState( server );
+    if ( !server->symbolIndex->built || server->symbolIndex->generation != parseState->generation )
+    {
+        BuildSymbolIndex( server->symbolIndex, parseState );
+    }
+
+    u32 matchCount = FindSymbols( server->symbolIndex, query, limit, kindMask, server->symbolMatches );
+    EncodeSymbolMatches( server->symbolMatches, matchCount, encoder );
+}
+
+internal Declaration_Site *LookUpName( Server_State *server, MP_Parser *parser, u32 argumentCount )
+{
+    String name = {};
+    if ( argumentCount > 0 )
+    {
+        name = ParseString( parser );
+    }
+
+    RefreshParseState( server );
+    UpdateNameIndex( server->nameIndex, server->parseState );
+    return FindDeclarationSites( server->nameIndex, name );
+}
+
+// NOTE: GoToDefinition( name ) response, every place the name is declared:
+// { { file = name, line = N, kind = "function" | "struct" | "macro" } }
+internal void HandleGoToDefinition( Server_State *server, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
+{
+    Declaration_Site *firstSite = LookUpName( server, parser, argumentCount );
+
+    u32 siteCount = 0;
+    for ( Declaration_Site *site = firstSite; site; site = site->nextForName )
+    {
+        siteCount += 1;
+    }
+
+    EncodeArray( siteCount, encoder );
+    for ( Declaration_Site *site = firstSite; site; site = site->nextForName )
+    {
+        EncodeMap( 3, encoder );
+        EncodeString( "file", encoder );
+        EncodeString( site->file->name, encoder );
+        EncodeString( "line", encoder );
+        EncodeUInt( site->line, encoder );
+        EncodeString( "kind", encoder );
+        EncodeString( ( char * ) ( site->kind == SymbolKind_Function ? "function" : site->kind == SymbolKind_Struct ? "struct" : "macro" ), encoder );
+    }
+}
+
+// NOTE: GetSignature( name ) response, one line per function declared with that name, formatted the
+// way the declarations picker shows them: { "return_type name( type name, ... )" }
+internal void HandleGetSignature( Server_State *server, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
+{
+    Declaration_Site *firstSite = LookUpName( server, parser, argumentCount );
+
+    u32 signatureCount = 0;
+    for ( Declaration_Site *site = firstSite; site; site = site->nextForName )
+    {
+        if ( site->kind == SymbolKind_Function )
+        {
+            signatureCount += 1;
+        }
+    }
+
+    EncodeArray( signatureCount, encoder );
+    for ( Declaration_Site *site = firstSite; site; site = site->nextForName )
+    {
+        if ( site->kind == SymbolKind_Function )
+        {
+            // NOTE: a file that changed since it was parsed still gets a line, just without arguments
+            ParseFileDetails( site->file );
+            char signature[ 1024 ];
+            u32 length = FormatFunctionSignature( &site->file->declarations, site->declarationIndex, signature, sizeof( signature ) );
+            EncodeString( String{ length, signature }, encoder );
+        }
+    }
+}
+
+// NOTE: GetStructFields( name ) response, every struct, union or enum declared with that name:
+// { { file = name, line = N, type = "struct" | "union" | "enum", fields = { { type = t, name = n } } } }
+internal void HandleGetStructFields( Server_State *server, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
+{
+    Declaration_Site *firstSite = LookUpName( server, parser, argumentCount );
+
+    u32 structCount = 0;
+    for ( Declaration_Site *site = firstSite; site; site = site->nextForName )
+    {
+        if ( site->kind == SymbolKind_Struct )
+        {
+            structCount += 1;
+        }
+    }
+
+    EncodeArray( structCount, encoder );
+    for ( Declaration_Site *site = firstSite; site; site = site->nextForName )
+    {
+        if ( site->kind == SymbolKind_Struct )
+        {
+            ParseFileDetails( site->file );
+            Declaration_Table *table = &site->file->declarations;
+
+            EncodeMap( 4, encoder );
+            EncodeString( "file", encoder );
+            EncodeString( site->file->name, encoder );
+            EncodeString( "line", encoder );
+            EncodeUInt( site->line, encoder );
+            EncodeString( "type", encoder );
+            EncodeString( GetStructTypeName( table, site->declarationIndex ), encoder );
+            EncodeString( "fields", encoder );
+            EncodeDeclarationFields( table, site->declarationIndex, encoder );
+        }
+    }
+}
+
+internal void WriteIndexIfChanged( Server_State *server )
+{
+    Parse_State *parseState = server->parseState;
+    if ( parseState->generation != server->indexedGeneration )
+    {
+        // NOTE: a failed write is retried after the interval like any other
+        server->lastIndexWrite = ReadTimer();
+        if ( WriteDeclarationIndex( parseState, server->currentDirectory ) )
+        {
+            server->indexedGeneration = parseState->generation;
+        }
+    }
+}
+
+// NOTE: milliseconds until the index is due to be written, -1 while it holds the current generation
+internal int GetIndexWriteTimeout( Server_State *server )
+{
+    int result = -1;
+    if ( server->initialScanDone && server->parseState->generation != server->indexedGeneration )
+    {
+        u64 elapsed = TicksToNanoseconds( ReadTimer() - server->lastIndexWrite ) / 1000000;
+        result = elapsed >= INDEX_WRITE_INTERVAL_MS ? 0 : ( int ) ( INDEX_WRITE_INTERVAL_MS - elapsed );
+    }
+    return result;
+}
+
+internal void HandleGetDeclarations( Server_State *server, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
+{
+    Parse_State *parseState = server->parseState;
+    bool sendUpdate = RefreshParseState( server );
+    if ( !server->initialScanDone )
+    {
+        // NOTE: files loaded from the index didn't change, but the client hasn't seen them yet
+        sendUpdate = true;
+        server->initialScanDone = true;
+        PrintInternStats( GetInternStats() );
+        PrintChunkPoolStats( GetChunkPoolStats() );
+        WriteIndexIfChanged( server );
+    }
+
+    if ( argumentCount > 0 )
+    {
+        u32 sinceGeneration = ParseUInt( parser );
+        // NOTE: a client that doesn't send the epoch can't prove its generation is ours
+        u32 sinceEpoch = 0;
+        if ( argumentCount > 1 && !ParseNil( parser ) )
+        {
+            sinceEpoch = ParseUInt( parser );
+        }
+        EncodeDeclarationsDelta( parseState, sinceEpoch, sinceGeneration, encoder );
+    }
+    else if ( sendUpdate )
+    {
+        EncodeArray( 2, encoder );
+        EncodeBool( sendUpdate, encoder );
+
+        EncodeMap( parseState->fileCount, encoder );
+        for ( u32 fileIndex = 0; fileIndex < parseState->files.count; ++fileIndex )
+        {
+            File_State *file = parseState->files.states[ fileIndex ];
+            if ( !file->removed )
+            {
+                EncodeCachedFileDeclarations( file, encoder );
+            }
+        }
+    }
+    else
+    {
+        EncodeMap( 1, encoder );
+        {
+            EncodeString( "updated", encoder );
+            EncodeBool( sendUpdate, encoder );
+        }
+    }
+}
+
+// NOTE: GetMemoryStats() response, sizes in bytes:
+// { files, main_arena = { used, size }, file_arenas = { ... }, strings = { ... } }
+// Peaks are since startup, the rest is the steady state right now.
+internal void EncodeMemoryStats( Server_State *server, MP_Encoder *encoder )
+{
+    Chunk_Pool_Stats chunks = GetChunkPoolStats();
+    Intern_Stats strings = GetInternStats();
+
+    EncodeMap( 4, encoder );
+    EncodeString( "files", encoder );
+    EncodeUInt( server->parseState->fileCount, encoder );
+
+    EncodeString( "main_arena", encoder );
+    EncodeMap( 2, encoder );
+    EncodeString( "used", encoder );
+    EncodeUInt64( server->arena.used, encoder );
+    EncodeString( "size", encoder );
+    EncodeUInt64( server->arena.size, encoder );
+
+    EncodeString( "file_arenas", encoder );
+    EncodeMap( 7, encoder );
+    EncodeString( "in_use", encoder );
+    EncodeUInt64( chunks.inUseBytes, encoder );
+    EncodeString( "peak_in_use", encoder );
+    EncodeUInt64( chunks.peakInUseBytes, encoder );
+    EncodeString( "free", encoder );
+    EncodeUInt64( chunks.freeBytes, encoder );
+    EncodeString( "committed", encoder );
+    EncodeUInt64( chunks.committedBytes, encoder );
+    EncodeString( "peak_committed", encoder );
+    EncodeUInt64( chunks.peakCommittedBytes, encoder );
+    EncodeString( "chunks", encoder );
+    EncodeUInt( chunks.chunkCount, encoder );
+    EncodeString( "free_chunks", encoder );
+    EncodeUInt( chunks.freeCount, encoder );
+
+    EncodeString( "strings", encoder );
+    EncodeMap( 5, encoder );
+    EncodeString( "requests", encoder );
+    EncodeUInt64( strings.requestCount, encoder );
+    EncodeString( "unique", encoder );
+    EncodeUInt64( strings.uniqueCount, encoder );
+    EncodeString( "requested", encoder );
+    EncodeUInt64( strings.requestedBytes, encoder );
+    EncodeString( "stored", encoder );
+    EncodeUInt64( strings.storedBytes, encoder );
+    EncodeString( "overhead", encoder );
+    EncodeUInt64( strings.overheadBytes, encoder );
+}
+
+// NOTE: GetStats() response, everything since startup:
+// { uptime_ms, phases = { name = { count, total_ns, p50_ns, p99_ns, max_ns } }, counters = { name = N },
+//   memory = same as GetMemoryStats }
+internal void HandleGetStats( Server_State *server, MP_Encoder *encoder )
+{
+    EncodeMap( 4, encoder );
+    EncodeString( "uptime_ms", encoder );
+    EncodeUInt64( GetUptimeMilliseconds(), encoder );
+
+    EncodeString( "phases", encoder );
+    EncodeMap( StatPhase_Count, encoder );
+    for ( u32 phase = 0; phase < StatPhase_Count; ++phase )
+    {
+        Latency_Summary summary = SummarizeLatency( ( Stat_Phase ) phase );
+        EncodeString( StatPhaseNames[ phase ], encoder );
+        EncodeMap( 5, encoder );
+        EncodeString( "count", encoder );
+        EncodeUInt64( summary.count, encoder );
+        EncodeString( "total_ns", encoder );
+        EncodeUInt64( summary.totalNanoseconds, encoder );
+        EncodeString( "p50_ns", encoder );
+        EncodeUInt64( summary.p50Nanoseconds, encoder );
+        EncodeString( "p99_ns", encoder );
+        EncodeUInt64( summary.p99Nanoseconds, encoder );
+        EncodeString( "max_ns", encoder );
+        EncodeUInt64( summary.maxNanoseconds, encoder );
+    }
+
+    EncodeString( "counters", encoder );
+    EncodeMap( StatCounter_Count, encoder );
+    for ( u32 counter = 0; counter < StatCounter_Count; ++counter )
+    {
+        EncodeString( StatCounterNames[ counter ], encoder );
+        EncodeUInt64( GetCounter( ( Stat_Counter ) counter ), encoder );
+    }
+
+    EncodeString( "memory", encoder );
+    EncodeMemoryStats( server, encoder );
+}
+
+// NOTE: GetFileDeclarations( name ) response, { name = declarations } like one entry of the files
+// map in GetDeclarations, empty when the server doesn't know the file
+internal void HandleGetFileDeclarations( Server_State *server, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
+{
+    String name = {};
+    if ( argumentCount > 0 )
+    {
+        name = ParseString( parser );
+    }
+
+    RefreshParseState( server );
+    File_State *file = 0;
+    if ( name.length )
+    {
+        file = FindFileState( &server->parseState->files, name.content, name.length, HashBytes( name.content, name.length ) );
+    }
+
+    if ( file && !file->removed )
+    {
+        EncodeMap( 1, encoder );
+        EncodeCachedFileDeclarations( file, encoder );
+    }
     else
     {
-        result = ( MP_Type ) byte;
+        EncodeMap( 0, encoder );
     }
-
-    return result;
 }
 
-internal u32 ParseArrayLength( MP_Parser *parser )
+// NOTE: Subscribe( generation, epoch ) starts declarations_changed notifications for this connection,
+// the first one carries everything past the generation the client already has (nil means the current
+// one), or everything when the generation is from another epoch. Responds whether changes will
+// actually be pushed, without a watcher the client has to poll.
+internal void HandleSubscribe( Server_State *server, Client_Connection *connection, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
 {
-    u32 result = UINT32_MAX;
-    MP_Type type = GetType( parser );
-
-    switch ( type )
+    u32 generation = server->parseState->generation;
+    if ( argumentCount > 0 && !ParseNil( parser ) )
     {
-        case MP_Type::FIX_ARRAY:
-        {
-            result = *parser->at & 0b00001111;
-            parser->at += 1;
-        }
-        break;
-
-        case MP_Type::ARRAY_16:
+        generation = ParseUInt( parser );
+        u32 epoch = 0;
+        if ( argumentCount > 1 && !ParseNil( parser ) )
         {
-            result = _byteswap_ushort( *( u16 * ) ( parser->at + 1 ) );
-            parser->at += 3;
+            epoch = ParseUInt( parser );
         }
-        break;
-
-        case MP_Type::ARRAY_32:
+        if ( epoch != server->parseState->epoch )
         {
-            result = _byteswap_ulong( *( u32 * ) ( parser->at + 1 ) );
-            parser->at += 5;
+            generation = 0;
         }
-        break;
-
-            InvalidDefaultCase;
     }
 
-    return result;
+    connection->subscribed = true;
+    connection->pushedGeneration = generation;
+    EncodeBool( server->watcher->active, encoder );
 }
 
-internal u32 ParseUInt( MP_Parser *parser )
+// NOTE: the type each command expects at each argument position. Requests are checked against this
+// before a handler sees them, so handlers can parse without looking at types. Missing arguments get
+// the handler's default, arguments past the listed ones are never read.
+enum Argument_Type : u8
 {
-    u32 result = UINT32_MAX;
-    MP_Type type = GetType( parser );
-    switch ( type )
-    {
-        case MP_Type::POSITIVE_FIX_INT:
-        {
-            result = *parser->at & 0b01111111;
-            parser->at += 1;
-        }
-        break;
-
-        case MP_Type::UINT_8:
-        {
-            result = *( parser->at + 1 );
-            parser->at += 2;
-        }
-        break;
-
-        case MP_Type::UINT_16:
-        {
-            result = _byteswap_ushort( *( u16 * ) ( parser->at + 1 ) );
-            parser->at += 3;
-        }
-        break;
-
-        case MP_Type::UINT_32:
-        {
-            result = _byteswap_ulong( *( u32 * ) ( parser->at + 1 ) );
-            parser->at += 5;
-        }
-        break;
+    ArgumentType_String,
+    ArgumentType_UInt,
+    ArgumentType_UIntOrNil,
+    ArgumentType_StringsOrNil,
+    ArgumentType_ArrayOrNil,
+};
 
-            InvalidDefaultCase;
-    }
-    return result;
-}
+struct Command_Arguments
+{
+    char *command;
+    u32 count;
+    Argument_Type types[ 3 ];
+};
 
-struct String
+global_variable Command_Arguments GlobalCommandArguments[] =
 {
-    u32 length;
-    char *content;
+    { "FindSymbols", 3, { ArgumentType_String, ArgumentType_UIntOrNil, ArgumentType_StringsOrNil } },
+    { "GoToDefinition", 1, { ArgumentType_String } },
+    { "GetSignature", 1, { ArgumentType_String } },
+    { "GetStructFields", 1, { ArgumentType_String } },
+    { "GetDeclarations", 2, { ArgumentType_UInt, ArgumentType_UIntOrNil } },
+    { "GetFileDeclarations", 1, { ArgumentType_String } },
+    { "Subscribe", 2, { ArgumentType_UIntOrNil, ArgumentType_UIntOrNil } },
+    // NOTE: the sub-requests are checked one by one as the batch runs
+    { "BatchRequest", 1, { ArgumentType_ArrayOrNil } },
 };
 
-internal String ParseString( MP_Parser *parser )
+internal bool ArgumentHasType( MP_Parser *parser, Argument_Type argumentType )
 {
-    String result = {};
     MP_Type type = GetType( parser );
-    switch ( type )
+    bool result = false;
+    switch ( argumentType )
     {
-        case MP_Type::FIX_STRING:
+        case ArgumentType_String:
+        {
+            result = IsStringType( type );
+        }
+        break;
+
+        case ArgumentType_UInt:
         {
-            result.length = *parser->at & 0b00011111;
-            result.content = ( char * ) ( parser->at + 1 );
-            parser->at += result.length + 1;
+            result = IsUIntType( type );
         }
         break;
 
-        case MP_Type::STRING_8:
+        case ArgumentType_UIntOrNil:
         {
-            result.length = *( parser->at + 1 );
-            result.content = ( char * ) ( parser->at + 2 );
-            parser->at += result.length + 2;
+            result = type == MP_Type::NIL || IsUIntType( type );
         }
         break;
 
-        case MP_Type::STRING_16:
+        case ArgumentType_StringsOrNil:
         {
-            result.length = _byteswap_ushort( *( u16 * ) ( parser->at + 1 ) );
-            result.content = ( char * ) ( parser->at + 3 );
-            parser->at += result.length + 3;
+            result = type == MP_Type::NIL || IsArrayType( type );
+            if ( result && type != MP_Type::NIL )
+            {
+                MP_Parser elements = *parser;
+                u32 elementCount = ParseArrayLength( &elements );
+                for ( u32 elementIndex = 0; elementIndex < elementCount && result; ++elementIndex )
+                {
+                    result = IsStringType( GetType( &elements ) );
+                    SkipValue( &elements );
+                }
+            }
         }
         break;
 
-        case MP_Type::STRING_32:
+        case ArgumentType_ArrayOrNil:
         {
-            result.length = _byteswap_ulong( *( u32 * ) ( parser->at + 1 ) );
-            result.content = ( char * ) ( parser->at + 5 );
-            parser->at += result.length + 5;
+            result = type == MP_Type::NIL || IsArrayType( type );
         }
         break;
 
             InvalidDefaultCase;
     }
-
     return result;
 }
 
-struct MP_Encoder
+// NOTE: the parser is at the first argument and stays there
+internal bool ArgumentsAreWellFormed( String command, MP_Parser *parser, u32 argumentCount )
 {
-    u8 *at;
-    u32 length;
-};
+    for ( u32 commandIndex = 0; commandIndex < ArrayCount( GlobalCommandArguments ); ++commandIndex )
+    {
+        Command_Arguments *expected = GlobalCommandArguments + commandIndex;
+        if ( StringsAreEqual( command, expected->command ) )
+        {
+            MP_Parser argument = *parser;
+            for ( u32 argumentIndex = 0; argumentIndex < argumentCount && argumentIndex < expected->count; ++argumentIndex )
+            {
+                if ( !ArgumentHasType( &argument, expected->types[ argumentIndex ] ) )
+                {
+                    return false;
+                }
+                SkipValue( &argument );
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+internal void HandleBatchRequest( Server_State *server, Client_Connection *connection, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder );
 
-internal void EncodeUInt( u32 value, MP_Encoder *encoder )
+// NOTE: the parser is at the first argument, exactly one object goes into the encoder
+internal void HandleCommand( Server_State *server, Client_Connection *connection, String command, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
 {
-    if ( value < 128 )
+    if ( StringsAreEqual( command, "Exit" ) )
     {
-        *( ( u8 * ) encoder->at ) = ( u8 ) value;
-        encoder->at += 1;
-        encoder->length += 1;
+        EncodeUInt( 0, encoder );
+        printf( "Exit command received!\n" );
+        // NOTE: other editors may still be using the server, it only shuts down with the last one
+        connection->closing = true;
+        if ( server->connectionCount == 1 )
+        {
+            server->running = false;
+        }
     }
-    else if ( value <= 0xFF )
+    else if ( StringsAreEqual( command, "Compile" ) )
     {
-        *encoder->at = MP_Type::UINT_8;
-        encoder->at += 1;
-        *( ( u8 * ) encoder->at ) = ( u8 ) value;
-        encoder->at += 1;
-        encoder->length += 2;
+        HandleCompile( server, connection, encoder );
     }
-    else if ( value <= 0xFFFF )
+    else if ( StringsAreEqual( command, "FindSymbols" ) )
     {
-        *encoder->at = MP_Type::UINT_16;
-        encoder->at += 1;
-        *( ( u16 * ) encoder->at ) = _byteswap_ushort( ( u16 ) value );
-        encoder->at += 2;
-        encoder->length += 3;
+        HandleFindSymbols( server, parser, argumentCount, encoder );
     }
-    else
+    else if ( StringsAreEqual( command, "GoToDefinition" ) )
     {
-        *encoder->at = MP_Type::UINT_32;
-        encoder->at += 1;
-        *( ( u32 * ) encoder->at ) = _byteswap_ulong( ( u32 ) value );
-        encoder->at += 4;
-        encoder->length += 5;
+        HandleGoToDefinition( server, parser, argumentCount, encoder );
     }
-}
-
-internal void EncodeNil( MP_Encoder *encoder )
-{
-    *encoder->at = MP_Type::NIL;
-    encoder->at += 1;
-    encoder->length += 1;
-}
-
-internal void EncodeMap( u32 length, MP_Encoder *encoder )
-{
-    if ( length < 16 )
+    else if ( StringsAreEqual( command, "GetSignature" ) )
+    {
+        HandleGetSignature( server, parser, argumentCount, encoder );
+    }
+    else if ( StringsAreEqual( command, "GetStructFields" ) )
+    {
+        HandleGetStructFields( server, parser, argumentCount, encoder );
+    }
+    else if ( StringsAreEqual( command, "GetDeclarations" ) )
+    {
+        HandleGetDeclarations( server, parser, argumentCount, encoder );
+    }
+    else if ( StringsAreEqual( command, "GetFileDeclarations" ) )
+    {
+        HandleGetFileDeclarations( server, parser, argumentCount, encoder );
+    }
+    else if ( StringsAreEqual( command, "GetMemoryStats" ) )
+    {
+        EncodeMemoryStats( server, encoder );
+    }
+    else if ( StringsAreEqual( command, "GetStats" ) )
+    {
+        HandleGetStats( server, encoder );
+    }
+    else if ( StringsAreEqual( command, "Subscribe" ) )
+    {
+        HandleSubscribe( server, connection, parser, argumentCount, encoder );
+    }
+    else if ( StringsAreEqual( command, "Unsubscribe" ) )
     {
-        *encoder->at = MP_Type::FIX_MAP | ( u8 ) length;
-        encoder->at += 1;
-        encoder->length += 1;
+        connection->subscribed = false;
+        EncodeBool( true, encoder );
     }
-    else if ( length <= 0xFFFF )
+    else if ( StringsAreEqual( command, "BatchRequest" ) )
     {
-        *encoder->at = MP_Type::MAP_16;
-        encoder->at += 1;
-        *( ( u16 * ) encoder->at ) = _byteswap_ushort( ( u16 ) length );
-        encoder->at += 2;
-        encoder->length += 3;
+        HandleBatchRequest( server, connection, parser, argumentCount, encoder );
     }
     else
     {
-        *encoder->at = MP_Type::MAP_32;
-        encoder->at += 1;
-        *( ( u32 * ) encoder->at ) = _byteswap_ulong( ( u32 ) length );
-        encoder->at += 4;
-        encoder->length += 5;
+        EncodeNil( encoder );
     }
 }
 
-internal void EncodeArray( u32 length, MP_Encoder *encoder )
+// NOTE: BatchRequest( { { method, { arguments } }, ... } ) response, one result per sub-request in
+// the same order, nil for the ones that aren't well formed. Batches don't nest.
+internal void HandleBatchRequest( Server_State *server, Client_Connection *connection, MP_Parser *parser, u32 argumentCount, MP_Encoder *encoder )
 {
-    if ( length < 16 )
-    {
-        *encoder->at = MP_Type::FIX_ARRAY | ( u8 ) length;
-        encoder->at += 1;
-        encoder->length += 1;
-    }
-    else if ( length <= 0xFFFF )
+    if ( argumentCount == 0 || GetType( parser ) == MP_Type::NIL )
     {
-        *encoder->at = MP_Type::ARRAY_16;
-        encoder->at += 1;
-        *( ( u16 * ) encoder->at ) = _byteswap_ushort( ( u16 ) length );
-        encoder->at += 2;
-        encoder->length += 3;
+        EncodeArray( 0, encoder );
+        return;
     }
-    else
+
+    u32 requestCount = ParseArrayLength( parser );
+    EncodeArray( requestCount, encoder );
+    for ( u32 requestIndex = 0; requestIndex < requestCount; ++requestIndex )
     {
-        *encoder->at = MP_Type::ARRAY_32;
-        encoder->at += 1;
-        *( ( u32 * ) encoder->at ) = _byteswap_ulong( ( u32 ) length );
-        encoder->at += 4;
-        encoder->length += 5;
+        // NOTE: handlers don't always read every argument, the next sub-request starts wherever
+        // this one ends
+        MP_Parser next = *parser;
+        SkipValue( &next );
+
+        bool wellFormed = IsArrayType( GetType( parser ) ) && ParseArrayLength( parser ) == 2 && IsStringType( GetType( parser ) );
+
+        String command = {};
+        if ( wellFormed )
+        {
+            command = ParseString( parser );
+            wellFormed = IsArrayType( GetType( parser ) ) && !StringsAreEqual( command, "BatchRequest" );
+        }
+
+        u32 subArgumentCount = 0;
+        if ( wellFormed )
+        {
+            subArgumentCount = ParseArrayLength( parser );
+            wellFormed = ArgumentsAreWellFormed( command, parser, subArgumentCount );
+        }
+
+        if ( wellFormed )
+        {
+            HandleCommand( server, connection, command, parser, subArgumentCount, encoder );
+        }
+        else
+        {
+            EncodeNil( encoder );
+        }
+        *parser = next;
     }
 }
 
-internal void EncodeString( String string, MP_Encoder *encoder )
+// NOTE: request is [ 0, messageId, method, [ arguments ] ], the response goes into the encoder.
+// Anything else (notifications from the client) gets no response, a request with a method or
+// arguments of the wrong type gets [ 1, messageId, "error", nil ].
+internal void HandleRequest( Server_State *server, Client_Connection *connection, u8 *request, MP_Encoder *encoder )
 {
-    u64 length = string.length;
+    MP_Parser parser = {};
+    parser.at = request;
+
+    if ( GetType( &parser ) != MP_Type::FIX_ARRAY || ParseArrayLength( &parser ) != 4 ||
+         GetType( &parser ) != MP_Type::POSITIVE_FIX_INT || ParseUInt( &parser ) != 0 ||
+         !IsUIntType( GetType( &parser ) ) )
+    {
+        printf( "Ignoring message that isn't a request\n" );
+        return;
+    }
+
+    u32 messageId = ParseUInt( &parser );
+    AddToCounter( StatCounter_Requests, 1 );
 
-    if ( length < 32 )
+    String command = {};
+    u32 argumentCount = 0;
+    bool wellFormed = IsStringType( GetType( &parser ) );
+    if ( wellFormed )
     {
-        *encoder->at = MP_Type::FIX_STRING | ( u8 ) length;
-        encoder->at += 1;
-        encoder->length += 1;
+        command = ParseString( &parser );
+        wellFormed = IsArrayType( GetType( &parser ) );
     }
-    else if ( length <= 0xFF )
+    if ( wellFormed )
     {
-        *encoder->at = MP_Type::STRING_8;
-        encoder->at += 1;
-        *encoder->at = ( u8 ) length;
-        encoder->at += 1;
-        encoder->length += 2;
+        argumentCount = ParseArrayLength( &parser );
+        printf( "Received command: %.*s with %d arguments\n", command.length, command.content, argumentCount );
+        wellFormed = ArgumentsAreWellFormed( command, &parser, argumentCount );
     }
-    else if ( length <= 0xFFFF )
+
+    EncodeArray( 4, encoder );
+    EncodeUInt( 1, encoder );
+    EncodeUInt( messageId, encoder );
+    if ( wellFormed )
     {
-        *encoder->at = MP_Type::STRING_16;
-        encoder->at += 1;
-        *( ( u16 * ) encoder->at ) = _byteswap_ushort( ( u16 ) length );
-        encoder->at += 1;
-        encoder->length += 3;
+        EncodeNil( encoder );
+        HandleCommand( server, connection, command, &parser, argumentCount, encoder );
     }
     else
     {
-        *encoder->at = MP_Type::STRING_32;
-        encoder->at += 1;
-        *( ( u32 * ) encoder->at ) = _byteswap_ulong( ( u32 ) length );
-        encoder->at += 1;
-        encoder->length += 5;
+        printf( "Ignoring malformed request %u\n", messageId );
+        EncodeString( "error", encoder );
+        EncodeNil( encoder );
     }
+}
 
-    for ( u64 characterIndex = 0; characterIndex < length; ++characterIndex )
+// NOTE: declarations_changed notification, same payload as a GetDeclarations( generation ) response
+// with only the files that changed since the last one this connection got. A connection that still
+// has a queue gets nothing new until it caught up, its next push then covers everything since.
+internal void PushDeclarationChanges( Server_State *server )
+{
+    Parse_State *parseState = server->parseState;
+    for ( u32 connectionIndex = 0; connectionIndex < server->connectionCount; ++connectionIndex )
     {
-        *encoder->at = ( u8 ) string.content[ characterIndex ];
-        encoder->at += 1;
+        Client_Connection *connection = server->connections[ connectionIndex ];
+        if ( connection->subscribed && connection->pushedGeneration != parseState->generation && !connection->firstQueued )
+        {
+            MP_Encoder encoder = {};
+            BeginEncoder( &encoder, &connection->responseBlocks );
+            EncodeNotificationHeader( "declarations_changed", &encoder );
+            EncodeDeclarationsDelta( parseState, parseState->epoch, connection->pushedGeneration, &encoder );
+            connection->pushedGeneration = parseState->generation;
+
+            // NOTE: a failed socket wakes up the event loop, which then closes it
+            SendEncoder( connection, &encoder );
+        }
     }
-    encoder->length += ( u32 ) length;
 }
 
-internal void EncodeString( char *string, MP_Encoder *encoder )
+inline bool HasSubscribers( Server_State *server )
 {
-    EncodeString( String{ ( u32 ) strlen( string ), string }, encoder );
+    bool result = false;
+    for ( u32 connectionIndex = 0; connectionIndex < server->connectionCount; ++connectionIndex )
+    {
+        if ( server->connections[ connectionIndex ]->subscribed )
+        {
+            result = true;
+            break;
+        }
+    }
+    return result;
 }
 
-inline void EncodeBool( bool value, MP_Encoder *encoder )
+internal void CloseConnection( Server_State *server, Client_Connection *connection )
 {
-    if ( value )
+    printf( "Client disconnected\n" );
+    if ( server->build.client == connection )
     {
-        *encoder->at = MP_Type::BOOL_TRUE;
+        server->build.client = 0;
     }
-    else
+    PlatformRemoveSocket( &server->socketSet, connection->socket );
+    PlatformCloseSocket( connection->socket );
+    while ( connection->firstQueued )
     {
-        *encoder->at = MP_Type::BOOL_FALSE;
+        Send_Queue_Block *next = connection->firstQueued->next;
+        PlatformFreeMemory( connection->firstQueued );
+        connection->firstQueued = next;
     }
-    encoder->at += 1;
-    encoder->length += 1;
-}
+    PlatformFreeMemory( connection->receive.base );
+    ReleaseBlockPool( &connection->responseBlocks );
+    PlatformFreeMemory( connection );
 
-inline bool StringsAreEqual( String a, char *b )
-{
-    char *at = b;
-    for ( u64 index = 0; index < a.length; ++index, ++at )
+    // NOTE: the last connection takes the freed spot
+    for ( u32 connectionIndex = 0; connectionIndex < server->connectionCount; ++connectionIndex )
     {
-        if ( *at == '\0' || a.content[ index ] != *at )
+        if ( server->connections[ connectionIndex ] == connection )
         {
-            return false;
+            server->connections[ connectionIndex ] = server->connections[ --server->connectionCount ];
+            break;
         }
     }
 
-    bool result = *at == '\0';
-    return result;
+    // NOTE: nobody is editing anymore, a good time to save what the session changed
+    if ( server->connectionCount == 0 )
+    {
+        WriteIndexIfChanged( server );
+    }
 }
 
-inline u32 StringToUInt( Token string )
+internal void AcceptConnection( Server_State *server )
 {
-    u32 result = 0;
-    for ( u32 i = 0; i < string.textLength; ++i )
+    Platform_Socket clientSocket = PlatformAccept( server->listenSocket );
+    if ( clientSocket == PLATFORM_INVALID_SOCKET )
     {
-        result += ( u32 ) ( pow( 10, ( f64 ) ( string.textLength - 1 - i ) ) ) * ( u32 ) ( string.text[ i ] - '0' );
+        printf( "Accept failed: %d\n", PlatformGetSocketError() );
+        return;
     }
-    return result;
-}
 
-inline u32 StringToUInt( String string )
-{
-    u32 result = 0;
-    for ( u32 i = 0; i < string.length; ++i )
+    if ( server->connectionCount == MAX_CONNECTIONS )
     {
-        result += ( u32 ) ( pow( 10, ( f64 ) ( string.length - 1 - i ) ) ) * ( u32 ) ( string.content[ i ] - '0' );
+        printf( "Too many connections, refusing client\n" );
+        PlatformCloseSocket( clientSocket );
+        return;
     }
-    return result;
+
+    Client_Connection *connection = ( Client_Connection * ) PlatformAllocateMemory( sizeof( Client_Connection ) );
+    if ( !connection || !PlatformAddSocket( &server->socketSet, clientSocket, connection, SocketEvent_Read ) )
+    {
+        printf( "Couldn't wait on the new connection, refusing client\n" );
+        PlatformFreeMemory( connection );
+        PlatformCloseSocket( clientSocket );
+        return;
+    }
+    connection->socket = clientSocket;
+    connection->waitEvents = SocketEvent_Read;
+    ResetFrameScanner( &connection->scanner );
+    server->connections[ server->connectionCount++ ] = connection;
+    printf( "Client connected\n" );
 }
 
-int main()
+// NOTE: returns false when the connection should be closed. Queued responses go out first, then
+// whatever arrived is read. Every complete request in the stream is answered in order until the
+// send queue grows past SEND_QUEUE_READ_LIMIT, the rest wait for it to drain. A partial request at
+// the end stays buffered for the next read.
+internal bool ServiceConnection( Server_State *server, Client_Connection *connection, u32 events )
 {
-    void *memoryBase = calloc( Megabytes( 200 ), 1 );
-    Memory_Arena arena;
-    InitializeArena( &arena, Megabytes( 200 ), memoryBase );
-
-    WSADATA wsaData;
-    int result = WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
-    if ( result != 0 )
+    if ( ( events & SocketEvent_Write ) && !FlushSendQueue( connection ) )
     {
-        printf( "WSAStartup failed: %d\n", result );
-        return 1;
+        return false;
     }
 
-    addrinfo *info;
-    addrinfo hints = {};
+    Stream_Buffer *stream = &connection->receive;
+    if ( ( events & SocketEvent_Read ) && ( connection->waitEvents & SocketEvent_Read ) )
+    {
+        if ( !ReserveStreamSpace( stream, DEFAULT_BUFFER_LENGTH ) )
+        {
+            printf( "Request too large, dropping client\n" );
+            return false;
+        }
 
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = IPPROTO_TCP;
-    hints.ai_flags = AI_PASSIVE;
+        int bytesReceived = PlatformReceive( connection->socket, stream->base + stream->end, stream->size - stream->end );
+        if ( bytesReceived <= 0 )
+        {
+            return false;
+        }
+        stream->end += bytesReceived;
+    }
 
-    result = getaddrinfo( 0, DEFAULT_PORT, &hints, &info );
+    // NOTE: requests that arrived together are answered together, their responses are collected in
+    // order and go out in one gathered send (or a few, for very large batches)
+    MP_Encoder encoder = {};
+    BeginEncoder( &encoder, &connection->responseBlocks );
+    server->holdSnapshot = true;
+    server->snapshotRefreshed = false;
 
-    if ( result != 0 )
+    bool result = true;
+    u32 responseCount = 0;
+    while ( !connection->closing && stream->start < stream->end && connection->queuedBytes <= SEND_QUEUE_READ_LIMIT )
     {
-        printf( "getaddrinfo failed %d\n", result );
-        WSACleanup();
-        return 1;
-    }
+        u8 *request = stream->base + stream->start;
+        MP_Frame_Result frame = ScanFrame( &connection->scanner, request, stream->end - stream->start );
+        if ( frame == MP_Frame_Incomplete )
+        {
+            break;
+        }
+        if ( frame == MP_Frame_Invalid )
+        {
+            printf( "Malformed request, dropping client\n" );
+            result = false;
+            break;
+        }
+
+        u32 lengthBefore = encoder.length;
+        u64 refreshTicksBefore = server->refreshTicks;
+        u64 requestStart = ReadTimer();
+        HandleRequest( server, connection, request, &encoder );
+        u64 requestTicks = ReadTimer() - requestStart - ( server->refreshTicks - refreshTicksBefore );
+        if ( encoder.length > lengthBefore )
+        {
+            RecordPhase( StatPhase_Encode, requestTicks );
+            responseCount += 1;
+        }
 
-    SOCKET listenSocket = INVALID_SOCKET;
+        stream->start += connection->scanner.offset;
+        ResetFrameScanner( &connection->scanner );
 
-    listenSocket = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+        if ( encoder.length >= PIPELINE_FLUSH_SIZE )
+        {
+            if ( !SendEncoder( connection, &encoder ) )
+            {
+                result = false;
+                break;
+            }
+            printf( "%u responses sent!\n", responseCount );
+            responseCount = 0;
+            BeginEncoder( &encoder, &connection->responseBlocks );
+            server->snapshotRefreshed = false;
+        }
+    }
 
-    if ( listenSocket == INVALID_SOCKET )
+    // NOTE: whatever was answered before a malformed request still goes out
+    if ( encoder.length > 0 )
     {
-        printf( "Socket creation failed: %d\n", WSAGetLastError() );
-        freeaddrinfo( info );
-        WSACleanup();
-        return 1;
+        if ( SendEncoder( connection, &encoder ) )
+        {
+            printf( "%u responses sent!\n", responseCount );
+        }
+        else
+        {
+            result = false;
+        }
+    }
+    else
+    {
+        EndEncoder( &encoder );
     }
+    server->holdSnapshot = false;
 
-    result = bind( listenSocket, info->ai_addr, ( int ) info->ai_addrlen );
+    if ( !result || ( connection->closing && !connection->firstQueued ) )
+    {
+        return false;
+    }
 
-    if ( result == SOCKET_ERROR )
+    if ( stream->start == stream->end )
     {
-        printf( "bind failed: %d\n", WSAGetLastError() );
-        freeaddrinfo( info );
-        closesocket( listenSocket );
-        WSACleanup();
-        return 1;
+        stream->start = 0;
+        stream->end = 0;
     }
 
-    freeaddrinfo( info );
+    return true;
+}
 
-    if ( listen( listenSocket, SOMAXCONN ) == SOCKET_ERROR )
+// NOTE: a connection waits for writability while it has a queue, and stops reading while the queue
+// is over the limit or it is closing
+internal bool UpdateWaitEvents( Server_State *server, Client_Connection *connection )
+{
+    u32 waitEvents = 0;
+    if ( !connection->closing && connection->queuedBytes <= SEND_QUEUE_READ_LIMIT )
     {
-        printf( "Listen failed: %d\n", WSAGetLastError() );
-        closesocket( listenSocket );
-        WSACleanup();
-        return 1;
+        waitEvents |= SocketEvent_Read;
+    }
+    if ( connection->firstQueued )
+    {
+        waitEvents |= SocketEvent_Write;
     }
 
-    SOCKET clientSocket = INVALID_SOCKET;
+    bool result = true;
+    if ( waitEvents != connection->waitEvents )
+    {
+        result = PlatformChangeSocketEvents( &server->socketSet, connection->socket, connection, waitEvents );
+        connection->waitEvents = waitEvents;
+    }
+    return result;
+}
 
-    clientSocket = accept( listenSocket, 0, 0 );
+// usage: nvim-cpp.exe [--stats seconds] [--lazy-details] [--scan-kernels scalar|sse2]
+// --stats prints the phase timings and counters every that many seconds
+// --lazy-details parses arguments and fields only once GetSignature or GetStructFields asks for them,
+//                until then the declarations go out with empty argument and field lists
+// --scan-kernels pins the tokenizer kernels, the default is SSE2 on x86-64
+int main( int argc, char **argv )
+{
+    InitializeStats();
+    InitializeScanKernels();
 
-    if ( clientSocket == INVALID_SOCKET )
+    Server_State *server = ( Server_State * ) calloc( 1, sizeof( Server_State ) );
+    for ( int argumentIndex = 1; argumentIndex < argc; ++argumentIndex )
     {
-        printf( "Accept failed: %d\n", WSAGetLastError() );
-        closesocket( listenSocket );
-        WSACleanup();
-        return 1;
+        if ( strcmp( argv[ argumentIndex ], "--stats" ) == 0 && argumentIndex + 1 < argc )
+        {
+            server->statsDumpSeconds = ( u32 ) atoi( argv[ ++argumentIndex ] );
+        }
+        else if ( strcmp( argv[ argumentIndex ], "--lazy-details" ) == 0 )
+        {
+            GlobalLazyDetails = true;
+        }
+        else if ( strcmp( argv[ argumentIndex ], "--scan-kernels" ) == 0 && argumentIndex + 1 < argc )
+        {
+            Scan_Level level;
+            if ( !FindScanLevel( argv[ ++argumentIndex ], &level ) )
+            {
+                printf( "Unknown tokenizer kernels %s\n", argv[ argumentIndex ] );
+                return 1;
+            }
+            SelectScanKernels( level );
+        }
     }
+    printf( "Using %s tokenizer kernels\n", GlobalScan.name );
+    server->lastStatsDump = ReadTimer();
+    void *memoryBase = calloc( Megabytes( 200 ), 1 );
+    Memory_Arena *arena = &server->arena;
+    InitializeArena( arena, Megabytes( 200 ), memoryBase );
 
-    u8 receiveBuffer[ DEFAULT_BUFFER_LENGTH ] = {};
+    if ( !PlatformInitializeSockets() )
+    {
+        return 1;
+    }
 
-    u8 *responseBuffer = PushArray( &arena, Megabytes( 3 ), u8 );
+    server->listenSocket = PlatformListen( DEFAULT_PORT );
+    if ( server->listenSocket == PLATFORM_INVALID_SOCKET )
+    {
+        PlatformShutdownSockets();
+        return 1;
+    }
 
     printf( "Listening for messages...\n" );
 
-    MP_Parser parser = {};
-    MP_Encoder encoder = {};
+    Parse_State *parseState = PushStruct( arena, Parse_State );
+    parseState->workQueue = PushStruct( arena, Work_Queue );
+    InitializeInternTable( PlatformGetProcessorCount() );
+    InitializeWorkQueue( parseState->workQueue, PlatformGetProcessorCount() - 1 );
+    server->parseState = parseState;
+    // NOTE: only has to differ from the last process's, the startup time is as good as random here
+    u64 startTicks = ReadTimer();
+    parseState->epoch = ( u32 ) HashBytes( &startTicks, sizeof( startTicks ) ) | 1;
 
-    Parse_State *parseState = PushStruct( &arena, Parse_State );
-
-    char currentDirectory[ 256 ] = {};
-    GetCurrentDirectory( sizeof( currentDirectory ), currentDirectory );
-    bool running = true;
-    do
-    {
-        int bytesReceived = recv( clientSocket, ( char * ) receiveBuffer, sizeof( receiveBuffer ), 0 );
+    PlatformGetCurrentDirectory( server->currentDirectory, sizeof( server->currentDirectory ) );
 
-        if ( bytesReceived > 0 )
-        {
-            parser.at = receiveBuffer;
+    server->watcher = PushStruct( arena, File_Watcher );
+    StartFileWatcher( server->watcher, server->currentDirectory );
 
-            u32 arrayLength = ParseArrayLength( &parser );
-            Assert( arrayLength == 4 );
+    LoadDeclarationIndex( parseState, arena, server->currentDirectory );
+    server->indexedGeneration = parseState->generation;
+    server->initialScanDone = false;
 
-            u32 interactionType = ParseUInt( &parser );
-            Assert( interactionType == 0 );
+    server->symbolIndex = PushStruct( arena, Symbol_Index );
+    server->symbolMatches = PushArray( arena, FIND_SYMBOLS_MAX_LIMIT, Symbol_Match );
+    server->nameIndex = PushStruct( arena, Name_Index );
 
-            u32 messageId = ParseUInt( &parser );
-            String command = ParseString( &parser );
+    if ( !PlatformCreateSocketSet( &server->socketSet ) ||
+         !PlatformAddSocket( &server->socketSet, server->listenSocket, 0, SocketEvent_Read ) )
+    {
+        printf( "Couldn't wait on the listening socket: %d\n", PlatformGetLastError() );
+        PlatformCloseSocket( server->listenSocket );
+        PlatformShutdownSockets();
+        return 1;
+    }
 
-            arrayLength = ParseArrayLength( &parser );
+    // NOTE: single threaded event loop, one thread serves every connection in turn. Each connection
+    // shows up at most once per wait and only its own turn can close it, so the events stay valid
+    // while they are worked through.
+    local_persist Platform_Socket_Event events[ 64 ];
+    server->running = true;
+    while ( server->running )
+    {
+        // NOTE: pipes can't be waited on together with sockets everywhere, so while a build runs we wake up
+        // regularly to read its output. The watcher can't wake us either, with subscribers around we check
+        // it on a timer.
+        bool subscribers = HasSubscribers( server );
+        int timeoutMilliseconds = -1;
+        if ( server->build.running )
+        {
+            timeoutMilliseconds = BUILD_POLL_INTERVAL_MS;
+        }
+        else if ( subscribers && server->watcher->active )
+        {
+            timeoutMilliseconds = PUSH_POLL_INTERVAL_MS;
+        }
+        else if ( server->statsDumpSeconds )
+        {
+            timeoutMilliseconds = ( int ) server->statsDumpSeconds * 1000;
+        }
+        int indexTimeout = GetIndexWriteTimeout( server );
+        if ( indexTimeout >= 0 && ( timeoutMilliseconds < 0 || indexTimeout < timeoutMilliseconds ) )
+        {
+            timeoutMilliseconds = indexTimeout;
+        }
+        int eventCount = PlatformWaitForSocketEvents( &server->socketSet, events, ArrayCount( events ), timeoutMilliseconds );
+        if ( eventCount < 0 )
+        {
+            printf( "Waiting on the sockets failed: %d\n", PlatformGetSocketError() );
+            break;
+        }
 
-            printf( "Received command: %.*s with %d arguments\n", command.length, command.content, arrayLength );
-            if ( arrayLength > 0 )
+        bool accept = false;
+        for ( int eventIndex = 0; eventIndex < eventCount && server->running; ++eventIndex )
+        {
+            Client_Connection *connection = ( Client_Connection * ) events[ eventIndex ].user;
+            if ( !connection )
             {
-                // parse arguments
+                accept = true;
             }
+            else if ( !ServiceConnection( server, connection, events[ eventIndex ].events ) )
+            {
+                CloseConnection( server, connection );
+            }
+        }
 
-            encoder.at = responseBuffer;
-            encoder.length = 0;
+        if ( server->running && accept )
+        {
+            AcceptConnection( server );
+        }
 
-            EncodeArray( 4, &encoder );
-            EncodeUInt( 1, &encoder );
-            EncodeUInt( messageId, &encoder );
-            EncodeNil( &encoder );
+        if ( server->build.running )
+        {
+            PollBuild( &server->build );
+        }
 
-            if ( StringsAreEqual( command, "Exit" ) )
-            {
-                EncodeUInt( 0, &encoder );
-                printf( "Exit command received!\n" );
-                running = false;
-            }
-            else if ( StringsAreEqual( command, "Compile" ) )
-            {
-                EncodeMap( 2, &encoder );
-                // STARTUPINFO startInfo = {};
-                // startInfo.cb = sizeof( info );
-                // PROCESS_INFORMATION processInfo = {};
-                // bool created = CreateProcess( 0, "build.bat", 0, 0, false, 0, 0, 0, &startInfo, &processInfo );
-                SHELLEXECUTEINFO info = {};
-                info.cbSize = sizeof( info );
-                info.fMask = SEE_MASK_NOCLOSEPROCESS;
-                info.lpVerb = "open";
-                info.lpFile = "build.bat";
-                info.lpParameters = "> compilation.log";
-                // info.nShow = SW_SHOWNORMAL;
-                info.nShow = SW_HIDE;
-                bool started = ShellExecuteEx( &info );
-                EncodeString( "started", &encoder );
-                EncodeBool( started, &encoder );
-                EncodeString( "messages", &encoder );
-                u8 *arrayCountSpot = encoder.at;
-                EncodeArray( 1000, &encoder );
-
-                if ( started )
-                {
-                    WaitForSingleObject( info.hProcess, INFINITE );
-
-                    char *compilationFile = ReadEntireFileIntoMemoryAndNullTerminate( "compilation.log" );
-                    if ( compilationFile )
-                    {
-                        Tokenizer tokenizer = {};
-                        tokenizer.at = compilationFile;
-                        bool parsing = true;
-                        u32 errorCount = 0;
-                        while ( parsing )
-                        {
-                            Token token = GetToken( &tokenizer );
-                            switch ( token.type )
-                            {
-                                case Token_Type::Colon:
-                                {
-                                    Token nextToken = GetToken( &tokenizer );
-                                    if ( nextToken.type == Token_Type::Identifier && ( TokenEquals( nextToken, "error" ) ||
-                                                                                       TokenEquals( nextToken, "fatal" ) ||
-                                                                                       TokenEquals( nextToken, "warning" ) ) )
-                                    {
-                                        char *temp = tokenizer.at;
-                                        while ( *temp != '\n' )
-                                        {
-                                            --temp;
-                                        }
-                                        ++temp;
-
-                                        Tokenizer errorTokenizer = {};
-                                        errorTokenizer.at = temp;
-
-                                        char *fileStart = temp;
-                                        char *fileEnd = 0;
-                                        Token errorToken = GetToken( &errorTokenizer );
-                                        if ( TokenEquals( errorToken, "LINK" ) )
-                                        {
-                                            fileEnd = errorTokenizer.at;
-                                        }
-                                        else
-                                        {
-                                            while ( errorToken.type != Token_Type::OpenParen )
-                                            {
-                                                errorToken = GetToken( &errorTokenizer );
-                                            }
-                                            fileEnd = errorTokenizer.at - 1;
-                                        }
-
-                                        String filename;
-                                        filename.content = fileStart;
-                                        filename.length = ( u32 ) ( fileEnd - fileStart );
-
-                                        Token line = {};
-                                        Token column = {};
-                                        if ( errorToken.type == Token_Type::OpenParen )
-                                        {
-                                            line = GetToken( &errorTokenizer );
-                                            // printf( "line %d ", StringToUInt( line ) );
-                                            errorToken = GetToken( &errorTokenizer );
-                                            if ( errorToken.type == Token_Type::Comma )
-                                            {
-                                                column = GetToken( &errorTokenizer );
-                                                // printf( "column %d ", StringToUInt( column ) );
-                                                errorToken = GetToken( &errorTokenizer );
-                                            }
-
-                                            errorToken = GetToken( &errorTokenizer ); // :
-                                        }
-
-                                        errorToken = GetToken( &errorTokenizer ); // fatal or error
-                                        if ( TokenEquals( errorToken, "fatal" ) )
-                                        {
-                                            errorToken = GetToken( &errorTokenizer );
-                                        }
-
-                                        Token type = errorToken;
-                                        Token errorNumber = GetToken( &errorTokenizer );
-                                        // printf( "error %.*s ", ( int ) errorNumber.textLength, errorNumber.text );
-                                        errorToken = GetToken( &errorTokenizer ); // :
-
-                                        errorToken = GetToken( &errorTokenizer ); // message start
-                                        if ( errorToken.type == Token_Type::Character )
-                                        {
-                                            --errorToken.text;
-                                        }
-                                        char *messageStart = errorToken.text;
-                                        temp = messageStart;
-                                        while ( temp && *temp != '\n' )
-                                        {
-                                            ++temp;
-                                        }
-                                        --temp;
-                                        String message;
-                                        message.content = messageStart;
-                                        message.length = ( u32 ) ( temp - messageStart );
-
-                                        EncodeMap( 6, &encoder );
-                                        EncodeString( "lnum", &encoder );
-                                        if ( line.text )
-                                        {
-                                            EncodeUInt( StringToUInt( line ), &encoder );
-                                        }
-                                        else
-                                        {
-                                            EncodeUInt( 1, &encoder );
-                                        }
-
-                                        EncodeString( "col", &encoder );
-                                        if ( column.text )
-                                        {
-                                            EncodeUInt( StringToUInt( column ), &encoder );
-                                        }
-                                        else
-                                        {
-                                            EncodeUInt( 1, &encoder );
-                                        }
-                                        EncodeString( "nr", &encoder );
-                                        EncodeString( String{ ( u32 ) errorNumber.textLength, errorNumber.text }, &encoder );
-                                        EncodeString( "type", &encoder );
-                                        if ( TokenEquals( type, "warning" ) )
-                                        {
-                                            EncodeString( "W", &encoder );
-                                        }
-                                        else
-                                        {
-                                            EncodeString( "E", &encoder );
-                                        }
-
-                                        EncodeString( "filename", &encoder );
-                                        if ( StringsAreEqual( filename, "LINK" ) || StringStartsWith( errorNumber.text, "LNK" ) )
-                                        {
-                                            EncodeString( "build.bat", &encoder );
-                                        }
-                                        else
-                                        {
-                                            EncodeString( filename, &encoder );
-                                            // printf( "file: %.*s ", ( int ) filename.length, filename.content );
-                                        }
-                                        EncodeString( "text", &encoder );
-                                        EncodeString( message, &encoder );
-                                        // printf( "message %.*s\n", ( int ) message.length, message.content );
-
-                                        tokenizer.at = temp;
-                                        errorCount += 1;
-                                    }
-                                }
-                                break;
-
-                                case Token_Type::EndOfStream:
-                                {
-                                    parsing = false;
-                                }
-                                break;
-                            }
-                        }
-
-                        *arrayCountSpot = MP_Type::ARRAY_16;
-                        arrayCountSpot += 1;
-                        *( ( u16 * ) arrayCountSpot ) = _byteswap_ushort( ( u16 ) errorCount );
-                        VirtualFree( compilationFile, 0, MEM_RELEASE );
-                        DeleteFile( "compilation.log" );
-                    }
-                    else
-                    {
-                        EncodeString( "messages", &encoder );
-                        EncodeArray( 1, &encoder );
-                        EncodeMap( 1, &encoder );
-                        EncodeString( "text", &encoder );
-                        EncodeString( "Failed to open compilation log", &encoder );
-                    }
-                }
-                else
-                {
-                    printf( "ShellExecute failed: %d\n", GetLastError() );
-                    EncodeString( "messages", &encoder );
-                    EncodeArray( 1, &encoder );
-                    EncodeString( "ShellExecute failed", &encoder );
-                }
-            }
-            else if ( StringsAreEqual( command, "GetDeclarations" ) )
+        // NOTE: requests from any connection can move the generation too, so this runs every time
+        if ( server->running && subscribers )
+        {
+            if ( WatcherHasChanges( server->watcher ) )
             {
-                bool sendUpdate = ParseFiles( parseState, &arena, currentDirectory );
-
-                // {
-                //     for ( u32 hashIndex = 0; hashIndex < ArrayCount( parseState->filesHash ); ++hashIndex )
-                //     {
-                //         File_State *file = parseState->filesHash[ hashIndex ];
-
-                //         while ( file )
-                //         {
-                // printf( "File: %s - %d functions, %d structs, %d macros\n", file->name, file->functionCount, file->structCount, file->macroCount );
-                //             Function_Declaration *function = file->functions;
-                //             for ( u32 functionIndex = 0; functionIndex < file->functionCount; ++functionIndex )
-                //             {
-                //                 printf( "%s %s(", function->returnType, function->name );
-                //                 for ( u32 argIndex = 0; argIndex < function->argumentCount; ++argIndex )
-                //                 {
-                //                     Field_Declaration *arg = function->arguments + argIndex;
-                //                     printf( "%s %s, ", arg->type, arg->name );
-                //                 }
-                //                 printf( ")\n" );
-                //                 function = function->nextInList;
-                //             }
-
-                //             Macro_Declaration *macro = file->macros;
-                //             for ( u32 macroIndex = 0; macroIndex < file->macroCount; ++macroIndex )
-                //             {
-                //                 printf( "#define %s\n", macro->name );
-                //                 macro = macro->nextInList;
-                //             }
-
-                // Struct_Declaration *structure = file->structs;
-                // for ( u32 structIndex = 0; structIndex < file->structCount; ++structIndex )
-                // {
-                //     printf( "Line %d\n", structure->line );
-                //     if ( structure->type == Struct_Type::Struct )
-                //     {
-                //         printf( "struct " );
-                //     }
-                //     else if ( structure->type == Struct_Type::Union )
-                //     {
-                //         printf( "union " );
-                //     }
-                //     else if ( structure->type == Struct_Type::Enum )
-                //     {
-                //         printf( "enum " );
-                //     }
-                //     printf( "%s\n{\n", structure->name );
-
-                //     for ( u32 fieldIndex = 0; fieldIndex < structure->fieldCount; ++fieldIndex )
-                //     {
-                //         Field_Declaration *field = structure->fields + fieldIndex;
-                //         printf( "  %s %s;\n", field->type, field->name );
-                //     }
-                //     printf( "};\n" );
-                //     structure = structure->nextInList;
-                // }
-
-                // file = file->nextInHash;
-                //         }
-                //     }
-                // }
-                if ( sendUpdate )
-                {
-                    EncodeArray( 2, &encoder );
-                    EncodeBool( sendUpdate, &encoder );
-
-                    EncodeMap( parseState->fileCount, &encoder );
-                    {
-                        for ( u32 hashIndex = 0; hashIndex < ArrayCount( parseState->filesHash ); ++hashIndex )
-                        {
-                            File_State *file = parseState->filesHash[ hashIndex ];
-
-                            while ( file )
-                            {
-                                EncodeString( file->name, &encoder );
-                                EncodeMap( 3, &encoder );
-                                {
-                                    EncodeString( "functions", &encoder );
-                                    EncodeArray( file->functionCount, &encoder );
-                                    {
-                                        Function_Declaration *function = file->functions;
-                                        for ( u32 functionIndex = 0; functionIndex < file->functionCount; ++functionIndex )
-                                        {
-                                            EncodeMap( 4, &encoder );
-
-                                            EncodeString( "line", &encoder );
-                                            EncodeUInt( function->line, &encoder );
-
-                                            EncodeString( "name", &encoder );
-                                            EncodeString( function->name, &encoder );
-
-                                            EncodeString( "return_type", &encoder );
-                                            EncodeString( function->returnType, &encoder );
-
-                                            EncodeString( "arguments", &encoder );
-                                            EncodeArray( function->argumentCount, &encoder );
-                                            for ( u32 argIndex = 0; argIndex < function->argumentCount; ++argIndex )
-                                            {
-                                                Field_Declaration *arg = function->arguments + argIndex;
-                                                EncodeMap( 2, &encoder );
-
-                                                EncodeString( "type", &encoder );
-                                                EncodeString( arg->type, &encoder );
-
-                                                EncodeString( "name", &encoder );
-                                                EncodeString( arg->name, &encoder );
-                                            }
-                                            function = function->nextInList;
-                                        }
-                                    }
-
-                                    EncodeString( "structs", &encoder );
-                                    EncodeArray( file->structCount, &encoder );
-                                    {
-                                        Struct_Declaration *structure = file->structs;
-                                        for ( u32 structIndex = 0; structIndex < file->structCount; ++structIndex )
-                                        {
-                                            char *type = "struct";
-                                            if ( structure->type == Struct_Type::Union )
-                                            {
-                                                type = "union";
-                                            }
-                                            else if ( structure->type == Struct_Type::Enum )
-                                            {
-                                                type = "enum";
-                                            }
-
-                                            EncodeMap( 4, &encoder );
-
-                                            EncodeString( "line", &encoder );
-                                            EncodeUInt( structure->line, &encoder );
-
-                                            EncodeString( "name", &encoder );
-                                            EncodeString( structure->name, &encoder );
-
-                                            EncodeString( "type", &encoder );
-                                            EncodeString( type, &encoder );
-
-                                            EncodeString( "fields", &encoder );
-                                            EncodeArray( structure->fieldCount, &encoder );
-                                            for ( u32 fieldIndex = 0; fieldIndex < structure->fieldCount; ++fieldIndex )
-                                            {
-                                                Field_Declaration *field = structure->fields + fieldIndex;
-                                                EncodeMap( 2, &encoder );
-
-                                                EncodeString( "type", &encoder );
-                                                if ( field->type )
-                                                {
-                                                    EncodeString( field->type, &encoder );
-                                                }
-                                                else
-                                                {
-                                                    EncodeNil( &encoder );
-                                                }
-
-                                                EncodeString( "name", &encoder );
-                                                EncodeString( field->name, &encoder );
-                                            }
-                                            structure = structure->nextInList;
-                                        }
-                                    }
-
-                                    EncodeString( "macros", &encoder );
-                                    EncodeArray( file->macroCount, &encoder );
-                                    {
-                                        Macro_Declaration *macro = file->macros;
-                                        for ( u32 macroIndex = 0; macroIndex < file->macroCount; ++macroIndex )
-                                        {
-                                            EncodeMap( 2, &encoder );
-
-                                            EncodeString( "line", &encoder );
-                                            EncodeUInt( macro->line, &encoder );
-
-                                            EncodeString( "name", &encoder );
-                                            EncodeString( macro->name, &encoder );
-
-                                            macro = macro->nextInList;
-                                        }
-                                    }
-                                }
-                                file = file->nextInHash;
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    EncodeMap( 1, &encoder );
-                    {
-                        EncodeString( "updated", &encoder );
-                        EncodeBool( sendUpdate, &encoder );
-                    }
-                }
+                RefreshParseState( server );
             }
+            PushDeclarationChanges( server );
+        }
+
+        if ( server->statsDumpSeconds &&
+             TicksToNanoseconds( ReadTimer() - server->lastStatsDump ) >= ( u64 ) server->statsDumpSeconds * 1000000000ull )
+        {
+            server->lastStatsDump = ReadTimer();
+            printf( "\nStats after %llu ms\n", GetUptimeMilliseconds() );
+            PrintStats();
+            PrintChunkPoolStats( GetChunkPoolStats() );
+            PrintInternStats( GetInternStats() );
+        }
 
-            //send response
-            int bytesSent = send( clientSocket, ( char * ) responseBuffer, encoder.length, 0 );
+        if ( GetIndexWriteTimeout( server ) == 0 )
+        {
+            WriteIndexIfChanged( server );
+        }
 
-            if ( bytesSent == SOCKET_ERROR )
+        // NOTE: requests, pushes and build output can all leave something queued
+        for ( u32 connectionIndex = 0; connectionIndex < server->connectionCount; )
+        {
+            Client_Connection *connection = server->connections[ connectionIndex ];
+            if ( UpdateWaitEvents( server, connection ) )
             {
-                printf( "Send failed: %d\n", WSAGetLastError() );
-                closesocket( clientSocket );
-                WSACleanup();
-                return 1;
+                ++connectionIndex;
             }
             else
             {
-                printf( "Response sent!\n" );
+                printf( "Couldn't change what the connection waits for: %d\n", PlatformGetLastError() );
+                CloseConnection( server, connection );
             }
         }
-    } while ( running );
-
-    result = shutdown( clientSocket, SD_SEND );
+    }
 
-    if ( result == SOCKET_ERROR )
+    for ( u32 connectionIndex = 0; connectionIndex < server->connectionCount; ++connectionIndex )
     {
-        printf( "Shutdown failed: %d\n", WSAGetLastError() );
-        closesocket( clientSocket );
-        WSACleanup();
-        return 1;
+        PlatformShutdownSocket( server->connections[ connectionIndex ]->socket );
+        PlatformCloseSocket( server->connections[ connectionIndex ]->socket );
     }
-
-    closesocket( clientSocket );
-    WSACleanup();
+    PlatformDestroySocketSet( &server->socketSet );
+    PlatformCloseSocket( server->listenSocket );
+    WriteIndexIfChanged( server );
+    PlatformShutdownSockets();
 
     return 0;
 }
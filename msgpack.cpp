@@ -0,0 +1,755 @@
+// NOTE: the msgpack side of the rpc protocol, decoding requests, finding where they end in a stream
+// and encoding responses. Only what Neovim's rpc channel actually sends and expects is supported.
+
+#define MAX_REQUEST_SIZE         Megabytes( 64 )
+#define RESPONSE_BLOCK_SIZE      Kilobytes( 64 )
+#define RESPONSE_MAX_FREE_BLOCKS 48
+
+enum MP_Type : u8
+{
+    INVALID,
+    // https://github.com/msgpack/msgpack/blob/master/spec.md#formats
+    POSITIVE_FIX_INT = 0x00,
+    FIX_MAP = 0x80,
+    FIX_ARRAY = 0x90,
+    FIX_STRING = 0xa0,
+    NIL = 0xc0,
+    BOOL_FALSE = 0xc2,
+    BOOL_TRUE = 0xc3,
+    BINARY_8 = 0xc4,
+    BINARY_16 = 0xc5,
+    BINARY_32 = 0xc6,
+    EXT_8 = 0xc7,
+    EXT_16 = 0xc8,
+    EXT_32 = 0xc9,
+    FLOAT_32 = 0xca,
+    FLOAT_64 = 0xcb,
+    UINT_8 = 0xcc,
+    UINT_16 = 0xcd,
+    UINT_32 = 0xce,
+    UINT_64 = 0xcf,
+    INT_8 = 0xd0,
+    INT_16 = 0xd1,
+    INT_32 = 0xd2,
+    INT_64 = 0xd3,
+    FIX_EXT_1 = 0xd4,
+    FIX_EXT_2 = 0xd5,
+    FIX_EXT_4 = 0xd6,
+    FIX_EXT_8 = 0xd7,
+    FIX_EXT_16 = 0xd8,
+    STRING_8 = 0xd9,
+    STRING_16 = 0xda,
+    STRING_32 = 0xdb,
+    ARRAY_16 = 0xdc,
+    ARRAY_32 = 0xdd,
+    MAP_16 = 0xde,
+    MAP_32 = 0xdf,
+    NEGATIVE_FIX_INT = 0xe0,
+};
+
+struct MP_Parser
+{
+    u8 *at;
+};
+
+internal MP_Type GetType( MP_Parser *parser )
+{
+    MP_Type result = MP_Type::INVALID;
+    u8 byte = *parser->at;
+    if ( byte >= 0x00 && byte <= 0x7f ) { result = MP_Type::POSITIVE_FIX_INT; }
+    else if ( byte >= 0x80 && byte <= 0x8f ) { result = MP_Type::FIX_MAP; }
+    else if ( byte >= 0x90 && byte <= 0x9f ) { result = MP_Type::FIX_ARRAY; }
+    else if ( byte >= 0xa0 && byte <= 0xbf ) { result = MP_Type::FIX_STRING; }
+    else if ( byte >= 0xe0 && byte <= 0xff ) { result = MP_Type::NEGATIVE_FIX_INT; }
+    else
+    {
+        result = ( MP_Type ) byte;
+    }
+
+    return result;
+}
+
+// NOTE: the Parse functions below assume the type was checked, these are the types each one reads
+inline bool IsArrayType( MP_Type type )
+{
+    return type == MP_Type::FIX_ARRAY || type == MP_Type::ARRAY_16 || type == MP_Type::ARRAY_32;
+}
+
+inline bool IsUIntType( MP_Type type )
+{
+    return type == MP_Type::POSITIVE_FIX_INT || type == MP_Type::UINT_8 || type == MP_Type::UINT_16 || type == MP_Type::UINT_32;
+}
+
+inline bool IsStringType( MP_Type type )
+{
+    return type == MP_Type::FIX_STRING || type == MP_Type::STRING_8 || type == MP_Type::STRING_16 || type == MP_Type::STRING_32;
+}
+
+internal u32 ParseArrayLength( MP_Parser *parser )
+{
+    u32 result = UINT32_MAX;
+    MP_Type type = GetType( parser );
+
+    switch ( type )
+    {
+        case MP_Type::FIX_ARRAY:
+        {
+            result = *parser->at & 0b00001111;
+            parser->at += 1;
+        }
+        break;
+
+        case MP_Type::ARRAY_16:
+        {
+            result = ByteSwap16( *( u16 * ) ( parser->at + 1 ) );
+            parser->at += 3;
+        }
+        break;
+
+        case MP_Type::ARRAY_32:
+        {
+            result = ByteSwap32( *( u32 * ) ( parser->at + 1 ) );
+            parser->at += 5;
+        }
+        break;
+
+            InvalidDefaultCase;
+    }
+
+    return result;
+}
+
+internal u32 ParseUInt( MP_Parser *parser )
+{
+    u32 result = UINT32_MAX;
+    MP_Type type = GetType( parser );
+    switch ( type )
+    {
+        case MP_Type::POSITIVE_FIX_INT:
+        {
+            result = *parser->at & 0b01111111;
+            parser->at += 1;
+        }
+        break;
+
+        case MP_Type::UINT_8:
+        {
+            result = *( parser->at + 1 );
+            parser->at += 2;
+        }
+        break;
+
+        case MP_Type::UINT_16:
+        {
+            result = ByteSwap16( *( u16 * ) ( parser->at + 1 ) );
+            parser->at += 3;
+        }
+        break;
+
+        case MP_Type::UINT_32:
+        {
+            result = ByteSwap32( *( u32 * ) ( parser->at + 1 ) );
+            parser->at += 5;
+        }
+        break;
+
+            InvalidDefaultCase;
+    }
+    return result;
+}
+
+inline bool ParseNil( MP_Parser *parser )
+{
+    bool result = GetType( parser ) == MP_Type::NIL;
+    if ( result )
+    {
+        parser->at += 1;
+    }
+    return result;
+}
+
+internal String ParseString( MP_Parser *parser )
+{
+    String result = {};
+    MP_Type type = GetType( parser );
+    switch ( type )
+    {
+        case MP_Type::FIX_STRING:
+        {
+            result.length = *parser->at & 0b00011111;
+            result.content = ( char * ) ( parser->at + 1 );
+            parser->at += result.length + 1;
+        }
+        break;
+
+        case MP_Type::STRING_8:
+        {
+            result.length = *( parser->at + 1 );
+            result.content = ( char * ) ( parser->at + 2 );
+            parser->at += result.length + 2;
+        }
+        break;
+
+        case MP_Type::STRING_16:
+        {
+            result.length = ByteSwap16( *( u16 * ) ( parser->at + 1 ) );
+            result.content = ( char * ) ( parser->at + 3 );
+            parser->at += result.length + 3;
+        }
+        break;
+
+        case MP_Type::STRING_32:
+        {
+            result.length = ByteSwap32( *( u32 * ) ( parser->at + 1 ) );
+            result.content = ( char * ) ( parser->at + 5 );
+            parser->at += result.length + 5;
+        }
+        break;
+
+            InvalidDefaultCase;
+    }
+
+    return result;
+}
+
+// NOTE: recv doesn't respect message boundaries, a read can end in the middle of a request or
+// contain several of them. The scanner walks object headers without decoding anything and only
+// keeps a count of the objects that are still missing, so it can stop wherever the data runs out
+// and pick up from the same offset once more bytes arrive.
+enum MP_Frame_Result
+{
+    MP_Frame_Incomplete,
+    MP_Frame_Complete,
+    MP_Frame_Invalid,
+};
+
+struct MP_Frame_Scanner
+{
+    u32 offset;
+    u64 pendingObjects;
+};
+
+inline void ResetFrameScanner( MP_Frame_Scanner *scanner )
+{
+    scanner->offset = 0;
+    scanner->pendingObjects = 1;
+}
+
+inline u32 ReadBigEndian( u8 *at, u32 size )
+{
+    u32 result = 0;
+    for ( u32 byteIndex = 0; byteIndex < size; ++byteIndex )
+    {
+        result = ( result << 8 ) | at[ byteIndex ];
+    }
+    return result;
+}
+
+// NOTE: message points at the start of the current request, on MP_Frame_Complete the request is
+// scanner->offset bytes long
+internal MP_Frame_Result ScanFrame( MP_Frame_Scanner *scanner, u8 *message, u32 available )
+{
+    while ( scanner->pendingObjects > 0 )
+    {
+        if ( scanner->offset >= available )
+        {
+            return MP_Frame_Incomplete;
+        }
+
+        u8 *at = message + scanner->offset;
+        u8 byte = *at;
+
+        u32 headerSize = 1;
+        u32 lengthSize = 0;
+        u32 payloadSize = 0;
+        u32 childrenPerElement = 0;
+
+        if ( byte <= 0x7f || byte >= 0xe0 ) {}
+        else if ( byte <= 0x8f ) { payloadSize = 0; childrenPerElement = 2; }
+        else if ( byte <= 0x9f ) { payloadSize = 0; childrenPerElement = 1; }
+        else if ( byte <= 0xbf ) { payloadSize = byte & 0b00011111; }
+        else
+        {
+            switch ( ( MP_Type ) byte )
+            {
+                case MP_Type::NIL:
+                case MP_Type::BOOL_FALSE:
+                case MP_Type::BOOL_TRUE: break;
+
+                case MP_Type::UINT_8:
+                case MP_Type::INT_8: payloadSize = 1; break;
+                case MP_Type::UINT_16:
+                case MP_Type::INT_16: payloadSize = 2; break;
+                case MP_Type::UINT_32:
+                case MP_Type::INT_32:
+                case MP_Type::FLOAT_32: payloadSize = 4; break;
+                case MP_Type::UINT_64:
+                case MP_Type::INT_64:
+                case MP_Type::FLOAT_64: payloadSize = 8; break;
+
+                case MP_Type::FIX_EXT_1: payloadSize = 2; break;
+                case MP_Type::FIX_EXT_2: payloadSize = 3; break;
+                case MP_Type::FIX_EXT_4: payloadSize = 5; break;
+                case MP_Type::FIX_EXT_8: payloadSize = 9; break;
+                case MP_Type::FIX_EXT_16: payloadSize = 17; break;
+
+                case MP_Type::STRING_8:
+                case MP_Type::BINARY_8: lengthSize = 1; break;
+                case MP_Type::STRING_16:
+                case MP_Type::BINARY_16: lengthSize = 2; break;
+                case MP_Type::STRING_32:
+                case MP_Type::BINARY_32: lengthSize = 4; break;
+
+                // NOTE: the ext type byte follows the length
+                case MP_Type::EXT_8: lengthSize = 1; payloadSize = 1; break;
+                case MP_Type::EXT_16: lengthSize = 2; payloadSize = 1; break;
+                case MP_Type::EXT_32: lengthSize = 4; payloadSize = 1; break;
+
+                case MP_Type::ARRAY_16: lengthSize = 2; childrenPerElement = 1; break;
+                case MP_Type::ARRAY_32: lengthSize = 4; childrenPerElement = 1; break;
+                case MP_Type::MAP_16: lengthSize = 2; childrenPerElement = 2; break;
+                case MP_Type::MAP_32: lengthSize = 4; childrenPerElement = 2; break;
+
+                default: return MP_Frame_Invalid;
+            }
+        }
+
+        headerSize += lengthSize;
+        if ( ( u64 ) scanner->offset + headerSize > available )
+        {
+            return MP_Frame_Incomplete;
+        }
+
+        u64 elementCount = 0;
+        if ( byte >= 0x80 && byte <= 0x9f )
+        {
+            elementCount = byte & 0b00001111;
+        }
+        else if ( lengthSize )
+        {
+            u32 length = ReadBigEndian( at + 1, lengthSize );
+            if ( childrenPerElement )
+            {
+                elementCount = length;
+            }
+            else
+            {
+                payloadSize += length;
+            }
+        }
+
+        u64 objectSize = ( u64 ) headerSize + payloadSize;
+        if ( scanner->offset + objectSize > MAX_REQUEST_SIZE )
+        {
+            return MP_Frame_Invalid;
+        }
+        if ( scanner->offset + objectSize > available )
+        {
+            return MP_Frame_Incomplete;
+        }
+
+        scanner->offset += ( u32 ) objectSize;
+        scanner->pendingObjects += elementCount * childrenPerElement;
+        scanner->pendingObjects -= 1;
+    }
+
+    return MP_Frame_Complete;
+}
+
+// NOTE: steps over one whole object of any type, only for requests that were already scanned
+inline void SkipValue( MP_Parser *parser )
+{
+    MP_Frame_Scanner scanner;
+    ResetFrameScanner( &scanner );
+    ScanFrame( &scanner, parser->at, MAX_REQUEST_SIZE );
+    parser->at += scanner.offset;
+}
+
+// NOTE: responses are written into a chain of fixed size blocks instead of one big buffer, so a
+// response can be any size and nothing is ever copied to make it contiguous. The blocks are sent
+// with one gathered write and then go back to the connection's free list for the next response.
+// Headers are always written into a single block, only string bodies are split across blocks.
+//
+// What gets sent is a list of segments: runs of bytes written into the blocks, and references to
+// bytes that are already encoded somewhere else, like a file's cached declarations.
+struct MP_Block
+{
+    MP_Block *next;
+    u32 size;
+};
+
+struct MP_Segment
+{
+    u8 *data;
+    u32 size;
+};
+
+struct MP_Block_Pool
+{
+    MP_Block *freeList;
+    u32 freeCount;
+
+    // NOTE: only one encoder uses a pool at a time, so it also lends out its segment list
+    u32 segmentCapacity;
+    MP_Segment *segments;
+};
+
+struct MP_Encoder
+{
+    u8 *at;
+    u8 *end;
+    u32 length;
+
+    MP_Block *first;
+    MP_Block *current;
+    MP_Block_Pool *pool;
+
+    u8 *runStart;
+    u32 segmentCount;
+};
+
+#define MP_INITIAL_SEGMENTS      256
+// NOTE: below this a reference costs more as its own send buffer than copying it does
+#define MP_REFERENCE_MIN_SIZE    512
+
+inline u8 *GetBlockData( MP_Block *block )
+{
+    return ( u8 * ) ( block + 1 );
+}
+
+inline void BeginEncoder( MP_Encoder *encoder, MP_Block_Pool *pool )
+{
+    *encoder = {};
+    encoder->pool = pool;
+}
+
+internal void AddSegment( MP_Encoder *encoder, u8 *data, u32 size )
+{
+    MP_Block_Pool *pool = encoder->pool;
+    if ( encoder->segmentCount == pool->segmentCapacity )
+    {
+        u32 newCapacity = pool->segmentCapacity ? pool->segmentCapacity * 2 : MP_INITIAL_SEGMENTS;
+        MP_Segment *newSegments = ( MP_Segment * ) PlatformAllocateMemory( newCapacity * sizeof( MP_Segment ) );
+        Assert( newSegments );
+        if ( pool->segments )
+        {
+            memcpy( newSegments, pool->segments, encoder->segmentCount * sizeof( MP_Segment ) );
+            PlatformFreeMemory( pool->segments );
+        }
+        pool->segments = newSegments;
+        pool->segmentCapacity = newCapacity;
+    }
+
+    MP_Segment *segment = pool->segments + encoder->segmentCount++;
+    segment->data = data;
+    segment->size = size;
+}
+
+// NOTE: turns whatever was written since the last segment ended into a segment of its own
+inline void CloseEncoderRun( MP_Encoder *encoder )
+{
+    if ( encoder->at > encoder->runStart )
+    {
+        AddSegment( encoder, encoder->runStart, ( u32 ) ( encoder->at - encoder->runStart ) );
+    }
+    encoder->runStart = encoder->at;
+}
+
+internal void AddEncoderBlock( MP_Encoder *encoder )
+{
+    CloseEncoderRun( encoder );
+
+    MP_Block_Pool *pool = encoder->pool;
+    MP_Block *block = pool->freeList;
+    if ( block )
+    {
+        pool->freeList = block->next;
+        pool->freeCount -= 1;
+    }
+    else
+    {
+        block = ( MP_Block * ) PlatformAllocateMemory( RESPONSE_BLOCK_SIZE );
+        Assert( block );
+        block->size = RESPONSE_BLOCK_SIZE - sizeof( MP_Block );
+    }
+    block->next = 0;
+
+    if ( encoder->current )
+    {
+        encoder->current->next = block;
+    }
+    else
+    {
+        encoder->first = block;
+    }
+    encoder->current = block;
+    encoder->at = GetBlockData( block );
+    encoder->end = encoder->at + block->size;
+    encoder->runStart = encoder->at;
+}
+
+// NOTE: makes sure the next size bytes land in the current block and returns where they start.
+// Used by every header write, and by anything that wants to patch a header after the fact.
+inline u8 *ReserveEncoderSpace( MP_Encoder *encoder, u32 size )
+{
+    if ( ( memory_index ) ( encoder->end - encoder->at ) < size )
+    {
+        AddEncoderBlock( encoder );
+    }
+    return encoder->at;
+}
+
+// NOTE: the stores go through memcpy, the encoder position has no alignment at all
+inline void StoreBigEndian16( u8 *at, u16 value )
+{
+    value = ByteSwap16( value );
+    memcpy( at, &value, sizeof( value ) );
+}
+
+inline void StoreBigEndian32( u8 *at, u32 value )
+{
+    value = ByteSwap32( value );
+    memcpy( at, &value, sizeof( value ) );
+}
+
+inline void StoreBigEndian64( u8 *at, u64 value )
+{
+    value = ByteSwap64( value );
+    memcpy( at, &value, sizeof( value ) );
+}
+
+inline void EncodeTypeByte( u8 type, MP_Encoder *encoder )
+{
+    u8 *at = ReserveEncoderSpace( encoder, 1 );
+    at[ 0 ] = type;
+    encoder->at += 1;
+    encoder->length += 1;
+}
+
+inline void EncodeType8( u8 type, u8 value, MP_Encoder *encoder )
+{
+    u8 *at = ReserveEncoderSpace( encoder, 2 );
+    at[ 0 ] = type;
+    at[ 1 ] = value;
+    encoder->at += 2;
+    encoder->length += 2;
+}
+
+inline void EncodeType16( u8 type, u16 value, MP_Encoder *encoder )
+{
+    u8 *at = ReserveEncoderSpace( encoder, 3 );
+    at[ 0 ] = type;
+    StoreBigEndian16( at + 1, value );
+    encoder->at += 3;
+    encoder->length += 3;
+}
+
+inline void EncodeType32( u8 type, u32 value, MP_Encoder *encoder )
+{
+    u8 *at = ReserveEncoderSpace( encoder, 5 );
+    at[ 0 ] = type;
+    StoreBigEndian32( at + 1, value );
+    encoder->at += 5;
+    encoder->length += 5;
+}
+
+internal void EncodeBytes( void *data, u32 size, MP_Encoder *encoder )
+{
+    u8 *source = ( u8 * ) data;
+    encoder->length += size;
+    while ( size > 0 )
+    {
+        if ( encoder->at == encoder->end )
+        {
+            AddEncoderBlock( encoder );
+        }
+
+        u32 available = ( u32 ) ( encoder->end - encoder->at );
+        u32 copySize = size < available ? size : available;
+        memcpy( encoder->at, source, copySize );
+        encoder->at += copySize;
+        source += copySize;
+        size -= copySize;
+    }
+}
+
+// NOTE: sends bytes that were encoded earlier as they are, they have to stay put until the encoder
+// is sent. Small ones are simply copied.
+internal void EncodeReference( u8 *data, u32 size, MP_Encoder *encoder )
+{
+    if ( size < MP_REFERENCE_MIN_SIZE )
+    {
+        EncodeBytes( data, size, encoder );
+    }
+    else
+    {
+        CloseEncoderRun( encoder );
+        AddSegment( encoder, data, size );
+        encoder->length += size;
+    }
+}
+
+// NOTE: destination has to hold encoder->length bytes
+internal void CopyEncoderOutput( MP_Encoder *encoder, u8 *destination )
+{
+    CloseEncoderRun( encoder );
+    for ( u32 segmentIndex = 0; segmentIndex < encoder->segmentCount; ++segmentIndex )
+    {
+        MP_Segment *segment = encoder->pool->segments + segmentIndex;
+        memcpy( destination, segment->data, segment->size );
+        destination += segment->size;
+    }
+}
+
+// NOTE: hands every block back to the pool, the free list keeps about what the old fixed response
+// buffer used to cost per connection and the rest goes back to the OS
+internal void EndEncoder( MP_Encoder *encoder )
+{
+    MP_Block_Pool *pool = encoder->pool;
+    MP_Block *block = encoder->first;
+    while ( block )
+    {
+        MP_Block *next = block->next;
+        if ( pool->freeCount < RESPONSE_MAX_FREE_BLOCKS )
+        {
+            block->next = pool->freeList;
+            pool->freeList = block;
+            pool->freeCount += 1;
+        }
+        else
+        {
+            PlatformFreeMemory( block );
+        }
+        block = next;
+    }
+
+    *encoder = {};
+    encoder->pool = pool;
+}
+
+internal void ReleaseBlockPool( MP_Block_Pool *pool )
+{
+    MP_Block *block = pool->freeList;
+    while ( block )
+    {
+        MP_Block *next = block->next;
+        PlatformFreeMemory( block );
+        block = next;
+    }
+    pool->freeList = 0;
+    pool->freeCount = 0;
+
+    if ( pool->segments )
+    {
+        PlatformFreeMemory( pool->segments );
+    }
+    pool->segments = 0;
+    pool->segmentCapacity = 0;
+}
+
+internal void EncodeUInt( u32 value, MP_Encoder *encoder )
+{
+    if ( value < 128 )
+    {
+        EncodeTypeByte( ( u8 ) value, encoder );
+    }
+    else if ( value <= 0xFF )
+    {
+        EncodeType8( MP_Type::UINT_8, ( u8 ) value, encoder );
+    }
+    else if ( value <= 0xFFFF )
+    {
+        EncodeType16( MP_Type::UINT_16, ( u16 ) value, encoder );
+    }
+    else
+    {
+        EncodeType32( MP_Type::UINT_32, value, encoder );
+    }
+}
+
+internal void EncodeUInt64( u64 value, MP_Encoder *encoder )
+{
+    if ( value <= 0xFFFFFFFF )
+    {
+        EncodeUInt( ( u32 ) value, encoder );
+    }
+    else
+    {
+        u8 *at = ReserveEncoderSpace( encoder, 9 );
+        at[ 0 ] = MP_Type::UINT_64;
+        StoreBigEndian64( at + 1, value );
+        encoder->at += 9;
+        encoder->length += 9;
+    }
+}
+
+internal void EncodeNil( MP_Encoder *encoder )
+{
+    EncodeTypeByte( MP_Type::NIL, encoder );
+}
+
+internal void EncodeMap( u32 length, MP_Encoder *encoder )
+{
+    if ( length < 16 )
+    {
+        EncodeTypeByte( MP_Type::FIX_MAP | ( u8 ) length, encoder );
+    }
+    else if ( length <= 0xFFFF )
+    {
+        EncodeType16( MP_Type::MAP_16, ( u16 ) length, encoder );
+    }
+    else
+    {
+        EncodeType32( MP_Type::MAP_32, length, encoder );
+    }
+}
+
+internal void EncodeArray( u32 length, MP_Encoder *encoder )
+{
+    if ( length < 16 )
+    {
+        EncodeTypeByte( MP_Type::FIX_ARRAY | ( u8 ) length, encoder );
+    }
+    else if ( length <= 0xFFFF )
+    {
+        EncodeType16( MP_Type::ARRAY_16, ( u16 ) length, encoder );
+    }
+    else
+    {
+        EncodeType32( MP_Type::ARRAY_32, length, encoder );
+    }
+}
+
+internal void EncodeString( String string, MP_Encoder *encoder )
+{
+    u32 length = string.length;
+
+    if ( length < 32 )
+    {
+        EncodeTypeByte( MP_Type::FIX_STRING | ( u8 ) length, encoder );
+    }
+    else if ( length <= 0xFF )
+    {
+        EncodeType8( MP_Type::STRING_8, ( u8 ) length, encoder );
+    }
+    else if ( length <= 0xFFFF )
+    {
+        EncodeType16( MP_Type::STRING_16, ( u16 ) length, encoder );
+    }
+    else
+    {
+        EncodeType32( MP_Type::STRING_32, length, encoder );
+    }
+
+    EncodeBytes( string.content, length, encoder );
+}
+
+internal void EncodeString( char *string, MP_Encoder *encoder )
+{
+    EncodeString( String{ ( u32 ) strlen( string ), string }, encoder );
+}
+
+inline void EncodeBool( bool value, MP_Encoder *encoder )
+{
+    EncodeTypeByte( value ? MP_Type::BOOL_TRUE : MP_Type::BOOL_FALSE, encoder );
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "intrinsics.h"
+#if defined( _WIN32 )
+    #include "win32_platform.cpp"
+#else
+    #include "posix_platform.cpp"
+#endif
+
+#include "msgpack.cpp"
+
+// NOTE: the request framing has to cope with whatever recv hands it: a request split at any byte,
+// including inside an object header, several requests in one read, and lengths that claim more
+// than a request may ever be. Each case builds its bytes by hand so every header form is covered.
+global_variable u32 GlobalCheckCount;
+global_variable u32 GlobalFailedCount;
+
+#define Check( expression ) CheckResult( expression, #expression, __LINE__ )
+
+internal void CheckResult( bool passed, char *expression, u32 line )
+{
+    GlobalCheckCount += 1;
+    if ( !passed )
+    {
+        GlobalFailedCount += 1;
+        printf( "msgpack_tests.cpp(%u): failed %s\n", line, expression );
+    }
+}
+
+struct Test_Bytes
+{
+    u32 size;
+    u8 data[ 1024 ];
+};
+
+inline void PutByte( Test_Bytes *bytes, u32 value )
+{
+    bytes->data[ bytes->size++ ] = ( u8 ) value;
+}
+
+inline void PutBigEndian( Test_Bytes *bytes, u32 value, u32 size )
+{
+    for ( u32 byteIndex = 0; byteIndex < size; ++byteIndex )
+    {
+        PutByte( bytes, value >> ( 8 * ( size - byteIndex - 1 ) ) );
+    }
+}
+
+inline void PutFill( Test_Bytes *bytes, u32 value, u32 count )
+{
+    for ( u32 byteIndex = 0; byteIndex < count; ++byteIndex )
+    {
+        PutByte( bytes, value );
+    }
+}
+
+inline void PutFixString( Test_Bytes *bytes, char *string )
+{
+    u32 length = ( u32 ) strlen( string );
+    PutByte( bytes, 0xa0 | length );
+    memcpy( bytes->data + bytes->size, string, length );
+    bytes->size += length;
+}
+
+// NOTE: [ 0, 1, "GetStats", [] ]
+internal void PutSmallRequest( Test_Bytes *bytes )
+{
+    PutByte( bytes, 0x94 );
+    PutByte( bytes, 0x00 );
+    PutByte( bytes, 0x01 );
+    PutFixString( bytes, "GetStats" );
+    PutByte( bytes, 0x90 );
+}
+
+// NOTE: [ 0, 300, "GetFileDeclarations", [ str16, { "a" = float64, "b" = ext8 } as map32, bin32 ] ],
+// every multi-byte header the scanner reads a length from
+internal void PutLargeRequest( Test_Bytes *bytes )
+{
+    PutByte( bytes, 0x94 );
+    PutByte( bytes, 0x00 );
+    PutByte( bytes, MP_Type::UINT_16 );
+    PutBigEndian( bytes, 300, 2 );
+    PutByte( bytes, MP_Type::STRING_8 );
+    PutByte( bytes, 19 );
+    memcpy( bytes->data + bytes->size, "GetFileDeclarations", 19 );
+    bytes->size += 19;
+
+    PutByte( bytes, MP_Type::ARRAY_16 );
+    PutBigEndian( bytes, 3, 2 );
+
+    PutByte( bytes, MP_Type::STRING_16 );
+    PutBigEndian( bytes, 300, 2 );
+    PutFill( bytes, 'x', 300 );
+
+    PutByte( bytes, MP_Type::MAP_32 );
+    PutBigEndian( bytes, 2, 4 );
+    PutFixString( bytes, "a" );
+    PutByte( bytes, MP_Type::FLOAT_64 );
+    PutFill( bytes, 0, 8 );
+    PutFixString( bytes, "b" );
+    PutByte( bytes, MP_Type::EXT_8 );
+    PutByte( bytes, 2 );
+    PutByte( bytes, 5 );
+    PutFill( bytes, 0, 2 );
+
+    PutByte( bytes, MP_Type::BINARY_32 );
+    PutBigEndian( bytes, 3, 4 );
+    PutFill( bytes, 0xff, 3 );
+}
+
+// NOTE: the same scanner sees the request grow a few bytes at a time, like reads that each end
+// somewhere inside it, and has to pick up where it stopped every time
+internal void CheckSplitRequest( Test_Bytes *bytes, u32 step )
+{
+    MP_Frame_Scanner scanner;
+    ResetFrameScanner( &scanner );
+    bool incompleteUntilEnd = true;
+    for ( u32 available = 0; available < bytes->size; available += step )
+    {
+        incompleteUntilEnd = incompleteUntilEnd && ScanFrame( &scanner, bytes->data, available ) == MP_Frame_Incomplete;
+    }
+    Check( incompleteUntilEnd );
+    Check( ScanFrame( &scanner, bytes->data, bytes->size ) == MP_Frame_Complete );
+    Check( scanner.offset == bytes->size );
+}
+
+internal void TestSplitRequests()
+{
+    Test_Bytes small = {};
+    PutSmallRequest( &small );
+    Test_Bytes large = {};
+    PutLargeRequest( &large );
+
+    for ( u32 step = 1; step <= 7; ++step )
+    {
+        CheckSplitRequest( &small, step );
+        CheckSplitRequest( &large, step );
+    }
+}
+
+// NOTE: three requests and the start of a fourth in one read, each one is framed on its own and the
+// cut off one waits for more
+internal void TestCoalescedRequests()
+{
+    Test_Bytes bytes = {};
+    PutSmallRequest( &bytes );
+    u32 firstEnd = bytes.size;
+    PutLargeRequest( &bytes );
+    u32 secondEnd = bytes.size;
+    PutSmallRequest( &bytes );
+    u32 thirdEnd = bytes.size;
+    PutLargeRequest( &bytes );
+    u32 cutOff = thirdEnd + 40;
+
+    u32 ends[] = { firstEnd, secondEnd, thirdEnd };
+    u32 start = 0;
+    for ( u32 requestIndex = 0; requestIndex < ArrayCount( ends ); ++requestIndex )
+    {
+        MP_Frame_Scanner scanner;
+        ResetFrameScanner( &scanner );
+        Check( ScanFrame( &scanner, bytes.data + start, cutOff - start ) == MP_Frame_Complete );
+        Check( start + scanner.offset == ends[ requestIndex ] );
+        start += scanner.offset;
+    }
+
+    MP_Frame_Scanner scanner;
+    ResetFrameScanner( &scanner );
+    Check( ScanFrame( &scanner, bytes.data + start, cutOff - start ) == MP_Frame_Incomplete );
+    Check( ScanFrame( &scanner, bytes.data + start, bytes.size - start ) == MP_Frame_Complete );
+    Check( start + scanner.offset == bytes.size );
+}
+
+// NOTE: a length that would take the request past MAX_REQUEST_SIZE is rejected as soon as its header
+// is in, without waiting for bytes that are never going to be buffered
+internal void TestOversizedRequests()
+{
+    Test_Bytes string = {};
+    PutByte( &string, 0x94 );
+    PutByte( &string, 0x00 );
+    PutByte( &string, 0x01 );
+    PutByte( &string, MP_Type::STRING_32 );
+    PutBigEndian( &string, MAX_REQUEST_SIZE, 4 );
+
+    MP_Frame_Scanner scanner;
+    ResetFrameScanner( &scanner );
+    Check( ScanFrame( &scanner, string.data, string.size - 2 ) == MP_Frame_Incomplete );
+    Check( ScanFrame( &scanner, string.data, string.size ) == MP_Frame_Invalid );
+
+    Test_Bytes binary = {};
+    PutByte( &binary, 0x91 );
+    PutByte( &binary, MP_Type::BINARY_32 );
+    PutBigEndian( &binary, MAX_REQUEST_SIZE - 5, 4 );
+    ResetFrameScanner( &scanner );
+    Check( ScanFrame( &scanner, binary.data, binary.size ) == MP_Frame_Invalid );
+
+    // NOTE: one byte less fits exactly and only has to wait for the rest
+    binary.size = 0;
+    PutByte( &binary, 0x91 );
+    PutByte( &binary, MP_Type::BINARY_32 );
+    PutBigEndian( &binary, MAX_REQUEST_SIZE - 6, 4 );
+    ResetFrameScanner( &scanner );
+    Check( ScanFrame( &scanner, binary.data, binary.size ) == MP_Frame_Incomplete );
+}
+
+internal void TestInvalidType()
+{
+    Test_Bytes bytes = {};
+    PutByte( &bytes, 0x92 );
+    PutByte( &bytes, 0x00 );
+    PutByte( &bytes, 0xc1 );
+
+    MP_Frame_Scanner scanner;
+    ResetFrameScanner( &scanner );
+    Check( ScanFrame( &scanner, bytes.data, bytes.size ) == MP_Frame_Invalid );
+}
+
+// NOTE: SkipValue steps over whole nested objects, handlers rely on it to find the next argument
+internal void TestSkipValue()
+{
+    Test_Bytes bytes = {};
+    PutLargeRequest( &bytes );
+
+    MP_Parser parser = {};
+    parser.at = bytes.data;
+    Check( ParseArrayLength( &parser ) == 4 );
+    SkipValue( &parser );
+    Check( ParseUInt( &parser ) == 300 );
+    String command = ParseString( &parser );
+    Check( command.length == 19 && memcmp( command.content, "GetFileDeclarations", 19 ) == 0 );
+    Check( ParseArrayLength( &parser ) == 3 );
+    SkipValue( &parser );
+    Check( GetType( &parser ) == MP_Type::MAP_32 );
+    SkipValue( &parser );
+    Check( GetType( &parser ) == MP_Type::BINARY_32 );
+    SkipValue( &parser );
+    Check( parser.at == bytes.data + bytes.size );
+}
+
+int main( int argc, char **argv )
+{
+    TestSplitRequests();
+    TestCoalescedRequests();
+    TestOversizedRequests();
+    TestInvalidType();
+    TestSkipValue();
+
+    printf( "%u of %u msgpack checks passed\n", GlobalCheckCount - GlobalFailedCount, GlobalCheckCount );
+    return GlobalFailedCount ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+// NOTE: exact name lookup over every declaration, GoToDefinition and GetSignature go through here.
+// Names are interned, so the table is keyed by the interned pointer and a lookup for text coming
+// from the client first asks the intern pool whether the name exists at all.
+//
+// Unlike the search index this one is kept up to date incrementally: a file whose generation moved
+// past the one the index was synced at has its sites unlinked and, unless it was removed, linked
+// back in from its new declarations. The sites live in the index's own blocks, the file arenas can
+// be reset by the workers while the old sites still point at them.
+
+#define NAME_INDEX_INITIAL_SLOTS 4096
+#define NAME_SITE_BLOCK_COUNT    4096
+
+struct Declaration_Site
+{
+    char *name;
+    Symbol_Kind kind;
+    File_State *file;
+    u32 line;
+    u32 declarationIndex;
+
+    Declaration_Site *nextForName;
+    Declaration_Site *prevForName;
+    Declaration_Site *nextInFile;
+};
+
+struct Name_Slot
+{
+    char *name;
+    Declaration_Site *firstSite;
+};
+
+struct Name_Index
+{
+    u32 generation;
+    bool built;
+
+    u32 nameCount;
+    u32 slotCount;
+    Name_Slot *slots;
+
+    // NOTE: indexed like Parse_State::files.states, the sites each file added
+    u32 fileCapacity;
+    Declaration_Site **fileSites;
+
+    Declaration_Site *freeSites;
+    u32 siteCount;
+};
+
+inline u32 HashPointer( void *pointer )
+{
+    u64 result = ( u64 ) pointer * 0x9E3779B97F4A7C15ull;
+    return ( u32 ) ( result >> 32 );
+}
+
+internal Name_Slot *FindNameSlot( Name_Index *index, char *name )
+{
+    Name_Slot *result = 0;
+    if ( index->slotCount && name )
+    {
+        u32 slotIndex = HashPointer( name ) & ( index->slotCount - 1 );
+        for ( Name_Slot *slot = index->slots + slotIndex; slot->name; slot = index->slots + slotIndex )
+        {
+            if ( slot->name == name )
+            {
+                result = slot;
+                break;
+            }
+            slotIndex = ( slotIndex + 1 ) & ( index->slotCount - 1 );
+        }
+    }
+    return result;
+}
+
+internal void GrowNameIndex( Name_Index *index )
+{
+    u32 newSlotCount = index->slotCount ? index->slotCount * 2 : NAME_INDEX_INITIAL_SLOTS;
+    Name_Slot *newSlots = ( Name_Slot * ) PlatformAllocateMemory( newSlotCount * sizeof( Name_Slot ) );
+    for ( u32 slotIndex = 0; slotIndex < index->slotCount; ++slotIndex )
+    {
+        Name_Slot *slot = index->slots + slotIndex;
+        if ( slot->name )
+        {
+            u32 newIndex = HashPointer( slot->name ) & ( newSlotCount - 1 );
+            while ( newSlots[ newIndex ].name )
+            {
+                newIndex = ( newIndex + 1 ) & ( newSlotCount - 1 );
+            }
+            newSlots[ newIndex ] = *slot;
+        }
+    }
+
+    if ( index->slots )
+    {
+        PlatformFreeMemory( index->slots );
+    }
+    index->slots = newSlots;
+    index->slotCount = newSlotCount;
+}
+
+// NOTE: slots are never deleted, a name whose last site went away keeps an empty slot since the
+// interned string is never freed either
+internal Name_Slot *GetNameSlot( Name_Index *index, char *name )
+{
+    if ( ( index->nameCount + 1 ) * 4 > index->slotCount * 3 )
+    {
+        GrowNameIndex( index );
+    }
+
+    u32 slotIndex = HashPointer( name ) & ( index->slotCount - 1 );
+    Name_Slot *slot = index->slots + slotIndex;
+    while ( slot->name && slot->name != name )
+    {
+        slotIndex = ( slotIndex + 1 ) & ( index->slotCount - 1 );
+        slot = index->slots + slotIndex;
+    }
+
+    if ( !slot->name )
+    {
+        slot->name = name;
+        slot->firstSite = 0;
+        index->nameCount += 1;
+    }
+    return slot;
+}
+
+internal Declaration_Site *AllocateSite( Name_Index *index )
+{
+    if ( !index->freeSites )
+    {
+        Declaration_Site *block = ( Declaration_Site * ) PlatformAllocateMemory( NAME_SITE_BLOCK_COUNT * sizeof( Declaration_Site ) );
+        for ( u32 siteIndex = 0; siteIndex < NAME_SITE_BLOCK_COUNT; ++siteIndex )
+        {
+            block[ siteIndex ].nextInFile = index->freeSites;
+            index->freeSites = block + siteIndex;
+        }
+    }
+
+    Declaration_Site *result = index->freeSites;
+    index->freeSites = result->nextInFile;
+    index->siteCount += 1;
+    return result;
+}
+
+internal void AddSite( Name_Index *index, File_State *file, u32 fileIndex, char *name, Symbol_Kind kind, u32 line, u32 declarationIndex )
+{
+    Declaration_Site *site = AllocateSite( index );
+    site->name = name;
+    site->kind = kind;
+    site->file = file;
+    site->line = line;
+    site->declarationIndex = declarationIndex;
+
+    Name_Slot *slot = GetNameSlot( index, name );
+    site->prevForName = 0;
+    site->nextForName = slot->firstSite;
+    if ( slot->firstSite )
+    {
+        slot->firstSite->prevForName = site;
+    }
+    slot->firstSite = site;
+
+    site->nextInFile = index->fileSites[ fileIndex ];
+    index->fileSites[ fileIndex ] = site;
+}
+
+internal void RemoveFileSites( Name_Index *index, u32 fileIndex )
+{
+    Declaration_Site *site = index->fileSites[ fileIndex ];
+    while ( site )
+    {
+        Declaration_Site *next = site->nextInFile;
+        if ( site->prevForName )
+        {
+            site->prevForName->nextForName = site->nextForName;
+        }
+        else
+        {
+            FindNameSlot( index, site->name )->firstSite = site->nextForName;
+        }
+        if ( site->nextForName )
+        {
+            site->nextForName->prevForName = site->prevForName;
+        }
+
+        site->nextInFile = index->freeSites;
+        index->freeSites = site;
+        index->siteCount -= 1;
+        site = next;
+    }
+    index->fileSites[ fileIndex ] = 0;
+}
+
+internal void AddFileSites( Name_Index *index, File_State *file, u32 fileIndex )
+{
+    Declaration_Table *table = &file->declarations;
+    for ( u32 declarationIndex = 0; declarationIndex < table->count; ++declarationIndex )
+    {
+        AddSite( index, file, fileIndex, table->names[ declarationIndex ], GetSymbolKind( table->kinds[ declarationIndex ] ),
+                 table->lines[ declarationIndex ], declarationIndex );
+    }
+}
+
+// NOTE: call before every lookup, it only touches the files that changed since the last call
+internal void UpdateNameIndex( Name_Index *index, Parse_State *state )
+{
+    if ( index->built && index->generation == state->generation )
+    {
+        return;
+    }
+
+    File_Table *files = &state->files;
+    if ( files->count > index->fileCapacity )
+    {
+        u32 newCapacity = files->capacity;
+        Declaration_Site **newFileSites = ( Declaration_Site ** ) PlatformAllocateMemory( newCapacity * sizeof( Declaration_Site * ) );
+        if ( index->fileSites )
+        {
+            memcpy( newFileSites, index->fileSites, index->fileCapacity * sizeof( Declaration_Site * ) );
+            PlatformFreeMemory( index->fileSites );
+        }
+        index->fileSites = newFileSites;
+        index->fileCapacity = newCapacity;
+    }
+
+    for ( u32 fileIndex = 0; fileIndex < files->count; ++fileIndex )
+    {
+        File_State *file = files->states[ fileIndex ];
+        if ( !index->built || file->generation > index->generation )
+        {
+            RemoveFileSites( index, fileIndex );
+            if ( !file->removed )
+            {
+                AddFileSites( index, file, fileIndex );
+            }
+        }
+    }
+
+    index->generation = state->generation;
+    index->built = true;
+}
+
+// NOTE: sites of the name in no particular order, 0 when nothing by that name was ever declared
+internal Declaration_Site *FindDeclarationSites( Name_Index *index, String name )
+{
+    Declaration_Site *result = 0;
+    Name_Slot *slot = FindNameSlot( index, FindInternedString( name.content, name.length ) );
+    if ( slot )
+    {
+        result = slot->firstSite;
+    }
+    return result;
+}
+
+inline u32 AppendString( char *buffer, u32 size, u32 length, char *text )
+{
+    while ( text && *text && length + 1 < size )
+    {
+        buffer[ length++ ] = *text++;
+    }
+    buffer[ length ] = '\0';
+    return length;
+}
+
+// NOTE: same text the declarations picker builds for a function entry, cut off at the buffer size
+internal u32 FormatFunctionSignature( Declaration_Table *table, u32 index, char *buffer, u32 size )
+{
+    u32 length = 0;
+    length = AppendString( buffer, size, length, table->types[ index ] );
+    length = AppendString( buffer, size, length, " " );
+    length = AppendString( buffer, size, length, table->names[ index ] );
+    length = AppendString( buffer, size, length, "( " );
+
+    u32 firstField = table->firstFields[ index ];
+    u32 onePastLastField = firstField + table->fieldCounts[ index ];
+    for ( u32 fieldIndex = firstField; fieldIndex < onePastLastField; ++fieldIndex )
+    {
+        length = AppendString( buffer, size, length, table->fieldTypes[ fieldIndex ] );
+        length = AppendString( buffer, size, length, " " );
+        length = AppendString( buffer, size, length, table->fieldNames[ fieldIndex ] );
+        if ( fieldIndex + 1 < onePastLastField )
+        {
+            length = AppendString( buffer, size, length, ", " );
+        }
+    }
+    length = AppendString( buffer, size, length, " )" );
+    return length;
+}
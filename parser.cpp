@@ -1,33 +1,9 @@
 #include <math.h>
 
-internal char *ReadEntireFileIntoMemoryAndNullTerminate( char *filename )
-{
-    void *result = 0;
-    HANDLE fileHandle = CreateFile( filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0 );
-    if ( fileHandle != INVALID_HANDLE_VALUE )
-    {
-        LARGE_INTEGER fileSize;
-        if ( GetFileSizeEx( fileHandle, &fileSize ) )
-        {
-            u32 fileSize32 = SafeTruncateU64( fileSize.QuadPart );
-            result = VirtualAlloc( 0, fileSize32 + 1, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
-            if ( result )
-            {
-                DWORD bytesRead;
-                if ( ReadFile( fileHandle, result, fileSize32, &bytesRead, 0 ) && bytesRead == fileSize32 )
-                {
-                    ( ( char * ) result )[ fileSize32 ] = '\0';
-                }
-                else
-                {
-                    VirtualFree( result, 0, MEM_RELEASE );
-                }
-            }
-        }
-        CloseHandle( fileHandle );
-    }
-    return ( char * ) result;
-}
+global_variable bool GlobalLogParsing = true;
+// NOTE: when set the first pass only records each function's and struct's name, kind, line and where
+// its arguments or fields start, ParseFileDetails fills those in once something asks for them
+global_variable bool GlobalLazyDetails = false;
 
 enum class Token_Type
 {
@@ -61,12 +37,22 @@ struct Token
     u64 textLength;
 };
 
+// NOTE: the source doesn't have to be null terminated, nothing at or after end is ever looked at
 struct Tokenizer
 {
     char *at;
+    char *end;
     u32 lineCount;
+    // NOTE: every GetToken call, a parse that looks at a byte more than once shows up here
+    u64 tokenCount;
 };
 
+inline char PeekChar( Tokenizer *tokenizer, u32 offset )
+{
+    char result = tokenizer->at + offset < tokenizer->end ? tokenizer->at[ offset ] : '\0';
+    return result;
+}
+
 inline bool StringStartsWith( char *string, char *prefix )
 {
     while ( *prefix )
@@ -136,30 +122,26 @@ internal void EatAllWhitespace( Tokenizer *tokenizer )
 {
     for ( ;; )
     {
-        if ( tokenizer->at[ 0 ] == '\n' )
-        {
-            tokenizer->lineCount += 1;
-        }
-        if ( IsWhitespace( tokenizer->at[ 0 ] ) )
+        char c = PeekChar( tokenizer, 0 );
+        if ( IsWhitespace( c ) )
         {
-            ++tokenizer->at;
+            tokenizer->at = SkipWhitespace( tokenizer->at, tokenizer->end, &tokenizer->lineCount );
         }
-        else if ( tokenizer->at[ 0 ] == '/' && tokenizer->at[ 1 ] == '/' )
+        else if ( c == '/' && PeekChar( tokenizer, 1 ) == '/' )
         {
-            tokenizer->at += 2;
-            while ( tokenizer->at[ 0 ] && tokenizer->at[ 0 ] != '\n' )
-            {
-                ++tokenizer->at;
-            }
+            tokenizer->at = GlobalScan.findLineEnd( tokenizer->at + 2, tokenizer->end );
         }
-        else if ( tokenizer->at[ 0 ] == '/' && tokenizer->at[ 1 ] == '*' )
+        else if ( c == '/' && PeekChar( tokenizer, 1 ) == '*' )
         {
             tokenizer->at += 2;
-            while ( tokenizer->at[ 0 ] )
+            for ( ;; )
             {
-                if ( tokenizer->at[ 0 ] == '\n' ) { tokenizer->lineCount += 1; }
-
-                if ( tokenizer->at[ 0 ] == '*' && tokenizer->at[ 1 ] == '/' )
+                tokenizer->at = GlobalScan.findCommentStar( tokenizer->at, tokenizer->end, &tokenizer->lineCount );
+                if ( !PeekChar( tokenizer, 0 ) )
+                {
+                    break;
+                }
+                if ( PeekChar( tokenizer, 1 ) == '/' )
                 {
                     tokenizer->at += 2;
                     break;
@@ -177,10 +159,18 @@ internal void EatAllWhitespace( Tokenizer *tokenizer )
 internal Token GetToken( Tokenizer *tokenizer )
 {
     EatAllWhitespace( tokenizer );
+    ++tokenizer->tokenCount;
 
     Token result = {};
     result.textLength = 1;
     result.text = tokenizer->at;
+    if ( tokenizer->at >= tokenizer->end )
+    {
+        result.type = Token_Type::EndOfStream;
+        result.textLength = 0;
+        return result;
+    }
+
     char c = tokenizer->at[ 0 ];
     ++tokenizer->at;
     switch ( c )
@@ -202,7 +192,7 @@ internal Token GetToken( Tokenizer *tokenizer )
         case '#':
         {
             result.type = Token_Type::Preprocessor;
-            while ( tokenizer->at[ 0 ] && IsAlpha( tokenizer->at[ 0 ] ) )
+            while ( IsAlpha( PeekChar( tokenizer, 0 ) ) )
             {
                 ++tokenizer->at;
             }
@@ -215,14 +205,17 @@ internal Token GetToken( Tokenizer *tokenizer )
             result.type = Token_Type::Character;
             result.text = tokenizer->at;
 
-            if ( tokenizer->at[ 0 ] == '\\' && tokenizer->at[ 1 ] )
+            if ( PeekChar( tokenizer, 0 ) == '\\' && PeekChar( tokenizer, 1 ) )
+            {
+                ++tokenizer->at;
+            }
+            if ( tokenizer->at < tokenizer->end )
             {
                 ++tokenizer->at;
             }
-            ++tokenizer->at;
             result.textLength = tokenizer->at - result.text;
 
-            if ( tokenizer->at[ 0 ] == '\'' )
+            if ( PeekChar( tokenizer, 0 ) == '\'' )
             {
                 ++tokenizer->at;
             }
@@ -233,17 +226,18 @@ internal Token GetToken( Tokenizer *tokenizer )
         {
             result.type = Token_Type::String;
             result.text = tokenizer->at;
-            while ( tokenizer->at[ 0 ] && tokenizer->at[ 0 ] != '"' )
+            for ( ;; )
             {
-                if ( tokenizer->at[ 0 ] == '\\' && tokenizer->at[ 1 ] )
+                tokenizer->at = FindStringStop( tokenizer->at, tokenizer->end );
+                if ( PeekChar( tokenizer, 0 ) != '\\' )
                 {
-                    ++tokenizer->at;
+                    break;
                 }
-                ++tokenizer->at;
+                tokenizer->at += PeekChar( tokenizer, 1 ) ? 2 : 1;
             }
             result.textLength = tokenizer->at - result.text;
 
-            if ( tokenizer->at[ 0 ] == '"' )
+            if ( PeekChar( tokenizer, 0 ) == '"' )
             {
                 ++tokenizer->at;
             }
@@ -255,9 +249,9 @@ internal Token GetToken( Tokenizer *tokenizer )
             if ( IsAlpha( c ) || c == '_' )
             {
                 result.type = Token_Type::Identifier;
-                while ( tokenizer->at[ 0 ] && ( IsAlpha( tokenizer->at[ 0 ] ) ||
-                                                IsNumber( tokenizer->at[ 0 ] ) ||
-                                                tokenizer->at[ 0 ] == '_' ) )
+                while ( tokenizer->at < tokenizer->end && ( IsAlpha( tokenizer->at[ 0 ] ) ||
+                                                            IsNumber( tokenizer->at[ 0 ] ) ||
+                                                            tokenizer->at[ 0 ] == '_' ) )
                 {
                     ++tokenizer->at;
                 }
@@ -266,21 +260,22 @@ internal Token GetToken( Tokenizer *tokenizer )
             else if ( IsNumber( c ) )
             {
                 result.type = Token_Type::Number;
-                while ( IsNumber( tokenizer->at[ 0 ] ) )
+                while ( IsNumber( PeekChar( tokenizer, 0 ) ) )
                 {
                     ++tokenizer->at;
                 }
 
-                if ( tokenizer->at[ 0 ] == '.' || tokenizer->at[ 0 ] == 'b' )
+                char suffix = PeekChar( tokenizer, 0 );
+                if ( suffix == '.' || suffix == 'b' )
                 {
-                    while ( IsNumber( tokenizer->at[ 0 ] ) )
+                    while ( IsNumber( PeekChar( tokenizer, 0 ) ) )
                     {
                         ++tokenizer->at;
                     }
                 }
-                else if ( tokenizer->at[ 0 ] == 'x' )
+                else if ( suffix == 'x' )
                 {
-                    while ( IsNumber( tokenizer->at[ 0 ] ) || IsAlpha( tokenizer->at[ 0 ] ) )
+                    while ( IsNumber( PeekChar( tokenizer, 0 ) ) || IsAlpha( PeekChar( tokenizer, 0 ) ) )
                     {
                         ++tokenizer->at;
                     }
@@ -304,6 +299,37 @@ struct Field_Declaration
     char *name;
 };
 
+// NOTE: the first array fills one pooled arena chunk, anything bigger would get a dedicated chunk
+// that goes back to the OS after every file
+#define FIELD_BUFFER_INITIAL_CAPACITY ( ( u32 ) ( ARENA_CHUNK_SIZE / sizeof( Field_Declaration ) ) )
+
+// NOTE: arguments and fields are pushed here as the declaration is walked, so nothing is counted up
+// front. It doubles inside the scratch arena, the outgrown arrays stay there until the file is done.
+struct Field_Buffer
+{
+    Chunked_Arena *arena;
+    u32 count;
+    u32 capacity;
+    Field_Declaration *fields;
+};
+
+internal Field_Declaration *PushField( Field_Buffer *buffer )
+{
+    if ( buffer->count == buffer->capacity )
+    {
+        u32 newCapacity = buffer->capacity ? buffer->capacity * 2 : FIELD_BUFFER_INITIAL_CAPACITY;
+        Field_Declaration *newFields = PushArray( buffer->arena, newCapacity, Field_Declaration );
+        if ( buffer->fields )
+        {
+            memcpy( newFields, buffer->fields, buffer->count * sizeof( Field_Declaration ) );
+        }
+        buffer->fields = newFields;
+        buffer->capacity = newCapacity;
+    }
+
+    return buffer->fields + buffer->count++;
+}
+
 enum class Struct_Type
 {
     Struct,
@@ -311,37 +337,45 @@ enum class Struct_Type
     Union
 };
 
+// NOTE: the arguments or fields are already in the table, or the declaration has none
+#define DETAIL_OFFSET_NONE 0xFFFFFFFF
+
+// NOTE: the parser builds these lists in a scratch arena, StoreDeclarations flattens them into the
+// file's Declaration_Table once the file is done
 struct Struct_Declaration
 {
-    char *file;
     u32 line;
 
     Struct_Type type;
     char *name;
 
+    // NOTE: byte offset of the first token after the opening brace when the fields were skipped
+    u32 detailOffset;
+    // NOTE: index into the file's Field_Buffer
+    u32 firstField;
     u32 fieldCount;
-    Field_Declaration *fields;
 
     Struct_Declaration *nextInList;
 };
 
 struct Function_Declaration
 {
-    char *file;
     u32 line;
 
     char *name;
     char *returnType;
 
+    // NOTE: byte offset of the first token after the opening paren when the arguments were skipped
+    u32 detailOffset;
+    // NOTE: index into the file's Field_Buffer
+    u32 firstArgument;
     u32 argumentCount;
-    Field_Declaration *arguments;
 
     Function_Declaration *nextInList;
 };
 
 struct Macro_Declaration
 {
-    char *file;
     u32 line;
 
     char *name;
@@ -349,149 +383,550 @@ struct Macro_Declaration
     Macro_Declaration *nextInList;
 };
 
-struct File_State
+struct Declaration_Lists
 {
-    Memory_Arena arena;
-    char *name;
-    FILETIME lastWrite;
-
-    u32 structCount = 0;
+    u32 structCount;
     Struct_Declaration *structs;
 
-    u32 functionCount = 0;
+    u32 functionCount;
     Function_Declaration *functions;
 
-    u32 macroCount = 0;
+    u32 macroCount;
     Macro_Declaration *macros;
 
-    File_State *nextInHash;
+    Field_Buffer fields;
+    bool detailsPending;
+};
+
+enum Declaration_Kind : u8
+{
+    DeclarationKind_Function,
+    DeclarationKind_Struct,
+    DeclarationKind_Enum,
+    DeclarationKind_Union,
+    DeclarationKind_Macro,
+};
+
+// NOTE: a file's declarations as columns: functions first, then structs, enums and unions, then
+// macros, each group in source order. Arguments and fields of every declaration share one flat
+// table, a declaration owns fieldCounts[ i ] entries starting at firstFields[ i ].
+struct Declaration_Table
+{
+    u32 count;
+    char **names;
+    u32 *lines;
+    u8 *kinds;
+    // NOTE: return type of functions, 0 for everything else
+    char **types;
+    u32 *firstFields;
+    u32 *fieldCounts;
+    // NOTE: only there while some declaration's details were skipped, DETAIL_OFFSET_NONE for the rest
+    u32 *detailOffsets;
+
+    u32 fieldCount;
+    char **fieldTypes;
+    char **fieldNames;
+};
+
+struct File_State
+{
+    Chunked_Arena arena;
+    char *name;
+    u32 nameLength;
+    u64 nameHash;
+    u64 lastWrite;
+    u64 fileSize;
+    u64 contentHash;
+
+    // NOTE: the ranges of each group in the declaration table
+    u32 functionCount;
+    u32 structCount;
+    u32 macroCount;
+    Declaration_Table declarations;
+    bool detailsPending;
+
+    // NOTE: the file's name -> declarations pair as GetDeclarations sends it, encoded on first use
+    // into the file arena, so it goes away with every reset of the arena
+    u8 *encodedDeclarations;
+    u32 encodedDeclarationsLength;
+
+    // NOTE: generation in which the declarations last changed or the file was removed.
+    // Removed files are kept in the hash as tombstones so delta requests can report them.
+    u32 generation;
+    u32 lastSeenScan;
+    bool removed;
+    bool parsed;
+
+    File_State *nextToParse;
+};
+
+#define FILE_TABLE_INITIAL_SLOTS 1024
+
+struct File_Slot
+{
+    u64 hash;
+    File_State *file;
+};
+
+// NOTE: every file state ever created, removed ones included, lives in the dense states array in
+// creation order, that's what everything iterates. The slots are an open addressing index into it
+// keyed by the path hash, entries are never deleted since removed files stay as tombstones.
+struct File_Table
+{
+    u32 count;
+    u32 capacity;
+    File_State **states;
+
+    u32 slotCount;
+    File_Slot *slots;
 };
 
 struct Parse_State
 {
+    Work_Queue *workQueue;
+    File_State *parseList;
+
     u32 fileCount;
-    File_State *filesHash[ 32 ];
+    u32 generation;
+    // NOTE: picked at startup, generations only mean something together with the epoch they came from
+    u32 epoch;
+    u32 scanIndex;
+    // NOTE: removed files keep their chunks until no worker can still be parsing them
+    bool removedPending;
+    File_Table files;
 };
 
-inline bool StringsAreEqual( char *a, char *b )
+// NOTE: names and types live in the global intern pool instead of the file arena, so the many
+// copies of u32 or char * across a tree are stored once
+inline char *InternString( Token token )
+{
+    return InternString( token.text, ( u32 ) token.textLength );
+}
+
+// NOTE: the columns go in one block so a file's table is a single allocation, the pointer columns
+// first to keep everything aligned
+internal void AllocateDeclarationTable( Declaration_Table *table, Chunked_Arena *arena, u32 count, u32 fieldCount,
+                                        bool detailsPending = false )
 {
-    char *at = b;
-    for ( u64 index = 0; index < strlen( a ); ++index, ++at )
+    *table = {};
+    if ( count == 0 )
     {
-        if ( *at == '\0' || a[ index ] != *at )
-        {
-            return false;
-        }
+        return;
     }
 
-    bool result = *at == '\0';
-    return result;
+    u32 offsetCount = detailsPending ? count : 0;
+    memory_index size = ( 2 * count + 2 * fieldCount ) * sizeof( char * ) + ( 3 * count + offsetCount ) * sizeof( u32 ) + count;
+    u8 *at = ( u8 * ) PushSize( arena, size );
+
+    table->count = count;
+    table->fieldCount = fieldCount;
+    table->names = ( char ** ) at;
+    table->types = table->names + count;
+    table->fieldTypes = table->types + count;
+    table->fieldNames = table->fieldTypes + fieldCount;
+    table->lines = ( u32 * ) ( table->fieldNames + fieldCount );
+    table->firstFields = table->lines + count;
+    table->fieldCounts = table->firstFields + count;
+    table->detailOffsets = detailsPending ? table->fieldCounts + count : 0;
+    table->kinds = ( u8 * ) ( table->fieldCounts + count + offsetCount );
 }
 
-inline u32 HashString( char *string, u32 length )
+// NOTE: the lists are built by pushing onto the front, so they are walked backwards into the columns
+internal void StoreDeclarations( File_State *fileState, Declaration_Lists *lists )
 {
-    u32 result = 0;
+    u32 fieldCount = lists->fields.count;
+    fileState->functionCount = lists->functionCount;
+    fileState->structCount = lists->structCount;
+    fileState->macroCount = lists->macroCount;
+    fileState->detailsPending = lists->detailsPending;
+
+    Declaration_Table *table = &fileState->declarations;
+    AllocateDeclarationTable( table, &fileState->arena, lists->functionCount + lists->structCount + lists->macroCount, fieldCount,
+                              lists->detailsPending );
+
+    u32 fieldIndex = 0;
+    u32 index = lists->functionCount;
+    for ( Function_Declaration *function = lists->functions; function; function = function->nextInList )
+    {
+        --index;
+        table->names[ index ] = function->name;
+        table->lines[ index ] = function->line;
+        table->kinds[ index ] = DeclarationKind_Function;
+        table->types[ index ] = function->returnType;
+        table->firstFields[ index ] = fieldIndex;
+        table->fieldCounts[ index ] = function->argumentCount;
+        if ( table->detailOffsets )
+        {
+            table->detailOffsets[ index ] = function->detailOffset;
+        }
+        for ( u32 argIndex = 0; argIndex < function->argumentCount; ++argIndex, ++fieldIndex )
+        {
+            Field_Declaration *arg = lists->fields.fields + function->firstArgument + argIndex;
+            table->fieldTypes[ fieldIndex ] = arg->type;
+            table->fieldNames[ fieldIndex ] = arg->name;
+        }
+    }
 
-    for ( u32 i = 0; i < length; ++i )
+    index = lists->functionCount + lists->structCount;
+    for ( Struct_Declaration *structure = lists->structs; structure; structure = structure->nextInList )
     {
-        result = 31 * result + string[ i ];
+        --index;
+        table->names[ index ] = structure->name;
+        table->lines[ index ] = structure->line;
+        table->kinds[ index ] = ( u8 ) ( DeclarationKind_Struct + ( u32 ) structure->type );
+        table->firstFields[ index ] = fieldIndex;
+        table->fieldCounts[ index ] = structure->fieldCount;
+        if ( table->detailOffsets )
+        {
+            table->detailOffsets[ index ] = structure->detailOffset;
+        }
+        for ( u32 structFieldIndex = 0; structFieldIndex < structure->fieldCount; ++structFieldIndex, ++fieldIndex )
+        {
+            Field_Declaration *field = lists->fields.fields + structure->firstField + structFieldIndex;
+            table->fieldTypes[ fieldIndex ] = field->type;
+            table->fieldNames[ fieldIndex ] = field->name;
+        }
     }
 
-    return result;
+    index = table->count;
+    for ( Macro_Declaration *macro = lists->macros; macro; macro = macro->nextInList )
+    {
+        --index;
+        table->names[ index ] = macro->name;
+        table->lines[ index ] = macro->line;
+        table->kinds[ index ] = DeclarationKind_Macro;
+        if ( table->detailOffsets )
+        {
+            table->detailOffsets[ index ] = DETAIL_OFFSET_NONE;
+        }
+    }
 }
 
-inline u32 HashString( char *string )
+// NOTE: steps until the token has the given type or the file ends. Every loop that scans ahead
+// in the parser stops at the end of the file, a half typed declaration in a file that was just saved
+// must not keep a worker spinning.
+inline Token SkipUntil( Tokenizer *tokenizer, Token token, Token_Type type )
 {
-    return HashString( string, ( u32 ) strlen( string ) );
+    while ( token.type != type && token.type != Token_Type::EndOfStream )
+    {
+        token = GetToken( tokenizer );
+    }
+    return token;
 }
 
-inline char *PushAndCopyString( Memory_Arena *arena, Token string )
+// NOTE: the Parse functions walk the arguments or fields once, pushing them onto the buffer as they
+// go. Without a buffer they only step over them the way they would extract them, that's how lazy
+// mode skips the details and still ends up in the same place. They return how many arguments or
+// fields there are either way.
+
+// NOTE: nextToken is the first token after the opening paren, stops right after the closing one
+internal u32 ParseFunctionArguments( Tokenizer *tokenizer, Token nextToken, Field_Buffer *buffer, Function_Declaration *function )
 {
-    char *result = PushString( arena, string.textLength + 1 );
-    strncpy_s( result, string.textLength + 1, string.text, string.textLength );
-    result[ string.textLength ] = '\0';
+    if ( buffer )
+    {
+        function->firstArgument = buffer->count;
+    }
 
-    return result;
+    u32 walkedCount = 0;
+    while ( nextToken.type != Token_Type::CloseParen && nextToken.type != Token_Type::EndOfStream )
+    {
+        Token argType = nextToken;
+        Token argName;
+        nextToken = GetToken( tokenizer );
+        if ( nextToken.type == Token_Type::Comma )
+        {
+            argName = argType;
+            argType.text = "macro_arg";
+            argType.textLength = 9;
+            nextToken = GetToken( tokenizer );
+        }
+        else if ( nextToken.type == Token_Type::CloseParen )
+        {
+            argName = argType;
+            argType.text = "macro_arg";
+            argType.textLength = 9;
+            walkedCount += 1;
+            if ( buffer )
+            {
+                Field_Declaration *arg = PushField( buffer );
+                arg->type = InternString( argType );
+                arg->name = InternString( argName );
+                function->argumentCount += 1;
+            }
+            break;
+        }
+        else
+        {
+            if ( nextToken.type == Token_Type::Asterisk )
+            {
+                argType.textLength = nextToken.text - argType.text + 1;
+                nextToken = GetToken( tokenizer );
+            }
+            argName = nextToken;
+
+            while ( nextToken.type != Token_Type::Comma && nextToken.type != Token_Type::CloseParen &&
+                    nextToken.type != Token_Type::EndOfStream )
+            {
+                nextToken = GetToken( tokenizer );
+                if ( nextToken.type == Token_Type::OpenBrace )
+                {
+                    nextToken = SkipUntil( tokenizer, nextToken, Token_Type::CloseBrace );
+                    nextToken = GetToken( tokenizer );
+                }
+
+                if ( nextToken.type == Token_Type::OpenParen )
+                {
+                    nextToken = SkipUntil( tokenizer, nextToken, Token_Type::CloseParen );
+                    nextToken = GetToken( tokenizer );
+                }
+            }
+
+            if ( nextToken.type == Token_Type::Comma )
+            {
+                nextToken = GetToken( tokenizer );
+            }
+        }
+        walkedCount += 1;
+        if ( buffer )
+        {
+            Field_Declaration *arg = PushField( buffer );
+            arg->type = InternString( argType );
+            arg->name = InternString( argName );
+            function->argumentCount += 1;
+        }
+    }
+    return walkedCount;
 }
 
-internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
+// NOTE: a declaration without fields puts the tokenizer back where the body started, so whatever is
+// declared inside it is picked up like anything else in the file. The tokens stay counted, they were
+// read.
+inline void RewindTokenizer( Tokenizer *tokenizer, Tokenizer *bodyStart )
 {
-    bool fileParsed = false;
-    if ( file[ strlen( file ) - 1 ] == '~' )
+    u64 tokenCount = tokenizer->tokenCount;
+    *tokenizer = *bodyStart;
+    tokenizer->tokenCount = tokenCount;
+}
+
+// NOTE: nextToken is the first token after the opening brace
+internal u32 ParseEnumFields( Tokenizer *tokenizer, Token nextToken, Field_Buffer *buffer, Struct_Declaration *structure )
+{
+    Tokenizer bodyStart = *tokenizer;
+    if ( buffer )
     {
-        // printf( "Skipping backup file %s\n", fd.cFileName );
-        return false;
+        structure->firstField = buffer->count;
     }
 
-    u32 fileIndex = HashString( file ) % ArrayCount( state->filesHash );
-    File_State *fileState = 0;
-    for ( File_State *testState = state->filesHash[ fileIndex ]; testState; testState = testState->nextInHash )
+    u32 fieldCount = 0;
+    while ( nextToken.type != Token_Type::CloseBrace && nextToken.type != Token_Type::EndOfStream )
     {
-        if ( StringsAreEqual( testState->name, file ) )
+        if ( nextToken.type == Token_Type::Identifier )
         {
-            fileState = testState;
-            break;
+            fieldCount += 1;
+            if ( buffer )
+            {
+                Field_Declaration *field = PushField( buffer );
+                field->type = 0;
+                field->name = InternString( nextToken );
+                structure->fieldCount += 1;
+            }
         }
+        nextToken = GetToken( tokenizer );
     }
 
-    FILETIME writeTime = {};
-    if ( !fileState )
+    if ( fieldCount == 0 )
     {
-        state->fileCount += 1;
-        fileState = PushStruct( arena, File_State );
-        fileState->nextInHash = state->filesHash[ fileIndex ];
-        state->filesHash[ fileIndex ] = fileState;
-
-        u32 pathLength = ( u32 ) strlen( file );
-        fileState->name = PushString( arena, pathLength + 1 );
-        strcpy_s( fileState->name, pathLength + 1, file );
-        fileState->lastWrite = {};
-
-        SubArena( &fileState->arena, arena, Megabytes( 1 ) );
-        fileState->structCount = 0;
-        fileState->functionCount = 0;
+        RewindTokenizer( tokenizer, &bodyStart );
+    }
+    return fieldCount;
+}
+
+// NOTE: starts after the opening brace and stops after the matching closing one
+internal u32 ParseStructFields( Tokenizer *tokenizer, Field_Buffer *buffer, Struct_Declaration *structure )
+{
+    Tokenizer bodyStart = *tokenizer;
+    if ( buffer )
+    {
+        structure->firstField = buffer->count;
     }
 
-    WIN32_FILE_ATTRIBUTE_DATA data;
-    if ( GetFileAttributesEx( file, GetFileExInfoStandard, &data ) )
+    u32 fieldCount = 0;
+    int openBraces = 1;
+    while ( openBraces > 0 )
     {
-        writeTime = data.ftLastWriteTime;
-        if ( CompareFileTime( &writeTime, &fileState->lastWrite ) != 0 )
+        Token nextToken = GetToken( tokenizer );
+        if ( nextToken.type == Token_Type::EndOfStream )
+        {
+            break;
+        }
+        else if ( nextToken.type == Token_Type::OpenBrace )
+        {
+            openBraces += 1;
+        }
+        else if ( nextToken.type == Token_Type::CloseBrace )
+        {
+            openBraces -= 1;
+        }
+        else if ( nextToken.type == Token_Type::Identifier &&
+                  !TokenEquals( nextToken, "struct" ) &&
+                  !TokenEquals( nextToken, "union" ) )
         {
-            fileState->lastWrite = writeTime;
-            fileState->structCount = 0;
-            fileState->functionCount = 0;
-            fileState->macroCount = 0;
-            fileState->arena.used = 0;
-            u8 *byte = ( u8 * ) fileState->arena.base;
-            memory_index size = fileState->arena.size;
-            while ( size-- )
+            Token type = nextToken;
+            nextToken = GetToken( tokenizer );
+            if ( nextToken.type == Token_Type::Asterisk || nextToken.type == Token_Type::Ampersand )
             {
-                *byte++ = 0;
+                type.textLength = nextToken.text - type.text + 1;
+                nextToken = GetToken( tokenizer );
+            }
+            Token name = nextToken;
+
+            if ( name.type == Token_Type::OpenParen || TokenEquals( name, "operator" ) ) // skip functions
+            {
+                nextToken = SkipUntil( tokenizer, nextToken, Token_Type::CloseParen );
+                nextToken = GetToken( tokenizer );
+                if ( nextToken.type == Token_Type::OpenBrace )
+                {
+                    nextToken = SkipUntil( tokenizer, nextToken, Token_Type::CloseBrace );
+                }
+            }
+            else if ( name.type == Token_Type::OpenBrace )
+            {
+                openBraces += 1;
+            }
+            else if ( name.type == Token_Type::CloseBrace )
+            {
+                openBraces -= 1;
+            }
+            else if ( name.type == Token_Type::Semicolon || name.type == Token_Type::Equals ||
+                      name.type == Token_Type::EndOfStream )
+            {
+                // NOTE: not a field, the name of a nested aggregate like the u in union { ... } u;
+            }
+            else
+            {
+                fieldCount += 1;
+                Field_Declaration *field = 0;
+                char typeBuffer[ 128 ] = {};
+                if ( buffer )
+                {
+                    field = PushField( buffer );
+                    field->name = InternString( name );
+                    structure->fieldCount += 1;
+                    strncpy_s( typeBuffer, sizeof( typeBuffer ), type.text, ( int ) type.textLength );
+                }
+
+                // NOTE: braces are counted so an initializer like x{ 1 } doesn't end the field, and a
+                // closing brace that wasn't opened in it ends the struct body
+                int fieldBraces = 0;
+                nextToken = GetToken( tokenizer );
+                while ( nextToken.type != Token_Type::EndOfStream )
+                {
+                    if ( fieldBraces == 0 &&
+                         ( nextToken.type == Token_Type::Semicolon || nextToken.type == Token_Type::Equals ) )
+                    {
+                        break;
+                    }
+                    else if ( nextToken.type == Token_Type::OpenBrace )
+                    {
+                        fieldBraces += 1;
+                    }
+                    else if ( nextToken.type == Token_Type::CloseBrace )
+                    {
+                        if ( fieldBraces == 0 )
+                        {
+                            openBraces -= 1;
+                            break;
+                        }
+                        fieldBraces -= 1;
+                    }
+
+                    // NOTE: long types get cut off instead of running past the buffer
+                    u64 typeLength = strlen( typeBuffer );
+                    if ( field && typeLength + nextToken.textLength < sizeof( typeBuffer ) )
+                    {
+                        char concatenated[ 128 ] = {};
+                        ConcatenateStrings( typeBuffer, ( int ) typeLength, nextToken.text, ( int ) nextToken.textLength, concatenated );
+                        strncpy_s( typeBuffer, sizeof( typeBuffer ), concatenated, strlen( concatenated ) );
+                    }
+                    nextToken = GetToken( tokenizer );
+                }
+
+                if ( field )
+                {
+                    type.text = typeBuffer;
+                    type.textLength = strlen( typeBuffer );
+                    field->type = InternString( type );
+                }
             }
         }
-        else
+        else if ( nextToken.type == Token_Type::Preprocessor )
         {
-            return false;
+            while ( tokenizer->at < tokenizer->end && tokenizer->at[ 0 ] != '\n' )
+            {
+                ++tokenizer->at;
+            }
         }
     }
 
-    printf( "Parsing file %s\n", fileState->name );
-    fileParsed = true;
+    if ( fieldCount == 0 )
+    {
+        RewindTokenizer( tokenizer, &bodyStart );
+    }
+    return fieldCount;
+}
 
-    Struct_Declaration *fileStructs = fileState->structs;
-    Function_Declaration *fileFunctions = fileState->functions;
+// NOTE: runs on the work queue threads, it only touches the file's own arena and declarations.
+// Returns true when the declarations were reparsed, a file whose content hashes the same as last
+// time (checkouts, formatters and build tools touching the write time) keeps its declarations.
+internal bool ParseFile( File_State *fileState )
+{
+    // NOTE: the declarations intern the names they keep, so the mapping is only
+    // needed while parsing. Keeping it around would stop editors from truncating or replacing the file.
+    u64 readStart = ReadTimer();
+    Mapped_File source;
+    if ( !MapEntireFile( fileState->name, &source ) )
+    {
+        printf( "Failed to open file %s\n", fileState->name );
+        return false;
+    }
+    char *fileContent = source.content;
+    u32 fileSize = source.size;
 
-    char *fileContent = ReadEntireFileIntoMemoryAndNullTerminate( file );
-    if ( !fileContent )
+    u64 contentHash = HashBytes( fileContent, fileSize );
+    EndPhase( StatPhase_Read, readStart );
+    if ( fileState->contentHash && contentHash == fileState->contentHash && fileSize == fileState->fileSize )
     {
-        printf( "Failed to open file %s\n", file );
+        AddToCounter( StatCounter_FilesUnchanged, 1 );
+        if ( GlobalLogParsing )
+        {
+            printf( "Unchanged file %s\n", fileState->name );
+        }
+        UnmapFile( &source );
         return false;
     }
+
+    ResetChunkedArena( &fileState->arena );
+    fileState->encodedDeclarations = 0;
+    fileState->encodedDeclarationsLength = 0;
+    Chunked_Arena scratch = {};
+    Declaration_Lists lists = {};
+    lists.fields.arena = &scratch;
+    // NOTE: lazy mode steps over arguments and fields without storing them
+    Field_Buffer *detailBuffer = GlobalLazyDetails ? 0 : &lists.fields;
+
+    if ( GlobalLogParsing )
+    {
+        printf( "Parsing file %s\n", fileState->name );
+    }
+
+    fileState->fileSize = fileSize;
+    fileState->contentHash = contentHash;
     Tokenizer tokenizer = {};
     tokenizer.at = fileContent;
+    tokenizer.end = fileContent + fileSize;
     tokenizer.lineCount = 1;
 
+    u64 parseStart = ReadTimer();
     bool parsing = true;
 
     while ( parsing )
@@ -505,15 +940,14 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                 {
                     Token name = GetToken( &tokenizer );
 
-                    Macro_Declaration *macro = PushStruct( &fileState->arena, Macro_Declaration );
+                    Macro_Declaration *macro = PushStruct( &scratch, Macro_Declaration );
                     macro->line = tokenizer.lineCount;
-                    macro->file = fileState->name;
-                    macro->name = PushAndCopyString( &fileState->arena, name );
+                    macro->name = InternString( name );
                     // printf( "Macro name %s\n", macro->name );
 
-                    macro->nextInList = fileState->macros;
-                    fileState->macros = macro;
-                    fileState->macroCount += 1;
+                    macro->nextInList = lists.macros;
+                    lists.macros = macro;
+                    lists.macroCount += 1;
                 }
                 break;
 
@@ -521,10 +955,7 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                 {
                     if ( TokenEquals( token, "typedef" ) )
                     {
-                        while ( token.type != Token_Type::Semicolon )
-                        {
-                            token = GetToken( &tokenizer );
-                        }
+                        token = SkipUntil( &tokenizer, token, Token_Type::Semicolon );
                     }
                     else if ( TokenEquals( token, "extern" ) || TokenEquals( token, "inline" ) || TokenEquals( token, "internal" ) )
                     {
@@ -533,10 +964,7 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                             token = GetToken( &tokenizer );
                             if ( token.type != Token_Type::String && !TokenEquals( token, "C" ) )
                             {
-                                while ( token.type != Token_Type::Semicolon )
-                                {
-                                    token = GetToken( &tokenizer );
-                                }
+                                token = SkipUntil( &tokenizer, token, Token_Type::Semicolon );
                                 continue;
                             }
                             char *temp = tokenizer.at;
@@ -545,10 +973,7 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                             {
                                 if ( TokenEquals( token, "__declspec" ) )
                                 {
-                                    while ( token.type != Token_Type::CloseParen )
-                                    {
-                                        token = GetToken( &tokenizer );
-                                    }
+                                    token = SkipUntil( &tokenizer, token, Token_Type::CloseParen );
                                 }
                                 else
                                 {
@@ -560,182 +985,68 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                                 continue;
                             }
                         }
-                        char *temp = tokenizer.at;
-                        while ( *temp && *temp != ')' )
+                        Token type = GetToken( &tokenizer );
+                        Token nextToken = GetToken( &tokenizer );
+                        Token name;
+                        if ( nextToken.type == Token_Type::OpenParen )
                         {
-                            ++temp;
+                            name = type;
+                            type.text = "macro_function";
+                            type.textLength = 14;
                         }
-
-                        //process if it's not forward declared
-                        if ( temp[ 1 ] != ';' )
+                        else
                         {
-                            Function_Declaration *function = PushStruct( &fileState->arena, Function_Declaration );
-                            Token type = GetToken( &tokenizer );
-                            Token nextToken = GetToken( &tokenizer );
-                            Token name;
-                            if ( nextToken.type == Token_Type::OpenParen )
-                            {
-                                name = type;
-                                type.text = "macro_function";
-                                type.textLength = 14;
-                            }
-                            else
-                            {
-                                if ( nextToken.type == Token_Type::Asterisk || nextToken.type == Token_Type::Ampersand )
-                                {
-                                    type.textLength = nextToken.text - type.text + 1;
-                                    nextToken = GetToken( &tokenizer );
-                                }
-                                name = nextToken;
-                            }
-
-                            if ( TokenEquals( name, "operator" ) )
+                            if ( nextToken.type == Token_Type::Asterisk || nextToken.type == Token_Type::Ampersand )
                             {
-                                continue;
+                                type.textLength = nextToken.text - type.text + 1;
+                                nextToken = GetToken( &tokenizer );
                             }
-                            function->line = tokenizer.lineCount;
-                            function->file = fileState->name;
-                            function->returnType = PushAndCopyString( &fileState->arena, type );
-                            function->name = PushAndCopyString( &fileState->arena, name );
-                            // printf( "Function name %s\n", function->name );
+                            name = nextToken;
+                        }
 
-                            if ( nextToken.type != Token_Type::OpenParen )
-                            {
-                                nextToken = GetToken( &tokenizer ); // open paren
-                            }
-                            nextToken = GetToken( &tokenizer ); // close paren if no arguments
+                        if ( TokenEquals( name, "operator" ) )
+                        {
+                            continue;
+                        }
+                        u32 line = tokenizer.lineCount;
 
-                            Tokenizer counter = tokenizer;
-                            Token counterToken = nextToken;
-                            u32 argCount = 0;
-                            while ( counterToken.type != Token_Type::CloseParen )
+                        if ( nextToken.type != Token_Type::OpenParen )
+                        {
+                            nextToken = GetToken( &tokenizer ); // open paren
+                        }
+                        char *detailStart = tokenizer.at;
+                        nextToken = GetToken( &tokenizer ); // close paren if no arguments
+                        Function_Declaration function = {};
+                        u32 argumentCount = ParseFunctionArguments( &tokenizer, nextToken, detailBuffer, &function );
+
+                        // NOTE: the arguments end at the closing paren, a semicolon right after it
+                        // means this was only forward declared
+                        if ( PeekChar( &tokenizer, 0 ) == ';' )
+                        {
+                            if ( detailBuffer )
                             {
-                                counterToken = GetToken( &counter );
-                                if ( counterToken.type == Token_Type::Comma )
-                                {
-                                    argCount += 1;
-                                    counterToken = GetToken( &counter );
-                                }
-                                else if ( counterToken.type == Token_Type::CloseParen )
-                                {
-                                    argCount += 1;
-                                    break;
-                                }
-                                else
-                                {
-                                    if ( counterToken.type == Token_Type::Asterisk || counterToken.type == Token_Type::Ampersand )
-                                    {
-                                        counterToken = GetToken( &counter );
-                                    }
-
-                                    argCount += 1;
-                                    while ( counterToken.type != Token_Type::Comma && counterToken.type != Token_Type::CloseParen )
-                                    {
-                                        counterToken = GetToken( &counter );
-                                        if ( counterToken.type == Token_Type::OpenBrace )
-                                        {
-                                            while ( counterToken.type == Token_Type::CloseBrace )
-                                            {
-                                                counterToken = GetToken( &counter );
-                                            }
-                                            counterToken = GetToken( &counter );
-                                        }
-
-                                        if ( counterToken.type == Token_Type::OpenParen )
-                                        {
-                                            while ( counterToken.type == Token_Type::CloseParen )
-                                            {
-                                                counterToken = GetToken( &counter );
-                                            }
-                                            counterToken = GetToken( &counter );
-                                        }
-                                    }
-
-                                    if ( counterToken.type == Token_Type::Comma )
-                                    {
-                                        counterToken = GetToken( &counter );
-                                    }
-                                }
+                                detailBuffer->count = function.firstArgument;
                             }
+                            continue;
+                        }
 
-                            if ( argCount > 0 )
-                            {
-                                function->arguments = PushArray( &fileState->arena, argCount, Field_Declaration );
-                                while ( nextToken.type != Token_Type::CloseParen )
-                                {
-                                    Token argType = nextToken;
-                                    Token argName;
-                                    nextToken = GetToken( &tokenizer );
-                                    if ( nextToken.type == Token_Type::Comma )
-                                    {
-                                        argName = argType;
-                                        argType.text = "macro_arg";
-                                        argType.textLength = 9;
-                                        nextToken = GetToken( &tokenizer );
-                                    }
-                                    else if ( nextToken.type == Token_Type::CloseParen )
-                                    {
-                                        argName = argType;
-                                        argType.text = "macro_arg";
-                                        argType.textLength = 9;
-                                        // printf( "Test %.*s\n", ( int ) argType.textLength, argType.text );
-                                        Field_Declaration *arg = function->arguments + function->argumentCount++;
-                                        arg->type = PushAndCopyString( &fileState->arena, argType );
-                                        arg->name = PushAndCopyString( &fileState->arena, argName );
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        if ( nextToken.type == Token_Type::Asterisk || counterToken.type == Token_Type::Ampersand )
-                                        {
-                                            argType.textLength = nextToken.text - argType.text + 1;
-                                            nextToken = GetToken( &tokenizer );
-                                        }
-                                        argName = nextToken;
-
-                                        while ( nextToken.type != Token_Type::Comma && nextToken.type != Token_Type::CloseParen )
-                                        {
-                                            nextToken = GetToken( &tokenizer );
-                                            if ( nextToken.type == Token_Type::OpenBrace )
-                                            {
-                                                while ( nextToken.type != Token_Type::CloseBrace )
-                                                {
-                                                    nextToken = GetToken( &tokenizer );
-                                                }
-                                                nextToken = GetToken( &tokenizer );
-                                            }
-
-                                            if ( nextToken.type == Token_Type::OpenParen )
-                                            {
-                                                while ( nextToken.type != Token_Type::CloseParen )
-                                                {
-                                                    nextToken = GetToken( &tokenizer );
-                                                }
-                                                nextToken = GetToken( &tokenizer );
-                                            }
-                                        }
-
-                                        if ( nextToken.type == Token_Type::Comma )
-                                        {
-                                            nextToken = GetToken( &tokenizer );
-                                        }
-                                    }
-                                    Field_Declaration *arg = function->arguments + function->argumentCount++;
-                                    arg->type = PushAndCopyString( &fileState->arena, argType );
-                                    // printf( "Arg type %s\n", arg->type );
-                                    arg->name = PushAndCopyString( &fileState->arena, argName );
-                                    // printf( "Arg name %s\n", arg->name );
-                                }
-                            }
-                            else
-                            {
-                                function->arguments = 0;
-                            }
+                        Function_Declaration *declaration = PushStruct( &scratch, Function_Declaration );
+                        *declaration = function;
+                        declaration->line = line;
+                        declaration->returnType = InternString( type );
+                        declaration->name = InternString( name );
+                        // printf( "Function name %s\n", declaration->name );
 
-                            function->nextInList = fileState->functions;
-                            fileState->functions = function;
-                            fileState->functionCount += 1;
+                        declaration->detailOffset = DETAIL_OFFSET_NONE;
+                        if ( argumentCount > 0 && GlobalLazyDetails )
+                        {
+                            declaration->detailOffset = ( u32 ) ( detailStart - fileContent );
+                            lists.detailsPending = true;
                         }
+
+                        declaration->nextInList = lists.functions;
+                        lists.functions = declaration;
+                        lists.functionCount += 1;
                     }
                     else if ( TokenEquals( token, "enum" ) )
                     {
@@ -743,10 +1054,7 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
 
                         if ( nextToken.type == Token_Type::OpenBrace )
                         {
-                            while ( nextToken.type != Token_Type::Semicolon )
-                            {
-                                nextToken = GetToken( &tokenizer );
-                            }
+                            nextToken = SkipUntil( &tokenizer, nextToken, Token_Type::Semicolon );
                             continue;
                         }
                         Token name;
@@ -763,54 +1071,26 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                         //process if it's not forward declared
                         if ( nextToken.type != Token_Type::Semicolon )
                         {
-                            Struct_Declaration *structure = PushStruct( &fileState->arena, Struct_Declaration );
-                            structure->file = fileState->name;
+                            Struct_Declaration *structure = PushStruct( &scratch, Struct_Declaration );
                             structure->line = tokenizer.lineCount - 1;
                             structure->type = Struct_Type::Enum;
-                            structure->name = PushAndCopyString( &fileState->arena, name );
+                            structure->name = InternString( name );
                             // printf( "Enum name %s\n", structure->name );
 
-                            while ( nextToken.type != Token_Type::OpenBrace )
-                            {
-                                nextToken = GetToken( &tokenizer );
-                            }
+                            nextToken = SkipUntil( &tokenizer, nextToken, Token_Type::OpenBrace );
 
+                            char *detailStart = tokenizer.at;
                             nextToken = GetToken( &tokenizer );
-
-                            Tokenizer counter = tokenizer;
-                            Token counterToken = nextToken;
-                            u32 fieldCount = 0;
-                            while ( counterToken.type != Token_Type::CloseBrace )
-                            {
-                                if ( counterToken.type == Token_Type::Identifier )
-                                {
-                                    fieldCount += 1;
-                                }
-                                counterToken = GetToken( &counter );
-                            }
-
-                            if ( fieldCount > 0 )
-                            {
-                                structure->fields = PushArray( &fileState->arena, fieldCount, Field_Declaration );
-
-                                while ( nextToken.type != Token_Type::CloseBrace )
-                                {
-                                    if ( nextToken.type == Token_Type::Identifier )
-                                    {
-                                        Field_Declaration *field = structure->fields + structure->fieldCount++;
-                                        field->name = PushAndCopyString( &fileState->arena, nextToken );
-                                    }
-                                    nextToken = GetToken( &tokenizer );
-                                }
-                            }
-                            else
+                            structure->detailOffset = DETAIL_OFFSET_NONE;
+                            if ( ParseEnumFields( &tokenizer, nextToken, detailBuffer, structure ) > 0 && GlobalLazyDetails )
                             {
-                                structure->fields = 0;
+                                structure->detailOffset = ( u32 ) ( detailStart - fileContent );
+                                lists.detailsPending = true;
                             }
 
-                            structure->nextInList = fileState->structs;
-                            fileState->structs = structure;
-                            fileState->structCount += 1;
+                            structure->nextInList = lists.structs;
+                            lists.structs = structure;
+                            lists.structCount += 1;
                         }
                     }
                     else if ( TokenEquals( token, "struct" ) || TokenEquals( token, "union" ) )
@@ -832,155 +1112,23 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
                         // process if it's not forward declared
                         if ( nextToken.type != Token_Type::Semicolon )
                         {
-                            Struct_Declaration *structure = PushStruct( &fileState->arena, Struct_Declaration );
-                            structure->file = fileState->name;
+                            Struct_Declaration *structure = PushStruct( &scratch, Struct_Declaration );
                             structure->line = tokenizer.lineCount - 1;
                             structure->type = structType;
-                            structure->name = PushAndCopyString( &fileState->arena, name );
+                            structure->name = InternString( name );
                             // printf( "Struct name %s\n", structure->name );
 
-                            int openBraces = 1;
-                            Tokenizer counter = tokenizer;
-                            Token counterToken = nextToken;
-                            u32 fieldCount = 0;
-                            while ( openBraces > 0 )
-                            {
-                                counterToken = GetToken( &counter );
-                                if ( counterToken.type == Token_Type::OpenBrace )
-                                {
-                                    openBraces += 1;
-                                }
-                                else if ( counterToken.type == Token_Type::CloseBrace )
-                                {
-                                    openBraces -= 1;
-                                }
-                                else if ( counterToken.type == Token_Type::Identifier &&
-                                          !TokenEquals( counterToken, "struct" ) &&
-                                          !TokenEquals( counterToken, "union" ) )
-                                {
-                                    Token counterToken = GetToken( &counter );
-                                    if ( counterToken.type == Token_Type::Asterisk || nextToken.type == Token_Type::Ampersand )
-                                    {
-                                        counterToken = GetToken( &counter );
-                                    }
-
-                                    if ( counterToken.type == Token_Type::OpenParen || TokenEquals( name, "operator" ) ) // skip functions
-                                    {
-                                        while ( counterToken.type != Token_Type::CloseParen )
-                                        {
-                                            counterToken = GetToken( &counter );
-                                        }
-                                        counterToken = GetToken( &counter );
-                                        if ( counterToken.type == Token_Type::OpenBrace )
-                                        {
-                                            while ( counterToken.type != Token_Type::CloseBrace )
-                                            {
-                                                counterToken = GetToken( &counter );
-                                            }
-                                        }
-                                    }
-                                    else
-                                    {
-                                        fieldCount += 1;
-                                        counterToken = GetToken( &counter );
-                                        while ( counterToken.type != Token_Type::Semicolon && nextToken.type != Token_Type::Equals )
-                                        {
-                                            counterToken = GetToken( &counter );
-                                        }
-                                    }
-                                }
-                                else if ( counterToken.type == Token_Type::Preprocessor )
-                                {
-                                    while ( counter.at[ 0 ] && counter.at[ 0 ] != '\n' )
-                                    {
-                                        ++counter.at;
-                                    }
-                                }
-                            }
-
-                            if ( fieldCount > 0 )
+                            structure->detailOffset = DETAIL_OFFSET_NONE;
+                            char *detailStart = tokenizer.at;
+                            if ( ParseStructFields( &tokenizer, detailBuffer, structure ) > 0 && GlobalLazyDetails )
                             {
-                                structure->fields = PushArray( &fileState->arena, fieldCount, Field_Declaration );
-                                openBraces = 1;
-                                while ( openBraces > 0 )
-                                {
-                                    nextToken = GetToken( &tokenizer );
-                                    if ( nextToken.type == Token_Type::OpenBrace )
-                                    {
-                                        openBraces += 1;
-                                    }
-                                    else if ( nextToken.type == Token_Type::CloseBrace )
-                                    {
-                                        openBraces -= 1;
-                                    }
-                                    else if ( nextToken.type == Token_Type::Identifier &&
-                                              !TokenEquals( nextToken, "struct" ) &&
-                                              !TokenEquals( nextToken, "union" ) )
-                                    {
-                                        Token type = nextToken;
-                                        Token nextToken = GetToken( &tokenizer );
-                                        if ( nextToken.type == Token_Type::Asterisk || nextToken.type == Token_Type::Ampersand )
-                                        {
-                                            type.textLength = nextToken.text - type.text + 1;
-                                            nextToken = GetToken( &tokenizer );
-                                        }
-                                        Token name = nextToken;
-
-                                        if ( name.type == Token_Type::OpenParen || TokenEquals( name, "operator" ) ) // skip functions
-                                        {
-                                            while ( nextToken.type != Token_Type::CloseParen )
-                                            {
-                                                nextToken = GetToken( &tokenizer );
-                                            }
-                                            nextToken = GetToken( &tokenizer );
-                                            if ( nextToken.type == Token_Type::OpenBrace )
-                                            {
-                                                while ( nextToken.type != Token_Type::CloseBrace )
-                                                {
-                                                    nextToken = GetToken( &tokenizer );
-                                                }
-                                            }
-                                        }
-                                        else
-                                        {
-                                            Field_Declaration *field = structure->fields + structure->fieldCount++;
-                                            field->name = PushAndCopyString( &fileState->arena, name );
-                                            // printf( "Field name %s\n", field->name );
-
-                                            char typeBuffer[ 128 ] = {};
-                                            strncpy_s( typeBuffer, sizeof( typeBuffer ), type.text, ( int ) type.textLength );
-
-                                            nextToken = GetToken( &tokenizer );
-                                            while ( nextToken.type != Token_Type::Semicolon && nextToken.type != Token_Type::Equals )
-                                            {
-                                                char buffer[ 128 ] = {};
-                                                ConcatenateStrings( typeBuffer, ( int ) strlen( typeBuffer ), nextToken.text, ( int ) nextToken.textLength, buffer );
-                                                strncpy_s( typeBuffer, sizeof( typeBuffer ), buffer, strlen( buffer ) );
-                                                nextToken = GetToken( &tokenizer );
-                                            }
-                                            type.text = typeBuffer;
-                                            type.textLength = strlen( typeBuffer );
-                                            field->type = PushAndCopyString( &fileState->arena, type );
-                                            // printf( "Field type %s\n", field->type );
-                                        }
-                                    }
-                                    else if ( nextToken.type == Token_Type::Preprocessor )
-                                    {
-                                        while ( tokenizer.at[ 0 ] && tokenizer.at[ 0 ] != '\n' )
-                                        {
-                                            ++tokenizer.at;
-                                        }
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                structure->fields = 0;
+                                structure->detailOffset = ( u32 ) ( detailStart - fileContent );
+                                lists.detailsPending = true;
                             }
 
-                            structure->nextInList = fileState->structs;
-                            fileState->structs = structure;
-                            fileState->structCount += 1;
+                            structure->nextInList = lists.structs;
+                            lists.structs = structure;
+                            lists.structCount += 1;
                         }
                     }
                 }
@@ -1000,8 +1148,140 @@ internal bool ParseFile( Parse_State *state, Memory_Arena *arena, char *file )
             }
         }
     }
-    VirtualFree( fileContent, 0, MEM_RELEASE );
-    return fileParsed;
+    EndPhase( StatPhase_Parse, parseStart );
+    UnmapFile( &source );
+
+    u64 storeStart = ReadTimer();
+    StoreDeclarations( fileState, &lists );
+    ResetChunkedArena( &scratch );
+    EndPhase( StatPhase_Store, storeStart );
+
+    AddToCounter( StatCounter_FilesParsed, 1 );
+    AddToCounter( StatCounter_BytesParsed, fileSize );
+    AddToCounter( StatCounter_TokensParsed, tokenizer.tokenCount );
+    return true;
+}
+
+// NOTE: fills in the arguments and fields lazy mode skipped. The whole file is done at once since it
+// has to be mapped and hashed anyway, and the result stays until the file is reparsed. Fails when the
+// file changed since it was parsed, the offsets are stale then and the next refresh reparses it.
+// Runs on the main thread, never while the workers are parsing.
+internal bool ParseFileDetails( File_State *fileState )
+{
+    if ( !fileState->detailsPending )
+    {
+        return true;
+    }
+
+    u64 detailsStart = ReadTimer();
+    Mapped_File source;
+    if ( !MapEntireFile( fileState->name, &source ) )
+    {
+        return false;
+    }
+    if ( source.size != fileState->fileSize || HashBytes( source.content, source.size ) != fileState->contentHash )
+    {
+        UnmapFile( &source );
+        return false;
+    }
+
+    Declaration_Table *table = &fileState->declarations;
+    u32 detailCount = fileState->functionCount + fileState->structCount;
+    Chunked_Arena scratch = {};
+    Field_Buffer parsed = {};
+    parsed.arena = &scratch;
+    // NOTE: where each declaration's fields start in parsed, DETAIL_OFFSET_NONE when they are in the table
+    u32 *parsedFirsts = PushArray( &scratch, detailCount, u32 );
+    u32 *parsedCounts = PushArray( &scratch, detailCount, u32 );
+
+    u32 fieldCount = 0;
+    u64 tokenCount = 0;
+    for ( u32 index = 0; index < detailCount; ++index )
+    {
+        if ( table->detailOffsets[ index ] == DETAIL_OFFSET_NONE )
+        {
+            parsedFirsts[ index ] = DETAIL_OFFSET_NONE;
+            parsedCounts[ index ] = table->fieldCounts[ index ];
+            fieldCount += parsedCounts[ index ];
+            continue;
+        }
+
+        Tokenizer tokenizer = {};
+        tokenizer.at = source.content + table->detailOffsets[ index ];
+        tokenizer.end = source.content + source.size;
+        if ( table->kinds[ index ] == DeclarationKind_Function )
+        {
+            Function_Declaration function = {};
+            ParseFunctionArguments( &tokenizer, GetToken( &tokenizer ), &parsed, &function );
+            parsedFirsts[ index ] = function.firstArgument;
+            parsedCounts[ index ] = function.argumentCount;
+        }
+        else
+        {
+            Struct_Declaration structure = {};
+            if ( table->kinds[ index ] == DeclarationKind_Enum )
+            {
+                ParseEnumFields( &tokenizer, GetToken( &tokenizer ), &parsed, &structure );
+            }
+            else
+            {
+                ParseStructFields( &tokenizer, &parsed, &structure );
+            }
+            parsedFirsts[ index ] = structure.firstField;
+            parsedCounts[ index ] = structure.fieldCount;
+        }
+        fieldCount += parsedCounts[ index ];
+        tokenCount += tokenizer.tokenCount;
+    }
+    UnmapFile( &source );
+    AddToCounter( StatCounter_TokensParsed, tokenCount );
+
+    // NOTE: the old field columns stay in the file arena until the next reparse resets it
+    char **fieldTypes = PushArray( &fileState->arena, 2 * fieldCount, char * );
+    char **fieldNames = fieldTypes + fieldCount;
+    u32 fieldIndex = 0;
+    for ( u32 index = 0; index < detailCount; ++index )
+    {
+        for ( u32 parsedIndex = 0; parsedIndex < parsedCounts[ index ]; ++parsedIndex, ++fieldIndex )
+        {
+            if ( parsedFirsts[ index ] != DETAIL_OFFSET_NONE )
+            {
+                fieldTypes[ fieldIndex ] = parsed.fields[ parsedFirsts[ index ] + parsedIndex ].type;
+                fieldNames[ fieldIndex ] = parsed.fields[ parsedFirsts[ index ] + parsedIndex ].name;
+            }
+            else
+            {
+                fieldTypes[ fieldIndex ] = table->fieldTypes[ table->firstFields[ index ] + parsedIndex ];
+                fieldNames[ fieldIndex ] = table->fieldNames[ table->firstFields[ index ] + parsedIndex ];
+            }
+        }
+    }
+
+    fieldIndex = 0;
+    for ( u32 index = 0; index < detailCount; ++index )
+    {
+        table->firstFields[ index ] = fieldIndex;
+        table->fieldCounts[ index ] = parsedCounts[ index ];
+        table->detailOffsets[ index ] = DETAIL_OFFSET_NONE;
+        fieldIndex += parsedCounts[ index ];
+    }
+    table->fieldCount = fieldCount;
+    table->fieldTypes = fieldTypes;
+    table->fieldNames = fieldNames;
+    ResetChunkedArena( &scratch );
+
+    // NOTE: the cached encoding was made without the details
+    fileState->detailsPending = false;
+    fileState->encodedDeclarations = 0;
+    fileState->encodedDeclarationsLength = 0;
+    EndPhase( StatPhase_Details, detailsStart );
+    return true;
+}
+
+internal WORK_QUEUE_CALLBACK( ParseFileWork )
+{
+    File_State *fileState = ( File_State * ) data;
+    fileState->parsed = ParseFile( fileState );
 }
 
 internal int StringEndsWith( const char *string, const char *suffix )
@@ -1015,44 +1295,279 @@ internal int StringEndsWith( const char *string, const char *suffix )
     return strncmp( string + stringLength - suffixLength, suffix, suffixLength ) == 0;
 }
 
-internal bool ParseFiles( Parse_State *state, Memory_Arena *arena, char *startDirectory )
+internal File_State *FindFileState( File_Table *table, char *file, u32 length, u64 hash )
+{
+    File_State *result = 0;
+    if ( table->slotCount )
+    {
+        u32 slotIndex = ( u32 ) hash & ( table->slotCount - 1 );
+        for ( File_Slot *slot = table->slots + slotIndex; slot->file; slot = table->slots + slotIndex )
+        {
+            if ( slot->hash == hash && slot->file->nameLength == length && memcmp( slot->file->name, file, length ) == 0 )
+            {
+                result = slot->file;
+                break;
+            }
+            slotIndex = ( slotIndex + 1 ) & ( table->slotCount - 1 );
+        }
+    }
+    return result;
+}
+
+inline File_State *FindFileState( Parse_State *state, char *file )
+{
+    u32 length = ( u32 ) strlen( file );
+    return FindFileState( &state->files, file, length, HashBytes( file, length ) );
+}
+
+internal void GrowFileTable( File_Table *table )
+{
+    u32 newSlotCount = table->slotCount ? table->slotCount * 2 : FILE_TABLE_INITIAL_SLOTS;
+    File_Slot *newSlots = ( File_Slot * ) PlatformAllocateMemory( newSlotCount * sizeof( File_Slot ) );
+    for ( u32 slotIndex = 0; slotIndex < table->slotCount; ++slotIndex )
+    {
+        File_Slot *slot = table->slots + slotIndex;
+        if ( slot->file )
+        {
+            u32 newIndex = ( u32 ) slot->hash & ( newSlotCount - 1 );
+            while ( newSlots[ newIndex ].file )
+            {
+                newIndex = ( newIndex + 1 ) & ( newSlotCount - 1 );
+            }
+            newSlots[ newIndex ] = *slot;
+        }
+    }
+
+    // NOTE: the dense array holds at most as many files as the slots allow before growing again
+    u32 newCapacity = newSlotCount / 4 * 3;
+    File_State **newStates = ( File_State ** ) PlatformAllocateMemory( newCapacity * sizeof( File_State * ) );
+    if ( table->count )
+    {
+        memcpy( newStates, table->states, table->count * sizeof( File_State * ) );
+    }
+
+    if ( table->slots )
+    {
+        PlatformFreeMemory( table->slots );
+        PlatformFreeMemory( table->states );
+    }
+    table->slots = newSlots;
+    table->slotCount = newSlotCount;
+    table->states = newStates;
+    table->capacity = newCapacity;
+}
+
+internal void ReleaseFileTable( File_Table *table )
+{
+    if ( table->slots )
+    {
+        PlatformFreeMemory( table->slots );
+        PlatformFreeMemory( table->states );
+    }
+    *table = {};
+}
+
+internal File_State *CreateFileState( Parse_State *state, Memory_Arena *arena, char *file )
+{
+    File_Table *table = &state->files;
+    if ( table->count + 1 > table->capacity )
+    {
+        GrowFileTable( table );
+    }
+
+    state->fileCount += 1;
+    File_State *fileState = PushStruct( arena, File_State );
+
+    u32 pathLength = ( u32 ) strlen( file );
+    fileState->name = PushString( arena, pathLength + 1 );
+    strcpy_s( fileState->name, pathLength + 1, file );
+    fileState->nameLength = pathLength;
+    fileState->nameHash = HashBytes( file, pathLength );
+    fileState->lastWrite = 0;
+
+    u32 slotIndex = ( u32 ) fileState->nameHash & ( table->slotCount - 1 );
+    while ( table->slots[ slotIndex ].file )
+    {
+        slotIndex = ( slotIndex + 1 ) & ( table->slotCount - 1 );
+    }
+    table->slots[ slotIndex ].hash = fileState->nameHash;
+    table->slots[ slotIndex ].file = fileState;
+    table->states[ table->count++ ] = fileState;
+
+    fileState->arena = {};
+    fileState->structCount = 0;
+    fileState->functionCount = 0;
+
+    return fileState;
+}
+
+internal bool RemoveFile( Parse_State *state, File_State *file )
 {
     bool result = false;
-    WIN32_FIND_DATA fd = {};
-    char *pathToSearch = PushString( arena, 256 );
+    if ( !file->removed )
+    {
+        if ( GlobalLogParsing )
+        {
+            printf( "File removed %s\n", file->name );
+        }
+        file->removed = true;
+        file->generation = state->generation + 1;
+        state->fileCount -= 1;
+        state->removedPending = true;
+        result = true;
+    }
+    return result;
+}
 
-    sprintf_s( pathToSearch, 256, "%s\\*", startDirectory );
-    HANDLE handle = FindFirstFile( pathToSearch, &fd );
-    if ( handle != INVALID_HANDLE_VALUE )
+// NOTE: hands the chunks of removed files back to the pool, only call it once the work queue is
+// idle since a file can be removed while a worker is still parsing it
+internal void ReleaseRemovedFiles( Parse_State *state )
+{
+    if ( !state->removedPending )
+    {
+        return;
+    }
+
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
     {
-        do
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed && file->arena.current )
         {
-            if ( ( strncmp( ".", fd.cFileName, 1 ) != 0 ) && ( strncmp( "..", fd.cFileName, 2 ) != 0 ) )
+            file->structCount = 0;
+            file->functionCount = 0;
+            file->macroCount = 0;
+            file->declarations = {};
+            file->encodedDeclarations = 0;
+            file->encodedDeclarationsLength = 0;
+            ResetChunkedArena( &file->arena );
+        }
+    }
+    state->removedPending = false;
+}
+
+inline bool IsSourceFile( char *file )
+{
+    bool result = StringEndsWith( file, ".h" ) || StringEndsWith( file, ".cpp" );
+    return result;
+}
+
+// NOTE: runs on the main thread, creates the file state if needed and queues the file if it changed on disk
+internal void QueueFile( Parse_State *state, Memory_Arena *arena, char *file )
+{
+    if ( file[ strlen( file ) - 1 ] == '~' )
+    {
+        // printf( "Skipping backup file %s\n", fd.cFileName );
+        return;
+    }
+
+    File_State *fileState = FindFileState( state, file );
+
+    if ( fileState && fileState->removed )
+    {
+        // NOTE: file came back after being removed, force a reparse so it is reported as changed
+        state->fileCount += 1;
+        fileState->removed = false;
+        fileState->lastWrite = 0;
+        fileState->contentHash = 0;
+    }
+
+    if ( !fileState )
+    {
+        fileState = CreateFileState( state, arena, file );
+    }
+    fileState->lastSeenScan = state->scanIndex;
+
+    Platform_File_Info info;
+    u64 statStart = ReadTimer();
+    bool statResult = PlatformGetFileInfo( file, &info );
+    EndPhase( StatPhase_Stat, statStart );
+    if ( statResult )
+    {
+        if ( info.lastWrite == fileState->lastWrite )
+        {
+            return;
+        }
+        fileState->lastWrite = info.lastWrite;
+    }
+
+    fileState->parsed = false;
+    fileState->nextToParse = state->parseList;
+    state->parseList = fileState;
+    AddWorkQueueEntry( state->workQueue, ParseFileWork, fileState );
+}
+
+internal void ParseDirectory( Parse_State *state, Memory_Arena *arena, char *startDirectory )
+{
+    Platform_Directory directory = {};
+    if ( PlatformOpenDirectory( startDirectory, &directory ) )
+    {
+        Platform_Directory_Entry entry;
+        while ( PlatformNextDirectoryEntry( &directory, &entry ) )
+        {
+            // NOTE: hidden files and directories are skipped
+            if ( entry.name[ 0 ] != '.' )
             {
-                if ( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+                if ( entry.isDirectory )
                 {
-                    sprintf_s( pathToSearch, 256, "%s\\%s", startDirectory, fd.cFileName );
-                    bool wasParsed = ParseFiles( state, arena, pathToSearch );
-                    if ( wasParsed )
-                    {
-                        result = true;
-                    }
+                    char pathToSearch[ 256 ];
+                    sprintf_s( pathToSearch, sizeof( pathToSearch ), "%s%c%s", startDirectory, PLATFORM_PATH_SEPARATOR, entry.name );
+                    ParseDirectory( state, arena, pathToSearch );
                 }
-                else if ( StringEndsWith( fd.cFileName, ".h" ) || StringEndsWith( fd.cFileName, ".cpp" ) )
+                else if ( IsSourceFile( entry.name ) )
                 {
-                    char *fullFilePath = PushString( arena, 256 );
-                    sprintf_s( fullFilePath, 256, "%s\\%s", startDirectory, fd.cFileName );
-                    bool wasParsed = ParseFile( state, arena, fullFilePath );
-                    if ( wasParsed )
-                    {
-                        result = true;
-                    }
+                    char fullFilePath[ 256 ];
+                    sprintf_s( fullFilePath, sizeof( fullFilePath ), "%s%c%s", startDirectory, PLATFORM_PATH_SEPARATOR, entry.name );
+                    QueueFile( state, arena, fullFilePath );
                 }
             }
-        } while ( FindNextFile( handle, &fd ) );
+        }
 
-        FindClose( handle );
+        PlatformCloseDirectory( &directory );
     }
+}
+
+// NOTE: waits for the queued files and stamps the ones that parsed with the next generation
+internal bool PublishParsedFiles( Parse_State *state )
+{
+    CompleteAllWork( state->workQueue );
+
+    bool result = false;
+    for ( File_State *file = state->parseList; file; file = file->nextToParse )
+    {
+        if ( file->parsed )
+        {
+            file->generation = state->generation + 1;
+            result = true;
+        }
+    }
+    state->parseList = 0;
     return result;
 }
 
+internal bool ParseFiles( Parse_State *state, Memory_Arena *arena, char *startDirectory )
+{
+    // NOTE: discovery queues changed files while walking the tree, the workers parse them into
+    // their own file arenas and the results are published below once all the work is done
+    state->scanIndex += 1;
+    state->parseList = 0;
+    u64 scanStart = ReadTimer();
+    ParseDirectory( state, arena, startDirectory );
+    EndPhase( StatPhase_DirectoryScan, scanStart );
+    bool result = PublishParsedFiles( state );
+
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->lastSeenScan != state->scanIndex && RemoveFile( state, file ) )
+        {
+            result = true;
+        }
+    }
+
+    ReleaseRemovedFiles( state );
+    if ( result )
+    {
+        state->generation += 1;
+    }
+    return result;
+}
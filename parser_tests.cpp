@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "intrinsics.h"
+#if defined( _WIN32 )
+    #include "win32_platform.cpp"
+#else
+    #include "posix_platform.cpp"
+#endif
+
+#include "work_queue.cpp"
+#include "stats.cpp"
+#include "chunk_arena.cpp"
+#include "simd_scan.cpp"
+#include "string_intern.cpp"
+#include "parser.cpp"
+
+// NOTE: sources that used to hang or misparse a parse worker. Each one is written to a file in the
+// working directory, parsed eagerly and lazily, and the declarations are compared with expected,
+// written as one "name:type name,type name," line per declaration in table order.
+struct Parser_Test
+{
+    char *name;
+    char *source;
+    char *expected;
+};
+
+global_variable Parser_Test ParserTests[] =
+{
+    {
+        "nested_named_union",
+        "struct a { int t; union { int y; } u; };\nstruct b { int z; };\n",
+        "a:int t,int y,\nb:int z,\n",
+    },
+    {
+        "struct_cut_off",
+        "struct a { int x;",
+        "a:int x,\n",
+    },
+    {
+        "enum_cut_off",
+        "enum e { A, B",
+        "e:- A,- B,\n",
+    },
+    {
+        "arguments_cut_off",
+        "inline void f( int a,",
+        "f:int a,\n",
+    },
+    {
+        "initializer_braces",
+        "struct a { int x{ 1 }; int y; };\n",
+        "a:int{1} x,int y,\n",
+    },
+};
+
+internal void DumpDeclarations( File_State *file, char *buffer, u32 bufferSize )
+{
+    Declaration_Table *table = &file->declarations;
+    u32 length = 0;
+    buffer[ 0 ] = 0;
+    for ( u32 index = 0; index < table->count && length < bufferSize; ++index )
+    {
+        length += snprintf( buffer + length, bufferSize - length, "%s:", table->names[ index ] );
+        for ( u32 fieldIndex = 0; fieldIndex < table->fieldCounts[ index ] && length < bufferSize; ++fieldIndex )
+        {
+            u32 field = table->firstFields[ index ] + fieldIndex;
+            char *type = table->fieldTypes[ field ] ? table->fieldTypes[ field ] : ( char * ) "-";
+            length += snprintf( buffer + length, bufferSize - length, "%s %s,", type, table->fieldNames[ field ] );
+        }
+        if ( length < bufferSize )
+        {
+            length += snprintf( buffer + length, bufferSize - length, "\n" );
+        }
+    }
+}
+
+internal bool RunParserTest( Parser_Test *test, bool lazy )
+{
+    char path[ 256 ];
+    snprintf( path, sizeof( path ), "parser_test_%s.h", test->name );
+    if ( !PlatformWriteEntireFile( path, test->source, strlen( test->source ) ) )
+    {
+        printf( "%s: failed to write %s\n", test->name, path );
+        return false;
+    }
+
+    GlobalLazyDetails = lazy;
+    File_State file = {};
+    file.name = path;
+    bool parsed = ParseFile( &file ) && ParseFileDetails( &file );
+    PlatformDeleteFile( path );
+
+    char result[ 4096 ];
+    DumpDeclarations( &file, result, sizeof( result ) );
+    ResetChunkedArena( &file.arena );
+
+    bool passed = parsed && strcmp( result, test->expected ) == 0;
+    if ( !passed )
+    {
+        printf( "%s (%s) failed\nexpected:\n%sgot:\n%s", test->name, lazy ? "lazy" : "eager", test->expected, result );
+    }
+    return passed;
+}
+
+int main( int argc, char **argv )
+{
+    InitializeStats();
+    InitializeScanKernels();
+    GlobalLogParsing = false;
+
+    u32 failedCount = 0;
+    u32 testCount = ArrayCount( ParserTests );
+    for ( u32 testIndex = 0; testIndex < testCount; ++testIndex )
+    {
+        failedCount += !RunParserTest( ParserTests + testIndex, false );
+        failedCount += !RunParserTest( ParserTests + testIndex, true );
+    }
+
+    printf( "%u of %u parser tests passed\n", 2 * testCount - failedCount, 2 * testCount );
+    return failedCount ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+// NOTE: everything the server, the parser and the benchmark need from the OS. win32_platform.cpp and
+// posix_platform.cpp each define the handle types below and then implement these functions, main.cpp
+// and benchmark.cpp include the one for the target before anything else.
+//
+// Types every implementation provides:
+//   Mapped_File             read-only view of a whole file, starts with char *content; u32 size;
+//   Platform_Directory      an open directory listing
+//   Platform_Directory_Watch recursive change notifications for a directory
+//   Platform_Semaphore
+//   Platform_Process        a child process with its output piped back to us
+//   Platform_Socket         PLATFORM_INVALID_SOCKET when there is none
+//   Platform_Send_Buffer    one buffer of a gathered send, set with PlatformSetSendBuffer
+//   Platform_Socket_Set     the sockets the event loop waits on, each with what it waits for
+// and the macros PLATFORM_PATH_SEPARATOR, PLATFORM_MAX_WAIT_SOCKETS, PLATFORM_BUILD_COMMAND,
+// PLATFORM_THREAD_PROC( name ) and PLATFORM_ALLOCATION_HEADER, the bytes PlatformAllocateMemory keeps
+// in front of every block for itself.
+
+struct Platform_File_Info
+{
+    bool isDirectory;
+    // NOTE: only compared for equality, the unit differs between platforms
+    u64 lastWrite;
+    u64 size;
+};
+
+struct Platform_Directory_Entry
+{
+    char *name;
+    bool isDirectory;
+};
+
+// NOTE: path is absolute, contentOnly means the file was written to rather than created, removed
+// or renamed
+struct Platform_Watch_Event
+{
+    char path[ 256 ];
+    bool contentOnly;
+};
+
+enum Platform_Watch_Result
+{
+    WatchResult_Events,
+    // NOTE: changes were dropped, whatever was watched has to be scanned again
+    WatchResult_Overflow,
+    WatchResult_Failed,
+};
+
+enum Platform_Socket_Event_Flags : u32
+{
+    SocketEvent_Read = 0x1,
+    SocketEvent_Write = 0x2,
+};
+
+// NOTE: one ready socket, user is whatever it was added with
+struct Platform_Socket_Event
+{
+    void *user;
+    u32 events;
+};
+
+typedef PLATFORM_THREAD_PROC( platform_thread_proc );
+
+// NOTE: zeroed memory straight from the OS, aligned to at least 64 bytes. The OS maps
+// size + PLATFORM_ALLOCATION_HEADER rounded up to whole pages.
+internal void *PlatformAllocateMemory( memory_index size );
+internal void PlatformFreeMemory( void *memory );
+
+internal u64 PlatformReadTimer();
+internal u64 PlatformGetTimerFrequency();
+
+internal u32 PlatformGetProcessorCount();
+internal bool PlatformStartThread( platform_thread_proc *proc, void *parameter );
+internal void PlatformCreateSemaphore( Platform_Semaphore *semaphore, u32 maximumCount );
+internal void PlatformSignalSemaphore( Platform_Semaphore *semaphore );
+internal void PlatformWaitSemaphore( Platform_Semaphore *semaphore );
+// NOTE: lets another thread that is ready have the core
+internal void PlatformYieldThread();
+
+// NOTE: the error code of the last failed call, for log messages
+internal int PlatformGetLastError();
+internal void PlatformGetCurrentDirectory( char *buffer, u32 bufferSize );
+internal bool PlatformGetFileInfo( char *path, Platform_File_Info *info );
+// NOTE: empty files map to a null content
+internal bool MapEntireFile( char *path, Mapped_File *file );
+internal void UnmapFile( Mapped_File *file );
+internal bool PlatformWriteEntireFile( char *path, void *data, u64 size );
+// NOTE: atomically replaces destination with source
+internal bool PlatformReplaceFile( char *source, char *destination );
+internal bool PlatformDeleteFile( char *path );
+// NOTE: false if it already existed or couldn't be created
+internal bool PlatformCreateDirectory( char *path );
+
+// NOTE: the entries are never "." or "..", name is only valid until the next call
+internal bool PlatformOpenDirectory( char *path, Platform_Directory *directory );
+internal bool PlatformNextDirectoryEntry( Platform_Directory *directory, Platform_Directory_Entry *entry );
+internal void PlatformCloseDirectory( Platform_Directory *directory );
+
+internal bool PlatformStartDirectoryWatch( char *path, Platform_Directory_Watch *watch );
+// NOTE: blocks until something under the directory changes
+internal Platform_Watch_Result PlatformWaitForDirectoryChanges( Platform_Directory_Watch *watch, Platform_Watch_Event *events,
+                                                                u32 maxEventCount, u32 *eventCount );
+
+// NOTE: runs the command through the shell with stdout and stderr going into one pipe
+internal bool PlatformStartProcess( char *commandLine, Platform_Process *process );
+// NOTE: never blocks, returns the bytes read, 0 when nothing is available yet and -1 once the pipe
+// is closed because the process and everything it started have exited
+internal int PlatformReadProcessOutput( Platform_Process *process, void *buffer, u32 bufferSize );
+// NOTE: waits for the process, releases it and returns its exit code
+internal u32 PlatformFinishProcess( Platform_Process *process );
+
+internal bool PlatformInitializeSockets();
+internal void PlatformShutdownSockets();
+internal int PlatformGetSocketError();
+// NOTE: non-blocking listening socket on every interface, accepted sockets are non-blocking too
+internal Platform_Socket PlatformListen( char *port );
+internal Platform_Socket PlatformAccept( Platform_Socket listenSocket );
+internal Platform_Socket PlatformConnect( char *host, char *port );
+internal void PlatformCloseSocket( Platform_Socket socket );
+internal void PlatformShutdownSocket( Platform_Socket socket );
+// NOTE: returns what recv returns, 0 once the other side closed the connection
+internal int PlatformReceive( Platform_Socket socket, void *buffer, u32 bufferSize );
+// NOTE: only returns once everything went out or the connection failed
+internal bool PlatformSend( Platform_Socket socket, void *data, u32 size );
+// NOTE: for non-blocking sockets, sends whatever the socket takes right now and sets bytesSent to
+// that, anything from none of the buffers to all of them. False only if the connection failed.
+internal bool PlatformSendGathered( Platform_Socket socket, Platform_Send_Buffer *buffers, u32 bufferCount, u32 *bytesSent );
+
+// NOTE: sockets stay in the set until they are removed, which has to happen before they are closed.
+// events is a combination of SocketEvent_Read and SocketEvent_Write, at most PLATFORM_MAX_WAIT_SOCKETS
+// sockets can be in a set at once.
+internal bool PlatformCreateSocketSet( Platform_Socket_Set *set );
+internal void PlatformDestroySocketSet( Platform_Socket_Set *set );
+internal bool PlatformAddSocket( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events );
+internal bool PlatformChangeSocketEvents( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events );
+internal void PlatformRemoveSocket( Platform_Socket_Set *set, Platform_Socket socket );
+// NOTE: fills in up to maxEventCount ready sockets and returns how many, 0 on timeout and -1 if the
+// wait itself failed. A negative timeout waits until a socket is ready. A hung up or failed socket is
+// reported as readable and writable, the next recv or send tells what happened.
+internal int PlatformWaitForSocketEvents( Platform_Socket_Set *set, Platform_Socket_Event *events, u32 maxEventCount,
+                                          int timeoutMilliseconds );
@@ -0,0 +1,1029 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#if defined( __linux__ )
+    #include <sys/inotify.h>
+    #include <sys/epoll.h>
+#endif
+
+#define PLATFORM_PATH_SEPARATOR   '/'
+#define PLATFORM_MAX_WAIT_SOCKETS 1024
+#define PLATFORM_BUILD_COMMAND    "./build.sh"
+#define PLATFORM_INVALID_SOCKET   -1
+// NOTE: munmap needs the size, it goes in front of the block. 64 bytes keep the result cache line aligned.
+#define PLATFORM_ALLOCATION_HEADER 64
+#define PLATFORM_THREAD_PROC( name ) void *name( void *parameter )
+
+#if !defined( MSG_NOSIGNAL )
+    // NOTE: SIGPIPE is ignored anyway, see PlatformInitializeSockets
+    #define MSG_NOSIGNAL 0
+#endif
+
+// NOTE: the MSVC bounds checked string functions the rest of the code uses, truncating instead of
+// calling an invalid parameter handler
+#define sprintf_s snprintf
+
+inline int strcpy_s( char *destination, size_t destinationSize, const char *source )
+{
+    snprintf( destination, destinationSize, "%s", source );
+    return 0;
+}
+
+inline int strncpy_s( char *destination, size_t destinationSize, const char *source, size_t count )
+{
+    size_t length = count < destinationSize - 1 ? count : destinationSize - 1;
+    memcpy( destination, source, length );
+    destination[ length ] = '\0';
+    return 0;
+}
+
+inline int fopen_s( FILE **file, const char *path, const char *mode )
+{
+    *file = fopen( path, mode );
+    return *file ? 0 : errno;
+}
+
+struct Mapped_File
+{
+    char *content;
+    u32 size;
+};
+
+struct Platform_Directory
+{
+    DIR *handle;
+    char path[ 256 ];
+};
+
+// NOTE: inotify descriptors start at 1, 0 marks an empty slot
+struct Posix_Watch_Slot
+{
+    int descriptor;
+    char path[ 256 ];
+};
+
+struct Platform_Directory_Watch
+{
+    int inotifyHandle;
+    // NOTE: inotify only watches single directories, this maps each watch descriptor back to its
+    // path. Descriptors keep counting up as directories come and go, so it's an open addressing
+    // table of the live ones and an entry goes once IN_IGNORED says its watch is gone.
+    u32 watchCount;
+    u32 slotCount;
+    Posix_Watch_Slot *slots;
+};
+
+struct Platform_Semaphore
+{
+    sem_t handle;
+};
+
+struct Platform_Process
+{
+    pid_t pid;
+    int outputPipe;
+};
+
+typedef int Platform_Socket;
+typedef iovec Platform_Send_Buffer;
+
+inline void PlatformSetSendBuffer( Platform_Send_Buffer *buffer, void *data, u32 size )
+{
+    buffer->iov_base = data;
+    buffer->iov_len = size;
+}
+
+#if defined( __linux__ )
+// NOTE: the kernel keeps the set, a wait only costs as much as the sockets that are ready
+struct Platform_Socket_Set
+{
+    int epollHandle;
+};
+#else
+// NOTE: poll wherever there is no epoll, the whole set is handed over on every wait
+struct Platform_Socket_Set
+{
+    u32 count;
+    pollfd sockets[ PLATFORM_MAX_WAIT_SOCKETS ];
+    void *users[ PLATFORM_MAX_WAIT_SOCKETS ];
+};
+#endif
+
+#include "platform.h"
+
+internal void *PlatformAllocateMemory( memory_index size )
+{
+    memory_index totalSize = size + PLATFORM_ALLOCATION_HEADER;
+    void *base = mmap( 0, totalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( base == MAP_FAILED )
+    {
+        return 0;
+    }
+
+    *( memory_index * ) base = totalSize;
+    return ( u8 * ) base + PLATFORM_ALLOCATION_HEADER;
+}
+
+internal void PlatformFreeMemory( void *memory )
+{
+    if ( memory )
+    {
+        u8 *base = ( u8 * ) memory - PLATFORM_ALLOCATION_HEADER;
+        munmap( base, *( memory_index * ) base );
+    }
+}
+
+internal u64 PlatformReadTimer()
+{
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( u64 ) now.tv_sec * 1000000000ull + ( u64 ) now.tv_nsec;
+}
+
+internal u64 PlatformGetTimerFrequency()
+{
+    return 1000000000ull;
+}
+
+internal u32 PlatformGetProcessorCount()
+{
+    long count = sysconf( _SC_NPROCESSORS_ONLN );
+    return count > 0 ? ( u32 ) count : 1;
+}
+
+internal bool PlatformStartThread( platform_thread_proc *proc, void *parameter )
+{
+    pthread_attr_t attributes;
+    pthread_attr_init( &attributes );
+    pthread_attr_setdetachstate( &attributes, PTHREAD_CREATE_DETACHED );
+    pthread_t thread;
+    bool result = pthread_create( &thread, &attributes, proc, parameter ) == 0;
+    pthread_attr_destroy( &attributes );
+    return result;
+}
+
+// NOTE: POSIX semaphores have no maximum, extra signals only cost the workers an empty pass over the queue
+internal void PlatformCreateSemaphore( Platform_Semaphore *semaphore, u32 maximumCount )
+{
+    sem_init( &semaphore->handle, 0, 0 );
+}
+
+internal void PlatformSignalSemaphore( Platform_Semaphore *semaphore )
+{
+    sem_post( &semaphore->handle );
+}
+
+internal void PlatformWaitSemaphore( Platform_Semaphore *semaphore )
+{
+    while ( sem_wait( &semaphore->handle ) != 0 && errno == EINTR )
+    {
+    }
+}
+
+internal void PlatformYieldThread()
+{
+    sched_yield();
+}
+
+internal int PlatformGetLastError()
+{
+    return errno;
+}
+
+internal void PlatformGetCurrentDirectory( char *buffer, u32 bufferSize )
+{
+    if ( !getcwd( buffer, bufferSize ) )
+    {
+        buffer[ 0 ] = '\0';
+    }
+}
+
+inline void SetCloseOnExec( int handle )
+{
+    // NOTE: otherwise every build we start inherits our sockets and pipes
+    fcntl( handle, F_SETFD, FD_CLOEXEC );
+}
+
+internal bool PlatformGetFileInfo( char *path, Platform_File_Info *info )
+{
+    struct stat status;
+    if ( stat( path, &status ) != 0 )
+    {
+        return false;
+    }
+
+    info->isDirectory = S_ISDIR( status.st_mode );
+#if defined( __APPLE__ )
+    info->lastWrite = ( u64 ) status.st_mtimespec.tv_sec * 1000000000ull + ( u64 ) status.st_mtimespec.tv_nsec;
+#else
+    info->lastWrite = ( u64 ) status.st_mtim.tv_sec * 1000000000ull + ( u64 ) status.st_mtim.tv_nsec;
+#endif
+    info->size = ( u64 ) status.st_size;
+    return true;
+}
+
+internal bool MapEntireFile( char *path, Mapped_File *file )
+{
+    *file = {};
+    int handle = open( path, O_RDONLY | O_CLOEXEC );
+    if ( handle < 0 )
+    {
+        return false;
+    }
+
+    struct stat status;
+    bool result = fstat( handle, &status ) == 0 && S_ISREG( status.st_mode );
+    if ( result && status.st_size > 0 )
+    {
+        file->size = SafeTruncateU64( ( u64 ) status.st_size );
+        void *content = mmap( 0, file->size, PROT_READ, MAP_PRIVATE, handle, 0 );
+        if ( content == MAP_FAILED )
+        {
+            *file = {};
+            result = false;
+        }
+        else
+        {
+            file->content = ( char * ) content;
+        }
+    }
+
+    // NOTE: the mapping keeps the file alive on its own
+    close( handle );
+    return result;
+}
+
+internal void UnmapFile( Mapped_File *file )
+{
+    if ( file->content )
+    {
+        munmap( file->content, file->size );
+    }
+    *file = {};
+}
+
+internal bool PlatformWriteEntireFile( char *path, void *data, u64 size )
+{
+    int handle = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if ( handle < 0 )
+    {
+        return false;
+    }
+
+    u64 written = 0;
+    while ( written < size )
+    {
+        ssize_t result = write( handle, ( u8 * ) data + written, size - written );
+        if ( result < 0 && errno == EINTR )
+        {
+            continue;
+        }
+        if ( result <= 0 )
+        {
+            break;
+        }
+        written += ( u64 ) result;
+    }
+
+    bool result = close( handle ) == 0 && written == size;
+    return result;
+}
+
+internal bool PlatformReplaceFile( char *source, char *destination )
+{
+    return rename( source, destination ) == 0;
+}
+
+internal bool PlatformDeleteFile( char *path )
+{
+    return unlink( path ) == 0;
+}
+
+internal bool PlatformCreateDirectory( char *path )
+{
+    return mkdir( path, 0755 ) == 0;
+}
+
+internal bool PlatformOpenDirectory( char *path, Platform_Directory *directory )
+{
+    strcpy_s( directory->path, sizeof( directory->path ), path );
+    directory->handle = opendir( path );
+    return directory->handle != 0;
+}
+
+internal bool PlatformNextDirectoryEntry( Platform_Directory *directory, Platform_Directory_Entry *entry )
+{
+    while ( dirent *found = readdir( directory->handle ) )
+    {
+        if ( strcmp( found->d_name, "." ) == 0 || strcmp( found->d_name, ".." ) == 0 )
+        {
+            continue;
+        }
+
+        entry->name = found->d_name;
+        if ( found->d_type == DT_DIR || found->d_type == DT_REG )
+        {
+            entry->isDirectory = found->d_type == DT_DIR;
+            return true;
+        }
+
+        // NOTE: links to files count as files, links to directories are not followed since one
+        // pointing back up the tree would have us recurse forever
+        char path[ 512 ];
+        snprintf( path, sizeof( path ), "%s/%s", directory->path, found->d_name );
+        struct stat status;
+        if ( found->d_type == DT_UNKNOWN && lstat( path, &status ) == 0 && S_ISDIR( status.st_mode ) )
+        {
+            entry->isDirectory = true;
+            return true;
+        }
+        if ( stat( path, &status ) == 0 && S_ISREG( status.st_mode ) )
+        {
+            entry->isDirectory = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+internal void PlatformCloseDirectory( Platform_Directory *directory )
+{
+    if ( directory->handle )
+    {
+        closedir( directory->handle );
+    }
+    *directory = {};
+}
+
+#if defined( __linux__ )
+
+#define POSIX_WATCH_MASK          ( IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO )
+#define POSIX_WATCH_INITIAL_SLOTS 64
+
+// NOTE: the slot holding descriptor, or the empty one it would go in. Descriptors are small and
+// mostly consecutive, their low bits spread them fine.
+internal Posix_Watch_Slot *FindWatchSlot( Platform_Directory_Watch *watch, int descriptor )
+{
+    u32 slotIndex = ( u32 ) descriptor & ( watch->slotCount - 1 );
+    while ( watch->slots[ slotIndex ].descriptor && watch->slots[ slotIndex ].descriptor != descriptor )
+    {
+        slotIndex = ( slotIndex + 1 ) & ( watch->slotCount - 1 );
+    }
+    return watch->slots + slotIndex;
+}
+
+internal bool GrowWatchSlots( Platform_Directory_Watch *watch )
+{
+    u32 oldSlotCount = watch->slotCount;
+    Posix_Watch_Slot *oldSlots = watch->slots;
+
+    u32 newSlotCount = oldSlotCount ? oldSlotCount * 2 : POSIX_WATCH_INITIAL_SLOTS;
+    Posix_Watch_Slot *newSlots = ( Posix_Watch_Slot * ) PlatformAllocateMemory( newSlotCount * sizeof( Posix_Watch_Slot ) );
+    if ( !newSlots )
+    {
+        return false;
+    }
+
+    watch->slots = newSlots;
+    watch->slotCount = newSlotCount;
+    for ( u32 slotIndex = 0; slotIndex < oldSlotCount; ++slotIndex )
+    {
+        if ( oldSlots[ slotIndex ].descriptor )
+        {
+            *FindWatchSlot( watch, oldSlots[ slotIndex ].descriptor ) = oldSlots[ slotIndex ];
+        }
+    }
+    if ( oldSlots )
+    {
+        PlatformFreeMemory( oldSlots );
+    }
+    return true;
+}
+
+// NOTE: shifts the entries after the hole back into it where their home slot allows, so lookups
+// never need tombstones
+internal void RemoveWatchSlot( Platform_Directory_Watch *watch, int descriptor )
+{
+    if ( !watch->slotCount )
+    {
+        return;
+    }
+
+    Posix_Watch_Slot *slot = FindWatchSlot( watch, descriptor );
+    if ( !slot->descriptor )
+    {
+        return;
+    }
+
+    u32 mask = watch->slotCount - 1;
+    u32 emptyIndex = ( u32 ) ( slot - watch->slots );
+    slot->descriptor = 0;
+    watch->watchCount -= 1;
+    for ( u32 slotIndex = ( emptyIndex + 1 ) & mask; watch->slots[ slotIndex ].descriptor; slotIndex = ( slotIndex + 1 ) & mask )
+    {
+        u32 homeIndex = ( u32 ) watch->slots[ slotIndex ].descriptor & mask;
+        if ( ( ( slotIndex - homeIndex ) & mask ) >= ( ( slotIndex - emptyIndex ) & mask ) )
+        {
+            watch->slots[ emptyIndex ] = watch->slots[ slotIndex ];
+            watch->slots[ slotIndex ].descriptor = 0;
+            emptyIndex = slotIndex;
+        }
+    }
+}
+
+// NOTE: a directory that moved keeps its watches, but they would report the old paths. They are
+// dropped for it and everything under it, IN_IGNORED then frees the slots and the new place gets
+// fresh ones if it is in the tree.
+internal void RemoveWatchesUnder( Platform_Directory_Watch *watch, char *path )
+{
+    u32 pathLength = ( u32 ) strlen( path );
+    for ( u32 slotIndex = 0; slotIndex < watch->slotCount; ++slotIndex )
+    {
+        Posix_Watch_Slot *slot = watch->slots + slotIndex;
+        if ( slot->descriptor && strncmp( slot->path, path, pathLength ) == 0 &&
+             ( slot->path[ pathLength ] == '\0' || slot->path[ pathLength ] == '/' ) )
+        {
+            inotify_rm_watch( watch->inotifyHandle, slot->descriptor );
+        }
+    }
+}
+
+// NOTE: hidden directories are skipped like ParseDirectory skips them, that keeps .git from eating
+// into the per user watch limit. So are directories whose path doesn't fit in 256 bytes, the
+// events couldn't name anything in them.
+internal bool AddDirectoryWatches( Platform_Directory_Watch *watch, char *path )
+{
+    if ( ( watch->watchCount + 1 ) * 4 > watch->slotCount * 3 && !GrowWatchSlots( watch ) )
+    {
+        return false;
+    }
+
+    int descriptor = inotify_add_watch( watch->inotifyHandle, path, POSIX_WATCH_MASK | IN_ONLYDIR );
+    if ( descriptor < 0 )
+    {
+        printf( "Failed to watch %s: %d\n", path, errno );
+        return false;
+    }
+
+    // NOTE: a directory that is already watched gets its old descriptor back
+    Posix_Watch_Slot *slot = FindWatchSlot( watch, descriptor );
+    if ( !slot->descriptor )
+    {
+        slot->descriptor = descriptor;
+        watch->watchCount += 1;
+    }
+    strcpy_s( slot->path, sizeof( slot->path ), path );
+
+    bool result = true;
+    Platform_Directory directory = {};
+    if ( PlatformOpenDirectory( path, &directory ) )
+    {
+        Platform_Directory_Entry entry;
+        while ( result && PlatformNextDirectoryEntry( &directory, &entry ) )
+        {
+            if ( entry.isDirectory && entry.name[ 0 ] != '.' )
+            {
+                char childPath[ 256 ];
+                if ( snprintf( childPath, sizeof( childPath ), "%s/%s", path, entry.name ) < ( int ) sizeof( childPath ) )
+                {
+                    result = AddDirectoryWatches( watch, childPath );
+                }
+                else
+                {
+                    printf( "Not watching %s/%s, the path is too long\n", path, entry.name );
+                }
+            }
+        }
+        PlatformCloseDirectory( &directory );
+    }
+    return result;
+}
+
+internal bool PlatformStartDirectoryWatch( char *path, Platform_Directory_Watch *watch )
+{
+    watch->inotifyHandle = inotify_init1( IN_CLOEXEC );
+    if ( watch->inotifyHandle < 0 )
+    {
+        return false;
+    }
+
+    if ( strlen( path ) >= sizeof( watch->slots[ 0 ].path ) || !AddDirectoryWatches( watch, path ) )
+    {
+        close( watch->inotifyHandle );
+        watch->inotifyHandle = -1;
+        return false;
+    }
+    return true;
+}
+
+internal Platform_Watch_Result PlatformWaitForDirectoryChanges( Platform_Directory_Watch *watch, Platform_Watch_Event *events,
+                                                                u32 maxEventCount, u32 *eventCount )
+{
+    alignas( inotify_event ) local_persist u8 notifyBuffer[ Kilobytes( 64 ) ];
+    *eventCount = 0;
+
+    ssize_t bytesRead = read( watch->inotifyHandle, notifyBuffer, sizeof( notifyBuffer ) );
+    if ( bytesRead < 0 && errno == EINTR )
+    {
+        return WatchResult_Events;
+    }
+    if ( bytesRead <= 0 )
+    {
+        return WatchResult_Failed;
+    }
+
+    Platform_Watch_Result result = WatchResult_Events;
+    for ( u8 *at = notifyBuffer; at < notifyBuffer + bytesRead; )
+    {
+        inotify_event *info = ( inotify_event * ) at;
+        at += sizeof( inotify_event ) + info->len;
+
+        if ( info->mask & IN_Q_OVERFLOW )
+        {
+            return WatchResult_Overflow;
+        }
+
+        // NOTE: IN_IGNORED comes once a watch is gone, because its directory was deleted or moved
+        // away. Its parent reports the change itself.
+        if ( info->mask & IN_IGNORED )
+        {
+            RemoveWatchSlot( watch, info->wd );
+            continue;
+        }
+
+        // NOTE: other events about a watched directory itself come without a name
+        Posix_Watch_Slot *slot = watch->slotCount ? FindWatchSlot( watch, info->wd ) : 0;
+        if ( info->len == 0 || info->name[ 0 ] == '\0' || !slot || !slot->descriptor )
+        {
+            continue;
+        }
+
+        if ( *eventCount == maxEventCount )
+        {
+            return WatchResult_Overflow;
+        }
+
+        // NOTE: a name that doesn't fit in 256 bytes is left out, a scan can't name it either
+        Platform_Watch_Event *event = events + *eventCount;
+        if ( snprintf( event->path, sizeof( event->path ), "%s/%s", slot->path, info->name ) >= ( int ) sizeof( event->path ) )
+        {
+            continue;
+        }
+        *eventCount += 1;
+        event->contentOnly = ( info->mask & IN_MODIFY ) != 0;
+
+        if ( ( info->mask & IN_ISDIR ) && ( info->mask & IN_MOVED_FROM ) )
+        {
+            RemoveWatchesUnder( watch, event->path );
+        }
+
+        // NOTE: a new directory needs its own watches. Anything created in it before they were added
+        // is still found, the event for the directory makes the watcher scan all of it.
+        if ( ( info->mask & IN_ISDIR ) && ( info->mask & ( IN_CREATE | IN_MOVED_TO ) ) && info->name[ 0 ] != '.' &&
+             !AddDirectoryWatches( watch, event->path ) )
+        {
+            result = WatchResult_Overflow;
+        }
+    }
+
+    return result;
+}
+
+#else
+
+// NOTE: no change notifications outside of Linux yet, the watcher falls back to full scans
+internal bool PlatformStartDirectoryWatch( char *path, Platform_Directory_Watch *watch )
+{
+    return false;
+}
+
+internal Platform_Watch_Result PlatformWaitForDirectoryChanges( Platform_Directory_Watch *watch, Platform_Watch_Event *events,
+                                                                u32 maxEventCount, u32 *eventCount )
+{
+    *eventCount = 0;
+    return WatchResult_Failed;
+}
+
+#endif
+
+internal bool PlatformStartProcess( char *commandLine, Platform_Process *process )
+{
+    int pipeHandles[ 2 ];
+    if ( pipe( pipeHandles ) != 0 )
+    {
+        printf( "pipe failed: %d\n", errno );
+        return false;
+    }
+
+    pid_t pid = fork();
+    if ( pid == 0 )
+    {
+        // NOTE: only async-signal-safe calls from here on, the parent has other threads running
+        int nullHandle = open( "/dev/null", O_RDONLY );
+        dup2( nullHandle, STDIN_FILENO );
+        dup2( pipeHandles[ 1 ], STDOUT_FILENO );
+        dup2( pipeHandles[ 1 ], STDERR_FILENO );
+        close( pipeHandles[ 0 ] );
+        close( pipeHandles[ 1 ] );
+        execl( "/bin/sh", "sh", "-c", commandLine, ( char * ) 0 );
+        _exit( 127 );
+    }
+
+    // NOTE: only the child may hold the write end, otherwise the pipe never breaks
+    close( pipeHandles[ 1 ] );
+    if ( pid < 0 )
+    {
+        printf( "fork failed: %d\n", errno );
+        close( pipeHandles[ 0 ] );
+        return false;
+    }
+
+    SetCloseOnExec( pipeHandles[ 0 ] );
+    fcntl( pipeHandles[ 0 ], F_SETFL, fcntl( pipeHandles[ 0 ], F_GETFL ) | O_NONBLOCK );
+    process->pid = pid;
+    process->outputPipe = pipeHandles[ 0 ];
+    return true;
+}
+
+internal int PlatformReadProcessOutput( Platform_Process *process, void *buffer, u32 bufferSize )
+{
+    ssize_t bytesRead = read( process->outputPipe, buffer, bufferSize );
+    if ( bytesRead < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) )
+    {
+        return 0;
+    }
+    if ( bytesRead <= 0 )
+    {
+        // NOTE: end of file once the process and everything it started have exited
+        return -1;
+    }
+    return ( int ) bytesRead;
+}
+
+internal u32 PlatformFinishProcess( Platform_Process *process )
+{
+    int status = 0;
+    while ( waitpid( process->pid, &status, 0 ) < 0 && errno == EINTR )
+    {
+    }
+    close( process->outputPipe );
+    *process = {};
+
+    u32 result = WIFEXITED( status ) ? ( u32 ) WEXITSTATUS( status ) : 128 + ( u32 ) WTERMSIG( status );
+    return result;
+}
+
+internal bool PlatformInitializeSockets()
+{
+    // NOTE: a client going away in the middle of a send must fail the send, not kill the server
+    signal( SIGPIPE, SIG_IGN );
+    return true;
+}
+
+internal void PlatformShutdownSockets()
+{
+}
+
+internal int PlatformGetSocketError()
+{
+    return errno;
+}
+
+internal Platform_Socket PlatformListen( char *port )
+{
+    addrinfo *info;
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+
+    int result = getaddrinfo( 0, port, &hints, &info );
+    if ( result != 0 )
+    {
+        printf( "getaddrinfo failed %d\n", result );
+        return -1;
+    }
+
+    int listenSocket = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+    if ( listenSocket < 0 )
+    {
+        printf( "Socket creation failed: %d\n", errno );
+        freeaddrinfo( info );
+        return -1;
+    }
+    SetCloseOnExec( listenSocket );
+
+    // NOTE: lets a restarted server bind while connections of the last one are still in TIME_WAIT
+    int reuse = 1;
+    setsockopt( listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse ) );
+
+    result = bind( listenSocket, info->ai_addr, info->ai_addrlen );
+    freeaddrinfo( info );
+    if ( result != 0 )
+    {
+        printf( "bind failed: %d\n", errno );
+        close( listenSocket );
+        return -1;
+    }
+
+    if ( listen( listenSocket, SOMAXCONN ) != 0 )
+    {
+        printf( "Listen failed: %d\n", errno );
+        close( listenSocket );
+        return -1;
+    }
+
+    fcntl( listenSocket, F_SETFL, fcntl( listenSocket, F_GETFL ) | O_NONBLOCK );
+    return listenSocket;
+}
+
+internal Platform_Socket PlatformAccept( Platform_Socket listenSocket )
+{
+    int result = accept( listenSocket, 0, 0 );
+    if ( result >= 0 )
+    {
+        // NOTE: whether accepted sockets inherit O_NONBLOCK differs between systems
+        SetCloseOnExec( result );
+        fcntl( result, F_SETFL, fcntl( result, F_GETFL ) | O_NONBLOCK );
+    }
+    return result;
+}
+
+internal Platform_Socket PlatformConnect( char *host, char *port )
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo *info = 0;
+    int result = -1;
+    if ( getaddrinfo( host, port, &hints, &info ) == 0 )
+    {
+        result = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+        if ( result >= 0 && connect( result, info->ai_addr, info->ai_addrlen ) != 0 )
+        {
+            close( result );
+            result = -1;
+        }
+        freeaddrinfo( info );
+    }
+    return result;
+}
+
+internal void PlatformCloseSocket( Platform_Socket socket )
+{
+    close( socket );
+}
+
+internal void PlatformShutdownSocket( Platform_Socket socket )
+{
+    shutdown( socket, SHUT_WR );
+}
+
+internal int PlatformReceive( Platform_Socket socket, void *buffer, u32 bufferSize )
+{
+    ssize_t result;
+    do
+    {
+        result = recv( socket, buffer, bufferSize, 0 );
+    } while ( result < 0 && errno == EINTR );
+    return ( int ) result;
+}
+
+internal bool PlatformSend( Platform_Socket socket, void *data, u32 size )
+{
+    u32 sent = 0;
+    while ( sent < size )
+    {
+        ssize_t result = send( socket, ( u8 * ) data + sent, size - sent, MSG_NOSIGNAL );
+        if ( result < 0 && errno == EINTR )
+        {
+            continue;
+        }
+        if ( result < 0 )
+        {
+            return false;
+        }
+        sent += ( u32 ) result;
+    }
+    return true;
+}
+
+internal bool PlatformSendGathered( Platform_Socket socket, Platform_Send_Buffer *buffers, u32 bufferCount, u32 *bytesSent )
+{
+    msghdr message = {};
+    message.msg_iov = buffers;
+    message.msg_iovlen = bufferCount;
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg( socket, &message, MSG_NOSIGNAL );
+    } while ( sent < 0 && errno == EINTR );
+
+    *bytesSent = sent > 0 ? ( u32 ) sent : 0;
+    return sent >= 0 || errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+#if defined( __linux__ )
+inline u32 GetEpollEvents( u32 events )
+{
+    u32 result = 0;
+    if ( events & SocketEvent_Read )
+    {
+        result |= EPOLLIN;
+    }
+    if ( events & SocketEvent_Write )
+    {
+        result |= EPOLLOUT;
+    }
+    return result;
+}
+
+internal bool PlatformCreateSocketSet( Platform_Socket_Set *set )
+{
+    set->epollHandle = epoll_create1( EPOLL_CLOEXEC );
+    return set->epollHandle >= 0;
+}
+
+internal void PlatformDestroySocketSet( Platform_Socket_Set *set )
+{
+    close( set->epollHandle );
+    set->epollHandle = -1;
+}
+
+internal bool PlatformAddSocket( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events )
+{
+    epoll_event event = {};
+    event.events = GetEpollEvents( events );
+    event.data.ptr = user;
+    return epoll_ctl( set->epollHandle, EPOLL_CTL_ADD, socket, &event ) == 0;
+}
+
+internal bool PlatformChangeSocketEvents( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events )
+{
+    epoll_event event = {};
+    event.events = GetEpollEvents( events );
+    event.data.ptr = user;
+    return epoll_ctl( set->epollHandle, EPOLL_CTL_MOD, socket, &event ) == 0;
+}
+
+internal void PlatformRemoveSocket( Platform_Socket_Set *set, Platform_Socket socket )
+{
+    // NOTE: kernels before 2.6.9 want an event even though it is ignored
+    epoll_event event = {};
+    epoll_ctl( set->epollHandle, EPOLL_CTL_DEL, socket, &event );
+}
+
+internal int PlatformWaitForSocketEvents( Platform_Socket_Set *set, Platform_Socket_Event *events, u32 maxEventCount,
+                                          int timeoutMilliseconds )
+{
+    epoll_event readyEvents[ 64 ];
+    int maxReady = maxEventCount < ArrayCount( readyEvents ) ? ( int ) maxEventCount : ( int ) ArrayCount( readyEvents );
+    int readyCount = epoll_wait( set->epollHandle, readyEvents, maxReady, timeoutMilliseconds );
+    if ( readyCount < 0 )
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    // NOTE: a hung up or failed socket gets EPOLLHUP or EPOLLERR whether it asked for them or not
+    for ( int readyIndex = 0; readyIndex < readyCount; ++readyIndex )
+    {
+        u32 ready = readyEvents[ readyIndex ].events;
+        bool failed = ( ready & ( EPOLLHUP | EPOLLERR ) ) != 0;
+        events[ readyIndex ].user = readyEvents[ readyIndex ].data.ptr;
+        events[ readyIndex ].events = 0;
+        if ( failed || ( ready & EPOLLIN ) )
+        {
+            events[ readyIndex ].events |= SocketEvent_Read;
+        }
+        if ( failed || ( ready & EPOLLOUT ) )
+        {
+            events[ readyIndex ].events |= SocketEvent_Write;
+        }
+    }
+    return readyCount;
+}
+#else
+inline short GetPollEvents( u32 events )
+{
+    short result = 0;
+    if ( events & SocketEvent_Read )
+    {
+        result |= POLLIN;
+    }
+    if ( events & SocketEvent_Write )
+    {
+        result |= POLLOUT;
+    }
+    return result;
+}
+
+inline u32 FindPollSocket( Platform_Socket_Set *set, Platform_Socket socket )
+{
+    u32 result = 0;
+    while ( result < set->count && set->sockets[ result ].fd != socket )
+    {
+        ++result;
+    }
+    return result;
+}
+
+internal bool PlatformCreateSocketSet( Platform_Socket_Set *set )
+{
+    set->count = 0;
+    return true;
+}
+
+internal void PlatformDestroySocketSet( Platform_Socket_Set *set )
+{
+    set->count = 0;
+}
+
+internal bool PlatformAddSocket( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events )
+{
+    if ( set->count == PLATFORM_MAX_WAIT_SOCKETS )
+    {
+        return false;
+    }
+    pollfd *pollSocket = set->sockets + set->count;
+    pollSocket->fd = socket;
+    pollSocket->events = GetPollEvents( events );
+    pollSocket->revents = 0;
+    set->users[ set->count++ ] = user;
+    return true;
+}
+
+internal bool PlatformChangeSocketEvents( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events )
+{
+    u32 socketIndex = FindPollSocket( set, socket );
+    if ( socketIndex == set->count )
+    {
+        return false;
+    }
+    set->sockets[ socketIndex ].events = GetPollEvents( events );
+    set->users[ socketIndex ] = user;
+    return true;
+}
+
+internal void PlatformRemoveSocket( Platform_Socket_Set *set, Platform_Socket socket )
+{
+    u32 socketIndex = FindPollSocket( set, socket );
+    if ( socketIndex < set->count )
+    {
+        set->count -= 1;
+        set->sockets[ socketIndex ] = set->sockets[ set->count ];
+        set->users[ socketIndex ] = set->users[ set->count ];
+    }
+}
+
+internal int PlatformWaitForSocketEvents( Platform_Socket_Set *set, Platform_Socket_Event *events, u32 maxEventCount,
+                                          int timeoutMilliseconds )
+{
+    int result = poll( set->sockets, set->count, timeoutMilliseconds );
+    if ( result < 0 )
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    u32 eventCount = 0;
+    for ( u32 socketIndex = 0; socketIndex < set->count && eventCount < maxEventCount; ++socketIndex )
+    {
+        short ready = set->sockets[ socketIndex ].revents;
+        bool failed = ( ready & ( POLLHUP | POLLERR ) ) != 0;
+        u32 readyEvents = 0;
+        if ( failed || ( ready & POLLIN ) )
+        {
+            readyEvents |= SocketEvent_Read;
+        }
+        if ( failed || ( ready & POLLOUT ) )
+        {
+            readyEvents |= SocketEvent_Write;
+        }
+        if ( readyEvents )
+        {
+            events[ eventCount ].user = set->users[ socketIndex ];
+            events[ eventCount ].events = readyEvents;
+            eventCount += 1;
+        }
+    }
+    return ( int ) eventCount;
+}
+#endif
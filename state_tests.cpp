@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "intrinsics.h"
+#if defined( _WIN32 )
+    #include "win32_platform.cpp"
+#else
+    #include "posix_platform.cpp"
+#endif
+
+#include "work_queue.cpp"
+#include "stats.cpp"
+#include "chunk_arena.cpp"
+#include "simd_scan.cpp"
+#include "string_intern.cpp"
+#include "parser.cpp"
+#include "msgpack.cpp"
+#include "declaration_encoder.cpp"
+#include "index_file.cpp"
+
+// NOTE: the parse state the server keeps between requests, checked without a server or a tree on
+// disk: the file table's lookups across growth and removal, which files a GetDeclarations delta
+// reports for a given epoch and generation, and the declaration index. The index tests write a
+// few sources and the index next to the test executable and delete them again.
+global_variable u32 GlobalCheckCount;
+global_variable u32 GlobalFailedCount;
+
+#define Check( expression ) CheckResult( expression, #expression, __LINE__ )
+
+internal void CheckResult( bool passed, char *expression, u32 line )
+{
+    GlobalCheckCount += 1;
+    if ( !passed )
+    {
+        GlobalFailedCount += 1;
+        printf( "state_tests.cpp(%u): failed %s\n", line, expression );
+    }
+}
+
+#define STATE_TEST_FILES 3000
+
+inline void TestFileName( char *buffer, u32 bufferSize, u32 fileIndex )
+{
+    snprintf( buffer, bufferSize, "dir%u/file%u.h", fileIndex % 7, fileIndex );
+}
+
+// NOTE: enough files to grow the table from its first 1024 slots twice, with every lookup checked
+// after each growth, removed files staying findable as tombstones, and a path whose hash matches
+// another file's but whose name doesn't
+internal void TestFileTable( Memory_Arena *arena )
+{
+    Parse_State state = {};
+    char name[ 64 ];
+
+    bool allFound = true;
+    u32 slotCounts[ 3 ] = {};
+    u32 growCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < STATE_TEST_FILES; ++fileIndex )
+    {
+        u32 slotCount = state.files.slotCount;
+        TestFileName( name, sizeof( name ), fileIndex );
+        File_State *file = CreateFileState( &state, arena, name );
+        if ( state.files.slotCount != slotCount && growCount < ArrayCount( slotCounts ) )
+        {
+            slotCounts[ growCount++ ] = state.files.slotCount;
+
+            // NOTE: everything inserted before the growth has to be rehashed into the new slots
+            for ( u32 foundIndex = 0; foundIndex <= fileIndex; ++foundIndex )
+            {
+                TestFileName( name, sizeof( name ), foundIndex );
+                allFound = allFound && FindFileState( &state, name ) == state.files.states[ foundIndex ];
+            }
+        }
+        allFound = allFound && file && file == state.files.states[ fileIndex ];
+    }
+    Check( allFound );
+    Check( growCount == 3 );
+    Check( slotCounts[ 0 ] == FILE_TABLE_INITIAL_SLOTS && slotCounts[ 1 ] == 2 * FILE_TABLE_INITIAL_SLOTS &&
+           slotCounts[ 2 ] == 4 * FILE_TABLE_INITIAL_SLOTS );
+    Check( state.files.count == STATE_TEST_FILES && state.fileCount == STATE_TEST_FILES );
+    Check( state.files.count <= state.files.capacity && state.files.capacity < state.files.slotCount );
+
+    Check( !FindFileState( &state, "dir0/file3000.h" ) );
+    Check( !FindFileState( &state, "dir0/file0.h~" ) );
+    Check( !FindFileState( &state, "" ) );
+
+    File_State *first = state.files.states[ 0 ];
+    char *other = "not/a/file.h";
+    Check( !FindFileState( &state.files, other, ( u32 ) strlen( other ), first->nameHash ) );
+    Check( FindFileState( &state.files, first->name, first->nameLength, first->nameHash ) == first );
+
+    // NOTE: removed files keep their slot, lookups and the dense array still see them
+    u32 removedCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < STATE_TEST_FILES; fileIndex += 3 )
+    {
+        removedCount += RemoveFile( &state, state.files.states[ fileIndex ] );
+    }
+    Check( !RemoveFile( &state, state.files.states[ 0 ] ) );
+    Check( state.fileCount == STATE_TEST_FILES - removedCount );
+    Check( state.files.count == STATE_TEST_FILES );
+
+    bool removedFound = true;
+    for ( u32 fileIndex = 0; fileIndex < STATE_TEST_FILES; ++fileIndex )
+    {
+        TestFileName( name, sizeof( name ), fileIndex );
+        File_State *file = FindFileState( &state, name );
+        removedFound = removedFound && file == state.files.states[ fileIndex ] && file->removed == ( fileIndex % 3 == 0 );
+    }
+    Check( removedFound );
+
+    // NOTE: tombstones take part in the next growth like live entries
+    u32 slotCount = state.files.slotCount;
+    u32 fileIndex = STATE_TEST_FILES;
+    while ( state.files.slotCount == slotCount )
+    {
+        TestFileName( name, sizeof( name ), fileIndex++ );
+        CreateFileState( &state, arena, name );
+    }
+    bool regrownFound = true;
+    for ( u32 foundIndex = 0; foundIndex < fileIndex; ++foundIndex )
+    {
+        TestFileName( name, sizeof( name ), foundIndex );
+        File_State *file = FindFileState( &state, name );
+        regrownFound = regrownFound && file == state.files.states[ foundIndex ] &&
+                       file->removed == ( foundIndex < STATE_TEST_FILES && foundIndex % 3 == 0 );
+    }
+    Check( regrownFound );
+
+    ReleaseFileTable( &state.files );
+    Check( !FindFileState( &state, "dir0/file0.h" ) );
+}
+
+#define STATE_TEST_DELTA_MAX_FILES 8
+
+struct Decoded_Delta
+{
+    u32 epoch;
+    u32 generation;
+    bool full;
+    u32 fileCount;
+    String files[ STATE_TEST_DELTA_MAX_FILES ];
+    u32 removedCount;
+    String removed[ STATE_TEST_DELTA_MAX_FILES ];
+};
+
+inline bool StringIs( String string, char *expected )
+{
+    bool result = string.length == strlen( expected ) && memcmp( string.content, expected, string.length ) == 0;
+    return result;
+}
+
+inline bool ParseBool( MP_Parser *parser )
+{
+    bool result = GetType( parser ) == MP_Type::BOOL_TRUE;
+    parser->at += 1;
+    return result;
+}
+
+internal bool DeltaHas( String *names, u32 count, char *name )
+{
+    for ( u32 nameIndex = 0; nameIndex < count; ++nameIndex )
+    {
+        if ( StringIs( names[ nameIndex ], name ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE: output has to outlive the result, the names point into it
+internal Decoded_Delta EncodeAndDecodeDelta( Parse_State *state, u32 sinceEpoch, u32 sinceGeneration, u8 *output )
+{
+    MP_Block_Pool pool = {};
+    MP_Encoder encoder = {};
+    BeginEncoder( &encoder, &pool );
+    EncodeDeclarationsDelta( state, sinceEpoch, sinceGeneration, &encoder );
+    CopyEncoderOutput( &encoder, output );
+    EndEncoder( &encoder );
+    ReleaseBlockPool( &pool );
+
+    // NOTE: few enough files that every map is a fix map
+    Decoded_Delta result = {};
+    MP_Parser parser = {};
+    parser.at = output;
+    Check( GetType( &parser ) == MP_Type::FIX_MAP && ( *parser.at & 0x0f ) == 5 );
+    parser.at += 1;
+
+    Check( StringIs( ParseString( &parser ), "epoch" ) );
+    result.epoch = ParseUInt( &parser );
+    Check( StringIs( ParseString( &parser ), "generation" ) );
+    result.generation = ParseUInt( &parser );
+    Check( StringIs( ParseString( &parser ), "full" ) );
+    result.full = ParseBool( &parser );
+
+    Check( StringIs( ParseString( &parser ), "files" ) );
+    Check( GetType( &parser ) == MP_Type::FIX_MAP );
+    result.fileCount = *parser.at & 0x0f;
+    parser.at += 1;
+    for ( u32 fileIndex = 0; fileIndex < result.fileCount; ++fileIndex )
+    {
+        result.files[ fileIndex ] = ParseString( &parser );
+        SkipValue( &parser );
+    }
+
+    Check( StringIs( ParseString( &parser ), "removed" ) );
+    result.removedCount = ParseArrayLength( &parser );
+    for ( u32 removedIndex = 0; removedIndex < result.removedCount; ++removedIndex )
+    {
+        result.removed[ removedIndex ] = ParseString( &parser );
+    }
+    return result;
+}
+
+// NOTE: drives the generations the way a refresh does: files that changed get the next generation,
+// then the state moves to it
+internal void TestDeclarationsDelta( Memory_Arena *arena )
+{
+    Parse_State state = {};
+    state.epoch = 77;
+    File_State *a = CreateFileState( &state, arena, "a.h" );
+    File_State *b = CreateFileState( &state, arena, "b.h" );
+    File_State *c = CreateFileState( &state, arena, "c.h" );
+    a->generation = b->generation = c->generation = 1;
+    state.generation = 1;
+
+    u8 output[ 4096 ];
+    Decoded_Delta delta = EncodeAndDecodeDelta( &state, 77, 0, output );
+    Check( delta.epoch == 77 && delta.generation == 1 && delta.full );
+    Check( delta.fileCount == 3 && DeltaHas( delta.files, delta.fileCount, "a.h" ) &&
+           DeltaHas( delta.files, delta.fileCount, "b.h" ) && DeltaHas( delta.files, delta.fileCount, "c.h" ) );
+    Check( delta.removedCount == 0 );
+
+    delta = EncodeAndDecodeDelta( &state, 77, 1, output );
+    Check( delta.generation == 1 && !delta.full && delta.fileCount == 0 && delta.removedCount == 0 );
+
+    // NOTE: b changes in generation 2
+    b->generation = 2;
+    state.generation = 2;
+    delta = EncodeAndDecodeDelta( &state, 77, 1, output );
+    Check( delta.generation == 2 && !delta.full );
+    Check( delta.fileCount == 1 && DeltaHas( delta.files, delta.fileCount, "b.h" ) && delta.removedCount == 0 );
+
+    // NOTE: c goes away in generation 3, it is reported to clients that had it and only to those
+    RemoveFile( &state, c );
+    state.generation = 3;
+    delta = EncodeAndDecodeDelta( &state, 77, 2, output );
+    Check( delta.generation == 3 && !delta.full && delta.fileCount == 0 );
+    Check( delta.removedCount == 1 && StringIs( delta.removed[ 0 ], "c.h" ) );
+
+    delta = EncodeAndDecodeDelta( &state, 77, 3, output );
+    Check( !delta.full && delta.fileCount == 0 && delta.removedCount == 0 );
+
+    delta = EncodeAndDecodeDelta( &state, 77, 1, output );
+    Check( !delta.full && delta.fileCount == 1 && DeltaHas( delta.files, delta.fileCount, "b.h" ) );
+    Check( delta.removedCount == 1 && StringIs( delta.removed[ 0 ], "c.h" ) );
+
+    delta = EncodeAndDecodeDelta( &state, 77, 0, output );
+    Check( delta.full && delta.fileCount == 2 && !DeltaHas( delta.files, delta.fileCount, "c.h" ) && delta.removedCount == 0 );
+
+    // NOTE: the same generation from another server process, or from a client that sent no epoch,
+    // says nothing about what the client has
+    delta = EncodeAndDecodeDelta( &state, 78, 3, output );
+    Check( delta.epoch == 77 && delta.full && delta.fileCount == 2 && delta.removedCount == 0 );
+    delta = EncodeAndDecodeDelta( &state, 0, 2, output );
+    Check( delta.full && delta.fileCount == 2 && delta.removedCount == 0 );
+
+    // NOTE: a generation this server never reached can only come from an older process
+    delta = EncodeAndDecodeDelta( &state, 77, 10, output );
+    Check( delta.generation == 3 && delta.full && delta.fileCount == 2 && delta.removedCount == 0 );
+
+    for ( u32 fileIndex = 0; fileIndex < state.files.count; ++fileIndex )
+    {
+        ResetChunkedArena( &state.files.states[ fileIndex ]->arena );
+    }
+    ReleaseFileTable( &state.files );
+}
+
+global_variable char *IndexTestSources[][ 2 ] =
+{
+    {
+        "state_test_a.h",
+        "#define LIMIT 4\n"
+        "struct Point { int x; int y; };\n"
+        "inline int Add( int a, int b ) { return a + b; }\n"
+        "enum Mode { ModeA, ModeB };\n",
+    },
+    {
+        "state_test_b.h",
+        "union Value { float f; int i; };\n"
+        "internal void Reset( Point *point ) {}\n"
+        "#define EMPTY\n",
+    },
+};
+
+internal void ParseIndexTestSources( Parse_State *state, Memory_Arena *arena )
+{
+    for ( u32 sourceIndex = 0; sourceIndex < ArrayCount( IndexTestSources ); ++sourceIndex )
+    {
+        File_State *file = CreateFileState( state, arena, IndexTestSources[ sourceIndex ][ 0 ] );
+        ParseFile( file );
+        ParseFileDetails( file );
+        file->generation = 1;
+    }
+    state->generation = 1;
+}
+
+internal void ReleaseTestState( Parse_State *state )
+{
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        ResetChunkedArena( &state->files.states[ fileIndex ]->arena );
+    }
+    ReleaseFileTable( &state->files );
+    *state = {};
+}
+
+inline bool NamesMatch( char *a, char *b )
+{
+    bool result = ( !a && !b ) || ( a && b && strcmp( a, b ) == 0 );
+    return result;
+}
+
+internal bool TablesMatch( File_State *a, File_State *b )
+{
+    Declaration_Table *tableA = &a->declarations;
+    Declaration_Table *tableB = &b->declarations;
+    bool result = a->functionCount == b->functionCount && a->structCount == b->structCount &&
+                  a->macroCount == b->macroCount && tableA->count == tableB->count &&
+                  a->fileSize == b->fileSize && a->contentHash == b->contentHash;
+    for ( u32 index = 0; result && index < tableA->count; ++index )
+    {
+        result = NamesMatch( tableA->names[ index ], tableB->names[ index ] ) && tableA->lines[ index ] == tableB->lines[ index ] &&
+                 tableA->kinds[ index ] == tableB->kinds[ index ] && NamesMatch( tableA->types[ index ], tableB->types[ index ] ) &&
+                 tableA->fieldCounts[ index ] == tableB->fieldCounts[ index ];
+        for ( u32 fieldIndex = 0; result && fieldIndex < tableA->fieldCounts[ index ]; ++fieldIndex )
+        {
+            u32 fieldA = tableA->firstFields[ index ] + fieldIndex;
+            u32 fieldB = tableB->firstFields[ index ] + fieldIndex;
+            result = NamesMatch( tableA->fieldTypes[ fieldA ], tableB->fieldTypes[ fieldB ] ) &&
+                     NamesMatch( tableA->fieldNames[ fieldA ], tableB->fieldNames[ fieldB ] );
+        }
+    }
+    return result;
+}
+
+// NOTE: the written index with one change applied, and whether a fresh state accepts it
+typedef void index_corruption( u8 *index, u32 *size, Index_Layout *layout );
+
+internal bool LoadCorruptedIndex( u8 *index, u32 size, index_corruption *corrupt, Memory_Arena *arena )
+{
+    u8 *copy = ( u8 * ) malloc( size );
+    memcpy( copy, index, size );
+    Index_Layout layout = {};
+    layout.header = *( Index_Header * ) copy;
+    ComputeIndexOffsets( &layout );
+    corrupt( copy, &size, &layout );
+    PlatformWriteEntireFile( INDEX_FILE_NAME, copy, size );
+    free( copy );
+
+    Parse_State state = {};
+    bool result = LoadDeclarationIndex( &state, arena, "." );
+    Check( result || state.files.count == 0 );
+    ReleaseTestState( &state );
+    return result;
+}
+
+inline Index_File *IndexFiles( u8 *index, Index_Layout *layout )
+{
+    return ( Index_File * ) ( index + layout->filesOffset );
+}
+
+inline Index_Function *IndexFunctions( u8 *index, Index_Layout *layout )
+{
+    return ( Index_Function * ) ( index + layout->functionsOffset );
+}
+
+internal void LeaveIndexAlone( u8 *index, u32 *size, Index_Layout *layout ) {}
+
+internal void CorruptStringOffset( u8 *index, u32 *size, Index_Layout *layout )
+{
+    IndexFunctions( index, layout )[ 0 ].name = layout->header.stringsSize;
+}
+
+internal void CorruptStringTerminator( u8 *index, u32 *size, Index_Layout *layout )
+{
+    index[ *size - 1 ] = 'x';
+}
+
+// NOTE: the second file claims the first file's functions, every range still fits its section
+internal void OverlapFileRanges( u8 *index, u32 *size, Index_Layout *layout )
+{
+    IndexFiles( index, layout )[ 1 ].firstFunction = 0;
+}
+
+internal void OverlapFieldRanges( u8 *index, u32 *size, Index_Layout *layout )
+{
+    IndexFunctions( index, layout )[ 1 ].firstArgument = 0;
+}
+
+internal void CorruptDetailOffset( u8 *index, u32 *size, Index_Layout *layout )
+{
+    IndexFunctions( index, layout )[ 0 ].detailOffset = ( u32 ) IndexFiles( index, layout )[ 0 ].fileSize + 1;
+}
+
+internal void CorruptStructType( u8 *index, u32 *size, Index_Layout *layout )
+{
+    ( ( Index_Struct * ) ( index + layout->structsOffset ) )[ 0 ].type = DeclarationKind_Macro;
+}
+
+internal void TruncateIndex( u8 *index, u32 *size, Index_Layout *layout )
+{
+    *size -= 1;
+}
+
+// NOTE: cut off like truncate but with a header that agrees, so only the string checks can notice
+internal void TruncateStrings( u8 *index, u32 *size, Index_Layout *layout )
+{
+    u32 cut = layout->header.stringsSize / 2;
+    Index_Header *header = ( Index_Header * ) index;
+    header->stringsSize -= cut;
+    header->totalSize -= cut;
+    *size -= cut;
+}
+
+internal void TestDeclarationIndex( Memory_Arena *arena )
+{
+    for ( u32 sourceIndex = 0; sourceIndex < ArrayCount( IndexTestSources ); ++sourceIndex )
+    {
+        char *source = IndexTestSources[ sourceIndex ][ 1 ];
+        Check( PlatformWriteEntireFile( IndexTestSources[ sourceIndex ][ 0 ], source, strlen( source ) ) );
+    }
+
+    Parse_State written = {};
+    ParseIndexTestSources( &written, arena );
+    Check( written.files.states[ 0 ]->functionCount == 1 && written.files.states[ 0 ]->structCount == 2 &&
+           written.files.states[ 0 ]->macroCount == 1 );
+    Check( WriteDeclarationIndex( &written, "." ) );
+
+    Parse_State loaded = {};
+    Check( LoadDeclarationIndex( &loaded, arena, "." ) );
+    Check( loaded.files.count == written.files.count && loaded.generation == 1 );
+    for ( u32 fileIndex = 0; fileIndex < written.files.count; ++fileIndex )
+    {
+        File_State *file = written.files.states[ fileIndex ];
+        File_State *loadedFile = FindFileState( &loaded, file->name );
+        Check( loadedFile && TablesMatch( file, loadedFile ) );
+    }
+    ReleaseTestState( &loaded );
+
+    Mapped_File mapping;
+    Check( MapEntireFile( INDEX_FILE_NAME, &mapping ) );
+    u32 size = mapping.size;
+    u8 *index = ( u8 * ) malloc( size );
+    memcpy( index, mapping.content, size );
+    UnmapFile( &mapping );
+
+    Check( LoadCorruptedIndex( index, size, LeaveIndexAlone, arena ) );
+    Check( !LoadCorruptedIndex( index, size, CorruptStringOffset, arena ) );
+    Check( !LoadCorruptedIndex( index, size, CorruptStringTerminator, arena ) );
+    Check( !LoadCorruptedIndex( index, size, OverlapFileRanges, arena ) );
+    Check( !LoadCorruptedIndex( index, size, OverlapFieldRanges, arena ) );
+    Check( !LoadCorruptedIndex( index, size, CorruptDetailOffset, arena ) );
+    Check( !LoadCorruptedIndex( index, size, CorruptStructType, arena ) );
+    Check( !LoadCorruptedIndex( index, size, TruncateIndex, arena ) );
+    Check( !LoadCorruptedIndex( index, size, TruncateStrings, arena ) );
+    free( index );
+
+    ReleaseTestState( &written );
+    PlatformDeleteFile( INDEX_FILE_NAME );
+    for ( u32 sourceIndex = 0; sourceIndex < ArrayCount( IndexTestSources ); ++sourceIndex )
+    {
+        PlatformDeleteFile( IndexTestSources[ sourceIndex ][ 0 ] );
+    }
+}
+
+int main( int argc, char **argv )
+{
+    InitializeStats();
+    InitializeScanKernels();
+    GlobalLogParsing = false;
+
+    Memory_Arena arena;
+    InitializeArena( &arena, Megabytes( 16 ), calloc( Megabytes( 16 ), 1 ) );
+    TestFileTable( &arena );
+    TestDeclarationsDelta( &arena );
+    TestDeclarationIndex( &arena );
+
+    printf( "%u of %u state checks passed\n", GlobalCheckCount - GlobalFailedCount, GlobalCheckCount );
+    return GlobalFailedCount ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+// NOTE: hot path timers, every phase keeps a latency histogram that the parse workers and the main
+// thread record into without a lock. Buckets are log-linear over nanoseconds, eight per power of two,
+// so a percentile is off by at most an eighth of its value.
+
+enum Stat_Phase
+{
+    // NOTE: the whole tree walk, including the stat of every file in it
+    StatPhase_DirectoryScan,
+    StatPhase_Stat,
+    // NOTE: mapping and hashing one file
+    StatPhase_Read,
+    // NOTE: tokenizing and extracting declarations happen in the same pass over the file
+    StatPhase_Parse,
+    // NOTE: flattening the parsed declarations into the file's table
+    StatPhase_Store,
+    // NOTE: parsing the arguments and fields of one file that lazy mode skipped, see ParseFileDetails
+    StatPhase_Details,
+    // NOTE: looking at the watcher's dirty paths and reparsing whatever changed
+    StatPhase_Refresh,
+    // NOTE: handling one request into the encoder, the refresh it triggered is not included
+    StatPhase_Encode,
+    StatPhase_Send,
+
+    StatPhase_Count,
+};
+
+global_variable char *StatPhaseNames[ StatPhase_Count ] =
+{
+    "directory_scan",
+    "stat",
+    "read",
+    "parse",
+    "store",
+    "details",
+    "refresh",
+    "encode",
+    "send",
+};
+
+enum Stat_Counter
+{
+    StatCounter_FilesParsed,
+    StatCounter_FilesUnchanged,
+    StatCounter_BytesParsed,
+    // NOTE: tokens the parser asked for, compare with bytes_parsed
+    StatCounter_TokensParsed,
+    StatCounter_Requests,
+    StatCounter_BytesEncoded,
+    StatCounter_FragmentsEncoded,
+    // NOTE: response bytes a full socket didn't take, these were copied to wait in a send queue
+    StatCounter_BytesQueued,
+
+    StatCounter_Count,
+};
+
+global_variable char *StatCounterNames[ StatCounter_Count ] =
+{
+    "files_parsed",
+    "files_unchanged",
+    "bytes_parsed",
+    "tokens_parsed",
+    "requests",
+    "bytes_encoded",
+    "fragments_encoded",
+    "bytes_queued",
+};
+
+#define HISTOGRAM_LINEAR_BUCKETS 16
+#define HISTOGRAM_SUB_BUCKET_BITS 3
+#define HISTOGRAM_BUCKET_COUNT   ( HISTOGRAM_LINEAR_BUCKETS + ( 64 - 4 ) * ( 1 << HISTOGRAM_SUB_BUCKET_BITS ) )
+
+struct Latency_Histogram
+{
+    u64 volatile count;
+    u64 volatile totalNanoseconds;
+    u64 volatile maxNanoseconds;
+    u64 volatile buckets[ HISTOGRAM_BUCKET_COUNT ];
+};
+
+struct Server_Stats
+{
+    u64 timerFrequency;
+    u64 startTicks;
+    Latency_Histogram phases[ StatPhase_Count ];
+    u64 volatile counters[ StatCounter_Count ];
+};
+
+global_variable Server_Stats GlobalStats;
+
+struct Latency_Summary
+{
+    u64 count;
+    u64 totalNanoseconds;
+    u64 p50Nanoseconds;
+    u64 p99Nanoseconds;
+    u64 maxNanoseconds;
+};
+
+inline u64 ReadTimer()
+{
+    return PlatformReadTimer();
+}
+
+internal void InitializeStats()
+{
+    GlobalStats.timerFrequency = PlatformGetTimerFrequency();
+    GlobalStats.startTicks = ReadTimer();
+}
+
+inline u64 TicksToNanoseconds( u64 ticks )
+{
+    u64 frequency = GlobalStats.timerFrequency ? GlobalStats.timerFrequency : 1;
+    // NOTE: split so the multiply can't overflow for long intervals
+    u64 result = ( ticks / frequency ) * 1000000000ull + ( ticks % frequency ) * 1000000000ull / frequency;
+    return result;
+}
+
+inline u32 GetHistogramBucket( u64 value )
+{
+    u32 result = ( u32 ) value;
+    if ( value >= HISTOGRAM_LINEAR_BUCKETS )
+    {
+        u32 highestBit = FindHighestSetBit64( value );
+        u32 subBucket = ( u32 ) ( value >> ( highestBit - HISTOGRAM_SUB_BUCKET_BITS ) ) & ( ( 1 << HISTOGRAM_SUB_BUCKET_BITS ) - 1 );
+        result = HISTOGRAM_LINEAR_BUCKETS + ( highestBit - 4 ) * ( 1 << HISTOGRAM_SUB_BUCKET_BITS ) + subBucket;
+    }
+    return result;
+}
+
+// NOTE: the largest value that lands in the bucket
+inline u64 GetHistogramBucketLimit( u32 bucket )
+{
+    u64 result = bucket;
+    if ( bucket >= HISTOGRAM_LINEAR_BUCKETS )
+    {
+        u32 octave = ( bucket - HISTOGRAM_LINEAR_BUCKETS ) >> HISTOGRAM_SUB_BUCKET_BITS;
+        u32 subBucket = ( bucket - HISTOGRAM_LINEAR_BUCKETS ) & ( ( 1 << HISTOGRAM_SUB_BUCKET_BITS ) - 1 );
+        u32 shift = octave + 4 - HISTOGRAM_SUB_BUCKET_BITS;
+        result = ( ( ( u64 ) ( 1 << HISTOGRAM_SUB_BUCKET_BITS ) + subBucket + 1 ) << shift ) - 1;
+    }
+    return result;
+}
+
+internal void RecordLatency( Latency_Histogram *histogram, u64 nanoseconds )
+{
+    AtomicAddU64( &histogram->count, 1 );
+    AtomicAddU64( &histogram->totalNanoseconds, nanoseconds );
+    AtomicAddU64( &histogram->buckets[ GetHistogramBucket( nanoseconds ) ], 1 );
+
+    u64 max = histogram->maxNanoseconds;
+    while ( nanoseconds > max )
+    {
+        u64 previous = AtomicCompareExchangeU64( &histogram->maxNanoseconds, nanoseconds, max );
+        if ( previous == max )
+        {
+            break;
+        }
+        max = previous;
+    }
+}
+
+inline void RecordPhase( Stat_Phase phase, u64 ticks )
+{
+    RecordLatency( GlobalStats.phases + phase, TicksToNanoseconds( ticks ) );
+}
+
+// NOTE: records the time since startTicks (from ReadTimer) and returns it in ticks
+inline u64 EndPhase( Stat_Phase phase, u64 startTicks )
+{
+    u64 elapsed = ReadTimer() - startTicks;
+    RecordPhase( phase, elapsed );
+    return elapsed;
+}
+
+inline void AddToCounter( Stat_Counter counter, u64 value )
+{
+    AtomicAddU64( &GlobalStats.counters[ counter ], value );
+}
+
+inline u64 GetCounter( Stat_Counter counter )
+{
+    return GlobalStats.counters[ counter ];
+}
+
+// NOTE: percentiles are the upper edge of the bucket they fall in, capped at the real maximum.
+// Recording can go on while this runs, the summary is only as consistent as a snapshot needs to be.
+internal Latency_Summary SummarizeLatency( Stat_Phase phase )
+{
+    Latency_Histogram *histogram = GlobalStats.phases + phase;
+    Latency_Summary result = {};
+    result.count = histogram->count;
+    result.totalNanoseconds = histogram->totalNanoseconds;
+    result.maxNanoseconds = histogram->maxNanoseconds;
+
+    if ( result.count > 0 )
+    {
+        u64 p50Rank = ( result.count + 1 ) / 2;
+        u64 p99Rank = result.count - result.count / 100;
+        u64 seen = 0;
+        bool p50Found = false;
+        for ( u32 bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; ++bucket )
+        {
+            seen += histogram->buckets[ bucket ];
+            if ( !p50Found && seen >= p50Rank )
+            {
+                result.p50Nanoseconds = GetHistogramBucketLimit( bucket );
+                p50Found = true;
+            }
+            if ( seen >= p99Rank )
+            {
+                result.p99Nanoseconds = GetHistogramBucketLimit( bucket );
+                break;
+            }
+        }
+
+        if ( result.p50Nanoseconds > result.maxNanoseconds )
+        {
+            result.p50Nanoseconds = result.maxNanoseconds;
+        }
+        if ( result.p99Nanoseconds > result.maxNanoseconds || result.p99Nanoseconds == 0 )
+        {
+            result.p99Nanoseconds = result.maxNanoseconds;
+        }
+    }
+
+    return result;
+}
+
+inline u64 GetUptimeMilliseconds()
+{
+    return TicksToNanoseconds( ReadTimer() - GlobalStats.startTicks ) / 1000000;
+}
+
+internal void PrintStats()
+{
+    printf( "%-16s %10s %12s %10s %10s %10s\n", "phase", "count", "total ms", "p50 us", "p99 us", "max us" );
+    for ( u32 phase = 0; phase < StatPhase_Count; ++phase )
+    {
+        Latency_Summary summary = SummarizeLatency( ( Stat_Phase ) phase );
+        if ( summary.count > 0 )
+        {
+            printf( "%-16s %10llu %12.2f %10.1f %10.1f %10.1f\n", StatPhaseNames[ phase ], summary.count,
+                    ( f64 ) summary.totalNanoseconds / 1000000.0, ( f64 ) summary.p50Nanoseconds / 1000.0,
+                    ( f64 ) summary.p99Nanoseconds / 1000.0, ( f64 ) summary.maxNanoseconds / 1000.0 );
+        }
+    }
+    for ( u32 counter = 0; counter < StatCounter_Count; ++counter )
+    {
+        printf( "%s: %llu\n", StatCounterNames[ counter ], GetCounter( ( Stat_Counter ) counter ) );
+    }
+}
@@ -0,0 +1,395 @@
+// NOTE: every name and type the parser keeps goes through here, so each distinct string is stored
+// once and the pointer doubles as its id: two interned strings are equal exactly when the pointers
+// are. Strings are never freed, they live in blocks that are only ever appended to, which keeps the
+// pointers stable while the hash tables grow.
+//
+// The work queue threads intern concurrently, the table is split into shards by the top bits of
+// the hash and each shard has its own spin lock. It starts out as one shard and splits into as many
+// as InitializeInternTable asked for once it holds INTERN_SPLIT_COUNT strings, so a small project
+// doesn't pay a page of slots per shard. All shards append to the same blocks, a shard only costs
+// its slots.
+
+#define INTERN_MAX_SHARDS       64
+#define INTERN_SPLIT_COUNT      4096
+#define INTERN_INITIAL_SLOTS    64
+#define INTERN_PAGE_SIZE        Kilobytes( 4 )
+#define INTERN_MAX_BLOCK_PAGES  16
+#define INTERN_MAX_BLOCK_SIZE   Kilobytes( 64 )
+#define INTERN_BLOCK_SHIFT      16
+#define INTERN_MAX_BLOCKS       ( 1 << ( 32 - INTERN_BLOCK_SHIFT ) )
+
+// NOTE: the low 32 bits of the hash, which also pick the slot, and where the string is in the
+// blocks. 0 marks an empty slot, the first block starts a byte in so no string gets it. At 8 bytes a
+// slot the table costs less than most of the strings it holds, as long as it stays fairly full: it
+// grows by half at 4/5 load, so it is never much less than half full.
+struct Intern_Entry
+{
+    u32 hashTag;
+    u32 offset;
+};
+
+struct Intern_Shard
+{
+    u32 volatile lock;
+
+    u32 count;
+    u32 slotCount;
+    Intern_Entry *slots;
+
+    u64 requestCount;
+    u64 requestedBytes;
+    u64 slotBytes;
+};
+
+// NOTE: an offset's top bits pick the block and the low INTERN_BLOCK_SHIFT bits the byte in it.
+// Blocks start at a page and grow by half up to INTERN_MAX_BLOCK_PAGES, so a small project doesn't
+// pay for room it never uses, and each one fills its pages exactly, allocation header included.
+// Only ever taken while holding a shard lock. The block list never moves, so strings are found
+// through it without this lock.
+struct Intern_Storage
+{
+    u32 volatile lock;
+
+    u32 blockCount;
+    u32 blockUsed;
+    u32 blockSize;
+    u32 blockPages;
+    u8 *blocks[ INTERN_MAX_BLOCKS ];
+
+    u64 storedBytes;
+    u64 blockBytes;
+};
+
+struct Intern_Table
+{
+    u32 volatile shardBits;
+    u32 splitBits;
+    Intern_Shard shards[ INTERN_MAX_SHARDS ];
+    Intern_Storage storage;
+};
+
+struct Intern_Stats
+{
+    u64 requestCount;
+    u64 uniqueCount;
+    // NOTE: what the strings would take as separate copies vs what the pool actually holds, the
+    // overhead counts whole pages the way the OS maps them
+    u64 requestedBytes;
+    u64 storedBytes;
+    u64 overheadBytes;
+};
+
+global_variable Intern_Table GlobalInternTable;
+
+// NOTE: a shard per thread keeps the parse threads from mostly waiting on each other, more would
+// only cost memory. Has to run before the first string is interned, without it the table never
+// splits.
+internal void InitializeInternTable( u32 threadCount )
+{
+    u32 splitBits = 0;
+    while ( ( 1u << splitBits ) < threadCount && ( 1u << splitBits ) < INTERN_MAX_SHARDS )
+    {
+        ++splitBits;
+    }
+    GlobalInternTable.splitBits = splitBits;
+}
+
+inline u32 GetShardIndex( u64 hash, u32 shardBits )
+{
+    u32 result = shardBits ? ( u32 ) ( hash >> ( 64 - shardBits ) ) : 0;
+    return result;
+}
+
+// NOTE: the table can split between reading the shard count and getting the lock, the hash may
+// belong to another shard then and it starts over. It only ever splits once.
+internal Intern_Shard *LockInternShard( u64 hash )
+{
+    Intern_Shard *result = 0;
+    while ( !result )
+    {
+        u32 shardBits = GlobalInternTable.shardBits;
+        Intern_Shard *shard = GlobalInternTable.shards + GetShardIndex( hash, shardBits );
+        AcquireSpinLock( &shard->lock );
+        if ( GlobalInternTable.shardBits == shardBits )
+        {
+            result = shard;
+        }
+        else
+        {
+            ReleaseSpinLock( &shard->lock );
+        }
+    }
+    return result;
+}
+
+// NOTE: size rounded up to the pages PlatformAllocateMemory maps for it
+inline u32 GetMappedPages( memory_index size )
+{
+    u32 result = ( u32 ) ( ( size + PLATFORM_ALLOCATION_HEADER + INTERN_PAGE_SIZE - 1 ) / INTERN_PAGE_SIZE );
+    return result;
+}
+
+// NOTE: the tag scaled to the table size, which doesn't have to be a power of two
+inline u32 GetHomeSlot( u32 hashTag, u32 slotCount )
+{
+    u32 result = ( u32 ) ( ( ( u64 ) hashTag * slotCount ) >> 32 );
+    return result;
+}
+
+inline u32 GetNextSlot( u32 slotIndex, u32 slotCount )
+{
+    u32 result = slotIndex + 1 == slotCount ? 0 : slotIndex + 1;
+    return result;
+}
+
+inline char *GetInternedString( u32 offset )
+{
+    char *result = ( char * ) GlobalInternTable.storage.blocks[ offset >> INTERN_BLOCK_SHIFT ] + ( offset & ( INTERN_MAX_BLOCK_SIZE - 1 ) );
+    return result;
+}
+
+// NOTE: the stored string is zero terminated and text has no zeroes in it, so strncmp never reads
+// past either of them
+inline bool InternedStringIs( Intern_Entry *entry, u32 hashTag, char *text, u32 length )
+{
+    bool result = false;
+    if ( entry->hashTag == hashTag )
+    {
+        char *string = GetInternedString( entry->offset );
+        result = strncmp( string, text, length ) == 0 && string[ length ] == '\0';
+    }
+    return result;
+}
+
+// NOTE: for an entry that isn't in the shard yet
+inline void PlaceEntry( Intern_Shard *shard, Intern_Entry entry )
+{
+    u32 slotIndex = GetHomeSlot( entry.hashTag, shard->slotCount );
+    while ( shard->slots[ slotIndex ].offset )
+    {
+        slotIndex = GetNextSlot( slotIndex, shard->slotCount );
+    }
+    shard->slots[ slotIndex ] = entry;
+}
+
+// NOTE: the slots the rest of the last page holds come for free
+internal void GrowShard( Intern_Shard *shard, u32 minimumSlotCount )
+{
+    u32 oldSlotCount = shard->slotCount;
+    Intern_Entry *oldSlots = shard->slots;
+
+    u32 pageCount = GetMappedPages( minimumSlotCount * sizeof( Intern_Entry ) );
+    shard->slotCount = ( u32 ) ( ( pageCount * INTERN_PAGE_SIZE - PLATFORM_ALLOCATION_HEADER ) / sizeof( Intern_Entry ) );
+    shard->slots = ( Intern_Entry * ) PlatformAllocateMemory( shard->slotCount * sizeof( Intern_Entry ) );
+    shard->slotBytes = pageCount * INTERN_PAGE_SIZE;
+
+    for ( u32 slotIndex = 0; slotIndex < oldSlotCount; ++slotIndex )
+    {
+        if ( oldSlots[ slotIndex ].offset )
+        {
+            PlaceEntry( shard, oldSlots[ slotIndex ] );
+        }
+    }
+    if ( oldSlots )
+    {
+        PlatformFreeMemory( oldSlots );
+    }
+}
+
+// NOTE: keeps the load under 4/5 for one more entry
+inline void ReserveShardSlot( Intern_Shard *shard )
+{
+    if ( ( u64 ) ( shard->count + 1 ) * 5 > ( u64 ) shard->slotCount * 4 )
+    {
+        GrowShard( shard, shard->slotCount ? shard->slotCount + shard->slotCount / 2 : INTERN_INITIAL_SLOTS );
+    }
+}
+
+// NOTE: called holding the only shard's lock. Takes the other shards' locks too, so nobody who sees
+// the new shard count can use a shard before its strings are in. The tag is only the low half of
+// the hash and the shard comes from the top, so every string is hashed again.
+internal void SplitInternTable()
+{
+    Intern_Table *table = &GlobalInternTable;
+    u32 shardCount = 1u << table->splitBits;
+    for ( u32 shardIndex = 1; shardIndex < shardCount; ++shardIndex )
+    {
+        AcquireSpinLock( &table->shards[ shardIndex ].lock );
+    }
+
+    Intern_Shard *first = table->shards;
+    u32 oldSlotCount = first->slotCount;
+    Intern_Entry *oldSlots = first->slots;
+    u32 expectedCount = first->count / shardCount;
+    first->count = 0;
+    first->slotCount = 0;
+    first->slots = 0;
+    for ( u32 shardIndex = 0; shardIndex < shardCount; ++shardIndex )
+    {
+        GrowShard( table->shards + shardIndex, expectedCount + expectedCount / 2 );
+    }
+
+    for ( u32 slotIndex = 0; slotIndex < oldSlotCount; ++slotIndex )
+    {
+        Intern_Entry entry = oldSlots[ slotIndex ];
+        if ( entry.offset )
+        {
+            char *string = GetInternedString( entry.offset );
+            Intern_Shard *shard = table->shards + GetShardIndex( HashBytes( string, strlen( string ) ), table->splitBits );
+            ReserveShardSlot( shard );
+            PlaceEntry( shard, entry );
+            shard->count += 1;
+        }
+    }
+    PlatformFreeMemory( oldSlots );
+
+    table->shardBits = table->splitBits;
+    for ( u32 shardIndex = 1; shardIndex < shardCount; ++shardIndex )
+    {
+        ReleaseSpinLock( &table->shards[ shardIndex ].lock );
+    }
+}
+
+// NOTE: returns the new string's offset
+internal u32 StoreInternedString( char *text, u32 length )
+{
+    Intern_Storage *storage = &GlobalInternTable.storage;
+    u32 size = length + 1;
+
+    AcquireSpinLock( &storage->lock );
+    if ( storage->blockCount == 0 || storage->blockUsed + size > storage->blockSize )
+    {
+        // NOTE: the rest of the old block is wasted, it is at most one long string's worth. A string
+        // longer than a block gets one of its own, only its start has to be addressable.
+        Assert( storage->blockCount < INTERN_MAX_BLOCKS );
+        u32 reserved = storage->blockCount == 0 ? 1 : 0;
+        u32 pageCount = storage->blockPages ? storage->blockPages + ( storage->blockPages + 1 ) / 2 : 1;
+        pageCount = pageCount < INTERN_MAX_BLOCK_PAGES ? pageCount : INTERN_MAX_BLOCK_PAGES;
+        u32 neededPages = GetMappedPages( reserved + size );
+        storage->blockPages = neededPages > pageCount ? neededPages : pageCount;
+        storage->blockSize = storage->blockPages * INTERN_PAGE_SIZE - PLATFORM_ALLOCATION_HEADER;
+        storage->blocks[ storage->blockCount++ ] = ( u8 * ) PlatformAllocateMemory( storage->blockSize );
+        storage->blockUsed = reserved;
+        storage->blockBytes += storage->blockPages * INTERN_PAGE_SIZE;
+        if ( storage->blockSize > INTERN_MAX_BLOCK_SIZE )
+        {
+            // NOTE: nothing after the long string would be addressable
+            storage->blockSize = reserved + size;
+        }
+    }
+
+    u32 result = ( ( storage->blockCount - 1 ) << INTERN_BLOCK_SHIFT ) | storage->blockUsed;
+    char *string = ( char * ) storage->blocks[ storage->blockCount - 1 ] + storage->blockUsed;
+    memcpy( string, text, length );
+    string[ length ] = '\0';
+    storage->blockUsed += size;
+    storage->storedBytes += size;
+    ReleaseSpinLock( &storage->lock );
+    return result;
+}
+
+internal char *InternString( char *text, u32 length )
+{
+    u64 hash = HashBytes( text, length );
+    u32 hashTag = ( u32 ) hash;
+
+    Intern_Shard *shard = LockInternShard( hash );
+    if ( shard->count >= INTERN_SPLIT_COUNT && GlobalInternTable.shardBits < GlobalInternTable.splitBits )
+    {
+        SplitInternTable();
+        ReleaseSpinLock( &shard->lock );
+        shard = LockInternShard( hash );
+    }
+
+    shard->requestCount += 1;
+    shard->requestedBytes += length + 1;
+    ReserveShardSlot( shard );
+
+    char *result = 0;
+    u32 slotIndex = GetHomeSlot( hashTag, shard->slotCount );
+    for ( ;; )
+    {
+        Intern_Entry *entry = shard->slots + slotIndex;
+        if ( !entry->offset )
+        {
+            entry->hashTag = hashTag;
+            entry->offset = StoreInternedString( text, length );
+            shard->count += 1;
+            result = GetInternedString( entry->offset );
+            break;
+        }
+
+        if ( InternedStringIs( entry, hashTag, text, length ) )
+        {
+            result = GetInternedString( entry->offset );
+            break;
+        }
+        slotIndex = GetNextSlot( slotIndex, shard->slotCount );
+    }
+
+    ReleaseSpinLock( &shard->lock );
+    return result;
+}
+
+inline char *InternString( char *string )
+{
+    return InternString( string, ( u32 ) strlen( string ) );
+}
+
+// NOTE: the interned copy of text if there is one, without adding it. Lookups for names coming from
+// the client use it so a typo doesn't grow the pool.
+internal char *FindInternedString( char *text, u32 length )
+{
+    u64 hash = HashBytes( text, length );
+    u32 hashTag = ( u32 ) hash;
+    Intern_Shard *shard = LockInternShard( hash );
+
+    char *result = 0;
+    if ( shard->slotCount )
+    {
+        u32 slotIndex = GetHomeSlot( hashTag, shard->slotCount );
+        for ( Intern_Entry *entry = shard->slots + slotIndex; entry->offset; entry = shard->slots + slotIndex )
+        {
+            if ( InternedStringIs( entry, hashTag, text, length ) )
+            {
+                result = GetInternedString( entry->offset );
+                break;
+            }
+            slotIndex = GetNextSlot( slotIndex, shard->slotCount );
+        }
+    }
+    ReleaseSpinLock( &shard->lock );
+    return result;
+}
+
+internal Intern_Stats GetInternStats()
+{
+    // NOTE: every shard, the table may split while they are being added up
+    Intern_Stats result = {};
+    for ( u32 shardIndex = 0; shardIndex < INTERN_MAX_SHARDS; ++shardIndex )
+    {
+        Intern_Shard *shard = GlobalInternTable.shards + shardIndex;
+        AcquireSpinLock( &shard->lock );
+        result.requestCount += shard->requestCount;
+        result.uniqueCount += shard->count;
+        result.requestedBytes += shard->requestedBytes;
+        result.overheadBytes += shard->slotBytes;
+        ReleaseSpinLock( &shard->lock );
+    }
+
+    Intern_Storage *storage = &GlobalInternTable.storage;
+    AcquireSpinLock( &storage->lock );
+    result.storedBytes = storage->storedBytes;
+    result.overheadBytes += storage->blockBytes - storage->storedBytes;
+    ReleaseSpinLock( &storage->lock );
+    return result;
+}
+
+internal void PrintInternStats( Intern_Stats stats )
+{
+    s64 saved = ( s64 ) stats.requestedBytes - ( s64 ) ( stats.storedBytes + stats.overheadBytes );
+    printf( "Interned %llu strings, %llu unique: %.2f MB as copies, %.2f MB in the pool + %.2f MB tables, %.2f MB saved\n",
+            stats.requestCount, stats.uniqueCount,
+            ( f64 ) stats.requestedBytes / Megabytes( 1 ), ( f64 ) stats.storedBytes / Megabytes( 1 ),
+            ( f64 ) stats.overheadBytes / Megabytes( 1 ), ( f64 ) saved / Megabytes( 1 ) );
+}
@@ -0,0 +1,539 @@
+enum Symbol_Kind : u8
+{
+    SymbolKind_Function = 0x1,
+    SymbolKind_Struct = 0x2,
+    SymbolKind_Macro = 0x4,
+
+    SymbolKind_All = 0x7,
+};
+
+inline Symbol_Kind GetSymbolKind( u8 declarationKind )
+{
+    Symbol_Kind result = SymbolKind_Struct;
+    if ( declarationKind == DeclarationKind_Function )
+    {
+        result = SymbolKind_Function;
+    }
+    else if ( declarationKind == DeclarationKind_Macro )
+    {
+        result = SymbolKind_Macro;
+    }
+    return result;
+}
+
+struct Symbol
+{
+    char *name;
+    u32 nameLength;
+    Symbol_Kind kind;
+
+    File_State *file;
+    u32 line;
+    u32 declarationIndex;
+};
+
+struct Trigram_Entry
+{
+    u32 trigram;
+    u32 firstPosting;
+    u32 postingCount;
+};
+
+// NOTE: search index over every declaration name, rebuilt when the parse generation moves.
+// Queries of three or more characters first score the symbols in the posting list of their rarest
+// trigram, shorter ones walk the case-insensitive prefix table. Both only find names that contain the
+// query, when they come up short the whole symbol table is scanned for subsequence matches.
+struct Symbol_Index
+{
+    u32 generation;
+    bool built;
+
+    u32 symbolCount;
+    Symbol *symbols;
+    Symbol **prefixTable;
+
+    u32 trigramCount;
+    Trigram_Entry *trigrams;
+    u32 *postings;
+
+    void *memory;
+};
+
+struct Symbol_Match
+{
+    Symbol *symbol;
+    s32 score;
+};
+
+#define SYMBOL_QUERY_MAX_LENGTH 128
+
+inline char ToLower( char c )
+{
+    char result = ( c >= 'A' && c <= 'Z' ) ? c - 'A' + 'a' : c;
+    return result;
+}
+
+inline u32 MakeTrigram( char *at )
+{
+    u32 result = ( ( u32 ) ( u8 ) ToLower( at[ 0 ] ) << 16 ) | ( ( u32 ) ( u8 ) ToLower( at[ 1 ] ) << 8 ) | ( u32 ) ( u8 ) ToLower( at[ 2 ] );
+    return result;
+}
+
+internal int CompareSymbolNames( const void *a, const void *b )
+{
+    Symbol *symbolA = *( Symbol ** ) a;
+    Symbol *symbolB = *( Symbol ** ) b;
+    u32 length = symbolA->nameLength < symbolB->nameLength ? symbolA->nameLength : symbolB->nameLength;
+    for ( u32 index = 0; index < length; ++index )
+    {
+        char charA = ToLower( symbolA->name[ index ] );
+        char charB = ToLower( symbolB->name[ index ] );
+        if ( charA != charB )
+        {
+            return charA < charB ? -1 : 1;
+        }
+    }
+    return ( int ) symbolA->nameLength - ( int ) symbolB->nameLength;
+}
+
+// NOTE: LSD radix sort on the 24 trigram bits of ( trigram << 32 | symbolIndex ) keys, stable so
+// postings stay in symbol order
+internal void SortTrigramKeys( u64 *keys, u64 *temp, u32 count )
+{
+    u64 *source = keys;
+    u64 *dest = temp;
+    for ( u32 shift = 32; shift < 56; shift += 8 )
+    {
+        u32 offsets[ 256 ] = {};
+        for ( u32 index = 0; index < count; ++index )
+        {
+            ++offsets[ ( source[ index ] >> shift ) & 0xFF ];
+        }
+
+        u32 total = 0;
+        for ( u32 bucket = 0; bucket < 256; ++bucket )
+        {
+            u32 bucketCount = offsets[ bucket ];
+            offsets[ bucket ] = total;
+            total += bucketCount;
+        }
+
+        for ( u32 index = 0; index < count; ++index )
+        {
+            dest[ offsets[ ( source[ index ] >> shift ) & 0xFF ]++ ] = source[ index ];
+        }
+
+        u64 *swap = source;
+        source = dest;
+        dest = swap;
+    }
+    // NOTE: three passes, so the sorted keys ended up in temp
+    memcpy( keys, source, count * sizeof( u64 ) );
+}
+
+inline void AddSymbol( Symbol_Index *index, char *name, Symbol_Kind kind, File_State *file, u32 line, u32 declarationIndex )
+{
+    Symbol *symbol = index->symbols + index->symbolCount++;
+    symbol->name = name;
+    symbol->nameLength = ( u32 ) strlen( name );
+    symbol->kind = kind;
+    symbol->file = file;
+    symbol->line = line;
+    symbol->declarationIndex = declarationIndex;
+}
+
+internal void BuildSymbolIndex( Symbol_Index *index, Parse_State *state )
+{
+    if ( index->memory )
+    {
+        PlatformFreeMemory( index->memory );
+        index->memory = 0;
+    }
+    index->symbolCount = 0;
+    index->trigramCount = 0;
+
+    u32 symbolCount = 0;
+    u32 maxTrigramCount = 0;
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed )
+        {
+            continue;
+        }
+
+        Declaration_Table *table = &file->declarations;
+        symbolCount += table->count;
+        for ( u32 declarationIndex = 0; declarationIndex < table->count; ++declarationIndex )
+        {
+            maxTrigramCount += ( u32 ) strlen( table->names[ declarationIndex ] );
+        }
+    }
+
+    // NOTE: sized for the worst case of every trigram being distinct, the pages we don't touch are never
+    // backed. The ( trigram, symbol ) sort keys live in a scratch block that is freed at the end.
+    memory_index memorySize = symbolCount * ( sizeof( Symbol ) + sizeof( Symbol * ) ) +
+                              maxTrigramCount * ( sizeof( Trigram_Entry ) + sizeof( u32 ) );
+    index->memory = memorySize ? PlatformAllocateMemory( memorySize ) : 0;
+    u64 *keys = maxTrigramCount ? ( u64 * ) PlatformAllocateMemory( maxTrigramCount * 2 * sizeof( u64 ) ) : 0;
+    if ( !index->memory || ( maxTrigramCount && !keys ) )
+    {
+        if ( index->memory )
+        {
+            PlatformFreeMemory( index->memory );
+            index->memory = 0;
+        }
+        index->generation = state->generation;
+        index->built = true;
+        return;
+    }
+
+    index->symbols = ( Symbol * ) index->memory;
+    index->prefixTable = ( Symbol ** ) ( index->symbols + symbolCount );
+    index->trigrams = ( Trigram_Entry * ) ( index->prefixTable + symbolCount );
+    index->postings = ( u32 * ) ( index->trigrams + maxTrigramCount );
+
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( file->removed )
+        {
+            continue;
+        }
+
+        Declaration_Table *table = &file->declarations;
+        for ( u32 declarationIndex = 0; declarationIndex < table->count; ++declarationIndex )
+        {
+            AddSymbol( index, table->names[ declarationIndex ], GetSymbolKind( table->kinds[ declarationIndex ] ),
+                       file, table->lines[ declarationIndex ], declarationIndex );
+        }
+    }
+
+    u32 keyCount = 0;
+    for ( u32 symbolIndex = 0; symbolIndex < index->symbolCount; ++symbolIndex )
+    {
+        Symbol *symbol = index->symbols + symbolIndex;
+        index->prefixTable[ symbolIndex ] = symbol;
+        for ( u32 charIndex = 0; charIndex + 2 < symbol->nameLength; ++charIndex )
+        {
+            keys[ keyCount++ ] = ( ( u64 ) MakeTrigram( symbol->name + charIndex ) << 32 ) | symbolIndex;
+        }
+    }
+    qsort( index->prefixTable, index->symbolCount, sizeof( Symbol * ), CompareSymbolNames );
+
+    // NOTE: after sorting, equal keys (a trigram repeated inside one name) collapse into one posting
+    SortTrigramKeys( keys, keys + maxTrigramCount, keyCount );
+    u32 postingCount = 0;
+    for ( u32 keyIndex = 0; keyIndex < keyCount; ++keyIndex )
+    {
+        if ( keyIndex > 0 && keys[ keyIndex ] == keys[ keyIndex - 1 ] )
+        {
+            continue;
+        }
+
+        u32 trigram = ( u32 ) ( keys[ keyIndex ] >> 32 );
+        if ( index->trigramCount == 0 || index->trigrams[ index->trigramCount - 1 ].trigram != trigram )
+        {
+            Trigram_Entry *entry = index->trigrams + index->trigramCount++;
+            entry->trigram = trigram;
+            entry->firstPosting = postingCount;
+            entry->postingCount = 0;
+        }
+
+        index->trigrams[ index->trigramCount - 1 ].postingCount += 1;
+        index->postings[ postingCount++ ] = ( u32 ) keys[ keyIndex ];
+    }
+
+    if ( keys )
+    {
+        PlatformFreeMemory( keys );
+    }
+
+    index->generation = state->generation;
+    index->built = true;
+    printf( "Built symbol index: %d symbols, %d trigrams\n", index->symbolCount, index->trigramCount );
+}
+
+internal Trigram_Entry *FindTrigram( Symbol_Index *index, u32 trigram )
+{
+    u32 low = 0;
+    u32 high = index->trigramCount;
+    while ( low < high )
+    {
+        u32 middle = low + ( high - low ) / 2;
+        if ( index->trigrams[ middle ].trigram < trigram )
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    Trigram_Entry *result = 0;
+    if ( low < index->trigramCount && index->trigrams[ low ].trigram == trigram )
+    {
+        result = index->trigrams + low;
+    }
+    return result;
+}
+
+inline bool IsWordStart( char *name, u32 position )
+{
+    bool result = position == 0 || name[ position - 1 ] == '_' ||
+                  ( name[ position ] >= 'A' && name[ position ] <= 'Z' && name[ position - 1 ] >= 'a' && name[ position - 1 ] <= 'z' );
+    return result;
+}
+
+// NOTE: query is already lowercase. Exact beats prefix beats substring beats subsequence, shorter
+// names win ties. Returns 0 when the name doesn't match at all.
+internal s32 ScoreSymbol( Symbol *symbol, char *query, u32 queryLength )
+{
+    char *name = symbol->name;
+    u32 nameLength = symbol->nameLength;
+    if ( queryLength > nameLength )
+    {
+        return 0;
+    }
+
+    s32 substringAt = -1;
+    for ( u32 start = 0; start + queryLength <= nameLength; ++start )
+    {
+        u32 matched = 0;
+        while ( matched < queryLength && ToLower( name[ start + matched ] ) == query[ matched ] )
+        {
+            ++matched;
+        }
+
+        if ( matched == queryLength )
+        {
+            if ( substringAt < 0 || ( IsWordStart( name, start ) && !IsWordStart( name, substringAt ) ) )
+            {
+                substringAt = ( s32 ) start;
+            }
+            if ( start == 0 )
+            {
+                break;
+            }
+        }
+    }
+
+    s32 lengthPenalty = ( s32 ) ( nameLength - queryLength );
+    bool matched = true;
+    s32 result = 0;
+    if ( substringAt == 0 && nameLength == queryLength )
+    {
+        result = 10000;
+    }
+    else if ( substringAt == 0 )
+    {
+        result = 8000 - lengthPenalty;
+    }
+    else if ( substringAt > 0 )
+    {
+        result = ( IsWordStart( name, substringAt ) ? 6000 : 4000 ) - substringAt * 8 - lengthPenalty;
+    }
+    else
+    {
+        u32 queryIndex = 0;
+        s32 gaps = 0;
+        for ( u32 nameIndex = 0; nameIndex < nameLength && queryIndex < queryLength; ++nameIndex )
+        {
+            if ( ToLower( name[ nameIndex ] ) == query[ queryIndex ] )
+            {
+                ++queryIndex;
+            }
+            else if ( queryIndex > 0 )
+            {
+                ++gaps;
+            }
+        }
+
+        matched = queryIndex == queryLength;
+        result = 2000 - gaps * 8 - lengthPenalty;
+    }
+
+    if ( !matched )
+    {
+        result = 0;
+    }
+    else if ( result < 1 )
+    {
+        result = 1;
+    }
+    return result;
+}
+
+inline bool NameStartsWith( Symbol *symbol, char *query, u32 queryLength )
+{
+    if ( symbol->nameLength < queryLength )
+    {
+        return false;
+    }
+
+    for ( u32 charIndex = 0; charIndex < queryLength; ++charIndex )
+    {
+        if ( ToLower( symbol->name[ charIndex ] ) != query[ charIndex ] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NOTE: query is already lowercase, rejects most names before ScoreSymbol looks at them
+inline bool IsSubsequence( Symbol *symbol, char *query, u32 queryLength )
+{
+    u32 queryIndex = 0;
+    for ( u32 nameIndex = 0; nameIndex < symbol->nameLength && queryIndex < queryLength; ++nameIndex )
+    {
+        if ( ToLower( symbol->name[ nameIndex ] ) == query[ queryIndex ] )
+        {
+            ++queryIndex;
+        }
+    }
+    return queryIndex == queryLength;
+}
+
+inline void InsertMatch( Symbol_Match *matches, u32 *matchCount, u32 limit, Symbol *symbol, s32 score )
+{
+    if ( *matchCount == limit && ( score < matches[ limit - 1 ].score ||
+                                   ( score == matches[ limit - 1 ].score && symbol->nameLength >= matches[ limit - 1 ].symbol->nameLength ) ) )
+    {
+        return;
+    }
+
+    u32 position = *matchCount < limit ? ( *matchCount )++ : limit - 1;
+    while ( position > 0 && ( matches[ position - 1 ].score < score ||
+                              ( matches[ position - 1 ].score == score && matches[ position - 1 ].symbol->nameLength > symbol->nameLength ) ) )
+    {
+        matches[ position ] = matches[ position - 1 ];
+        --position;
+    }
+    matches[ position ].symbol = symbol;
+    matches[ position ].score = score;
+}
+
+// NOTE: returns the number of matches written to matches, best first
+internal u32 FindSymbols( Symbol_Index *index, String query, u32 limit, u8 kindMask, Symbol_Match *matches )
+{
+    if ( limit == 0 )
+    {
+        return 0;
+    }
+
+    char lowerQuery[ SYMBOL_QUERY_MAX_LENGTH ];
+    u32 queryLength = query.length < SYMBOL_QUERY_MAX_LENGTH ? query.length : SYMBOL_QUERY_MAX_LENGTH;
+    for ( u32 charIndex = 0; charIndex < queryLength; ++charIndex )
+    {
+        lowerQuery[ charIndex ] = ToLower( query.content[ charIndex ] );
+    }
+
+    u32 matchCount = 0;
+    if ( queryLength == 0 )
+    {
+        for ( u32 prefixIndex = 0; prefixIndex < index->symbolCount && matchCount < limit; ++prefixIndex )
+        {
+            Symbol *symbol = index->prefixTable[ prefixIndex ];
+            if ( symbol->kind & kindMask )
+            {
+                matches[ matchCount ].symbol = symbol;
+                matches[ matchCount ].score = 1;
+                ++matchCount;
+            }
+        }
+    }
+    else if ( queryLength >= 3 )
+    {
+        Trigram_Entry *rarest = 0;
+        for ( u32 charIndex = 0; charIndex + 2 < queryLength; ++charIndex )
+        {
+            // NOTE: a missing trigram rules out substrings, subsequences are left to the scan below
+            Trigram_Entry *entry = FindTrigram( index, MakeTrigram( lowerQuery + charIndex ) );
+            if ( !entry )
+            {
+                rarest = 0;
+                break;
+            }
+            if ( !rarest || entry->postingCount < rarest->postingCount )
+            {
+                rarest = entry;
+            }
+        }
+
+        for ( u32 postingIndex = 0; rarest && postingIndex < rarest->postingCount; ++postingIndex )
+        {
+            Symbol *symbol = index->symbols + index->postings[ rarest->firstPosting + postingIndex ];
+            if ( symbol->kind & kindMask )
+            {
+                s32 score = ScoreSymbol( symbol, lowerQuery, queryLength );
+                if ( score > 0 )
+                {
+                    InsertMatch( matches, &matchCount, limit, symbol, score );
+                }
+            }
+        }
+    }
+    else
+    {
+        // NOTE: binary search for the first name that isn't below the query, then walk the prefix run
+        u32 low = 0;
+        u32 high = index->symbolCount;
+        while ( low < high )
+        {
+            u32 middle = low + ( high - low ) / 2;
+            Symbol *symbol = index->prefixTable[ middle ];
+            bool below = false;
+            for ( u32 charIndex = 0; charIndex < queryLength; ++charIndex )
+            {
+                char c = charIndex < symbol->nameLength ? ToLower( symbol->name[ charIndex ] ) : '\0';
+                if ( c != lowerQuery[ charIndex ] )
+                {
+                    below = c < lowerQuery[ charIndex ];
+                    break;
+                }
+            }
+
+            if ( below )
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        for ( u32 prefixIndex = low; prefixIndex < index->symbolCount; ++prefixIndex )
+        {
+            Symbol *symbol = index->prefixTable[ prefixIndex ];
+            if ( !NameStartsWith( symbol, lowerQuery, queryLength ) )
+            {
+                break;
+            }
+
+            if ( symbol->kind & kindMask )
+            {
+                InsertMatch( matches, &matchCount, limit, symbol, ScoreSymbol( symbol, lowerQuery, queryLength ) );
+            }
+        }
+    }
+
+    // NOTE: too few names contain the query, so "gtdcl" still finds GetDeclarations. The scan scores
+    // every symbol again, which puts the ones found above back in their place among the rest.
+    if ( queryLength > 0 && matchCount < limit )
+    {
+        matchCount = 0;
+        for ( u32 symbolIndex = 0; symbolIndex < index->symbolCount; ++symbolIndex )
+        {
+            Symbol *symbol = index->symbols + symbolIndex;
+            if ( ( symbol->kind & kindMask ) && IsSubsequence( symbol, lowerQuery, queryLength ) )
+            {
+                InsertMatch( matches, &matchCount, limit, symbol, ScoreSymbol( symbol, lowerQuery, queryLength ) );
+            }
+        }
+    }
+
+    return matchCount;
+}
@@ -30,6 +30,8 @@ function nvim_cpp.setup(opts)
     vim.api.nvim_create_user_command('CompileCpp', nvim_cpp.compile, {nargs = 0, desc = ''}) 
     vim.api.nvim_create_user_command('ExitCpp', nvim_cpp.exit, {nargs = 0, desc = ''}) 
     vim.api.nvim_create_user_command('SignatureHelp', nvim_cpp.signature_help, {nargs = 0, desc = ''}) 
+    vim.api.nvim_create_user_command('GoToDefinition', nvim_cpp.go_to_definition, {nargs = 0, desc = ''}) 
+    vim.api.nvim_create_user_command('StatsCpp', nvim_cpp.show_stats, {nargs = 0, desc = ''}) 
 
     if nvim_cpp.channel_id == nil then
         -- local job = require('plenary.job')
@@ -40,91 +42,144 @@ function nvim_cpp.setup(opts)
         -- vim.loop.sleep(100)
         nvim_cpp.channel_id = vim.fn.sockconnect("tcp", "localhost:12345", {rpc = true})
         nvim_cpp.get_declarations()
+        -- from here on the server pushes whatever changes past the generation we already have
+        vim.fn.rpcrequest(nvim_cpp.channel_id, "Subscribe", nvim_cpp.generation, nvim_cpp.epoch)
     end
 end
 
+function nvim_cpp.make_function_entry(file, funct)
+    local entry = {}
+    entry["bufnr"] = vim.uri_to_bufnr(file)
+    entry["path"] = file
+    entry["lnum"] = funct["line"]
+    entry["symbol_type"] = "function"
+
+    entry["type_length"] = #funct["return_type"]
+    entry["name_length"] = #funct["name"]
+    local display = funct["return_type"] .. " " .. funct["name"] .. "( "
+
+    local arguments = funct["arguments"]
+    entry["args"] = {}
+    for index, arg in ipairs(arguments) do
+        table.insert(entry["args"], {#arg["type"], #arg["name"]})
+        display = display .. arg["type"] .. " " .. arg["name"]
+        if index == #arguments then
+            display = display .. " )"
+        else
+            display = display .. ", "
+        end
+    end
+
+    if arguments == nil or #arguments == 0 then
+            display = display .. " )"
+    end
+    entry["ordinal"] = display
+    return entry
+end
+
+function nvim_cpp.make_struct_entry(file, struct)
+    local entry = {}
+    entry["bufnr"] = vim.uri_to_bufnr(file)
+    entry["path"] = file
+    entry["lnum"] = struct["line"]
+    entry["symbol_type"] = "struct"
+    entry["struct_type"] = struct["type"]
+    entry["ordinal"] = struct["type"] .. " " .. struct["name"]
+    return entry
+end
+
+function nvim_cpp.make_macro_entry(file, macro)
+    local entry = {}
+    entry["bufnr"] = vim.uri_to_bufnr(file)
+    entry["path"] = file
+    entry["lnum"] = macro["line"]
+    entry["symbol_type"] = "macro"
+    entry["ordinal"] = macro["name"]
+    return entry
+end
+
+function nvim_cpp.create_file_entries(file, declarations)
+    local file_cache = {entries = {}}
+    local entries = file_cache["entries"]
+
+    for index, funct in ipairs(declarations["functions"]) do
+        table.insert(entries, nvim_cpp.make_function_entry(file, funct))
+    end
+
+    for index, struct in ipairs(declarations["structs"]) do
+        table.insert(entries, nvim_cpp.make_struct_entry(file, struct))
+    end
+
+    for index, macro in ipairs(declarations["macros"]) do
+        table.insert(entries, nvim_cpp.make_macro_entry(file, macro))
+    end
+
+    return file_cache
+end
+
+-- the server ranks the matches, so the picker never holds more than `limit` symbols
+function nvim_cpp.find_symbols(query, limit, kinds)
+    if nvim_cpp.channel_id == nil then
+        return {}
+    end
+    local matches = vim.fn.rpcrequest(nvim_cpp.channel_id, "FindSymbols", query or "", limit or 100, kinds or {})
+    local entries = {}
+    for index, match in ipairs(matches) do
+        local kind = match["kind"]
+        if kind == "function" then
+            table.insert(entries, nvim_cpp.make_function_entry(match["file"], match["declaration"]))
+        elseif kind == "struct" then
+            table.insert(entries, nvim_cpp.make_struct_entry(match["file"], match["declaration"]))
+        else
+            table.insert(entries, nvim_cpp.make_macro_entry(match["file"], match["declaration"]))
+        end
+    end
+    return entries
+end
+
 function nvim_cpp.get_declarations()
     if nvim_cpp.channel_id == nil then
         return {}
     end
-    local result = vim.fn.rpcrequest(nvim_cpp.channel_id, "GetDeclarations")
-    local updated = result[1]
+    -- the server only sends files that changed since the generation we pass, 0 asks for everything.
+    -- generations restart with the server, a different epoch gets everything too
+    local result = vim.fn.rpcrequest(nvim_cpp.channel_id, "GetDeclarations", nvim_cpp.generation or 0, nvim_cpp.epoch)
+    return nvim_cpp.apply_declarations(result)
+end
 
-    if updated then
-        local files = result[2]
-        local functions_cache = {}
-        local entries = {}
-        for file, declarations in pairs(files) do
-            local functions = declarations["functions"]
-            local structs = declarations["structs"]
-            local macros = declarations["macros"]
-
-            for index, funct in ipairs(functions) do
-                local entry = {}
-                entry["bufnr"] = vim.uri_to_bufnr(file)
-                entry["path"] = file
-                entry["lnum"] = funct["line"]
-                entry["symbol_type"] = "function"
-
-                entry["type_length"] = #funct["return_type"]
-                entry["name_length"] = #funct["name"]
-                local display = funct["return_type"] .. " " .. funct["name"] .. "( "
-
-                local arguments = funct["arguments"]
-                entry["args"] = {}
-                for index, arg in ipairs(arguments) do
-                    table.insert(entry["args"], {#arg["type"], #arg["name"]})
-                    display = display .. arg["type"] .. " " .. arg["name"]
-                    if index == #arguments then
-                        display = display .. " )"
-                    else
-                        display = display .. ", "
-                    end
-                end
-
-                if arguments == nil or #arguments == 0 then
-                        display = display .. " )"
-                end
-                entry["ordinal"] = display
-
-                if functions_cache[funct["name"]] == nil then
-                    functions_cache[funct["name"]] = {display}
-                else
-                    table.insert(functions_cache[funct["name"]], display)
-                end
-                
-                table.insert(entries, entry)
-            end
+-- merges a GetDeclarations response or a declarations_changed notification into the cache
+function nvim_cpp.apply_declarations(result)
+    if result["full"] then
+        nvim_cpp.file_cache = {}
+    end
+    local file_cache = nvim_cpp.file_cache or {}
+    local updated = result["full"]
 
-            for index, struct in ipairs(structs) do
-                local entry = {}
-                entry["bufnr"] = vim.uri_to_bufnr(file)
-                entry["path"] = file
-                entry["lnum"] = struct["line"]
-                entry["symbol_type"] = "struct"
-                entry["struct_type"] = struct["type"]
-                entry["ordinal"] = struct["type"] .. " " .. struct["name"]
+    for file, declarations in pairs(result["files"]) do
+        file_cache[file] = nvim_cpp.create_file_entries(file, declarations)
+        updated = true
+    end
 
-                table.insert(entries, entry)
-            end
+    for index, file in ipairs(result["removed"]) do
+        file_cache[file] = nil
+        updated = true
+    end
 
-            for index, macro in ipairs(macros) do
-                local entry = {}
-                entry["bufnr"] = vim.uri_to_bufnr(file)
-                entry["path"] = file
-                entry["lnum"] = macro["line"]
-                entry["symbol_type"] = "macro"
-                entry["ordinal"] = macro["name"]
+    nvim_cpp.file_cache = file_cache
+    nvim_cpp.generation = result["generation"]
+    nvim_cpp.epoch = result["epoch"]
 
+    if updated or nvim_cpp.declaration_entry_cache == nil then
+        local entries = {}
+        for file, cache in pairs(file_cache) do
+            for index, entry in ipairs(cache["entries"]) do
                 table.insert(entries, entry)
             end
         end
-        nvim_cpp.functions_cache = functions_cache
         nvim_cpp.declaration_entry_cache = entries
-        return entries
-    else
-        return nvim_cpp.declaration_entry_cache or {}
     end
+
+    return nvim_cpp.declaration_entry_cache
 end
 
 function nvim_cpp.create_declaration_entry(entry)
@@ -186,12 +241,12 @@ function nvim_cpp.show_declarations_picker(opts)
     {
         prompt_title = "Find symbol",
         previewer = nvim_cpp.previewer,
-        finder = finders.new_table(
+        finder = finders.new_dynamic(
         {
-            results = nvim_cpp.get_declarations(),
+            fn = function(prompt) return nvim_cpp.find_symbols(prompt, opts.limit, opts.kinds) end,
             entry_maker = nvim_cpp.create_declaration_entry
         }),
-        sorter = conf.generic_sorter(opts),
+        sorter = sorters.highlighter_only(opts),
         attach_mappings = function(prompt_bufnr, map)
             actions.select_default:replace(function()
                 nvim_cpp.default_declaration_action(prompt_bufnr, map)
@@ -202,49 +257,77 @@ function nvim_cpp.show_declarations_picker(opts)
     picker:find()
 end
 
+local compile_notify_config = {render = "minimal", stages = "fade", fps = 60 }
+
 function nvim_cpp.compile()
     if nvim_cpp.channel_id == nil then
         return {}
     end
-    -- print("Compilation started")
-    -- vim.api.nvim_echo({{"Compilation started", "None" }}, false, {})
-    local notify_config = {render = "minimal", stages = "fade", fps = 60 }
+    -- the server answers right away, diagnostics and the result arrive as notifications
     local result = vim.fn.rpcrequest(nvim_cpp.channel_id, "Compile")
 
-    local started = result["started"]
-    local messages = result["messages"] or {}
-    
-    if started and #messages > 0 then
-        local entries = {}
-        for index, message in ipairs(messages) do
-            local entry = {}
-            -- entry["bufnr"] = vim.uri_to_bufnr("E:\\Projects\\nvim-cpp\\main.cpp")
-            entry["filename"] = message["filename"] or ""
-            entry["lnum"] = message["lnum"] or 1
-            entry["col"] = message["col"] or 1
-            entry["nr"] = message["nr"] or ""
-            entry["text"] = message["text"]
-            entry["type"] = message["type"]
-            table.insert(entries, entry)
-        end
-        -- print(vim.inspect(entries))
-        notify("Compilation failed", "error", notify_config)
-        vim.fn.setqflist(entries, "r")
-        vim.api.nvim_command("bot copen")
-        -- vim.api.nvim_command("wincmd p")
-    elseif started and #messages == 0 then
-        -- print("Compilation successful")
-        -- vim.api.nvim_echo({{"Compilation successful", "None"}}, false, {})
-        notify("Compilation successful", "info", notify_config)
-        vim.api.nvim_command("cclose")
+    if result["started"] then
+        nvim_cpp.build_id = result["id"]
+        vim.fn.setqflist({}, "r")
+        notify("Compilation started", "info", compile_notify_config)
+    elseif result["running"] then
+        notify("Compilation already running", "warn", compile_notify_config)
     else
-        -- print("Compilation failed")
-        -- vim.api.nvim_echo({{"Compilation failed", "None"}}, false, {})
-        notify("Compilation failed", "error", notify_config)
+        notify("Compilation failed", "error", compile_notify_config)
         vim.api.nvim_command("cclose")
     end
 end
 
+function nvim_cpp.on_compile_diagnostics(payload)
+    if payload["id"] ~= nvim_cpp.build_id then
+        return
+    end
+    local entries = {}
+    for index, message in ipairs(payload["messages"]) do
+        local entry = {}
+        entry["filename"] = message["filename"] or ""
+        entry["lnum"] = message["lnum"] or 1
+        entry["col"] = message["col"] or 1
+        entry["nr"] = message["nr"] or ""
+        entry["text"] = message["text"]
+        entry["type"] = message["type"]
+        table.insert(entries, entry)
+    end
+    vim.fn.setqflist(entries, "a")
+end
+
+function nvim_cpp.on_compile_finished(payload)
+    if payload["id"] ~= nvim_cpp.build_id then
+        return
+    end
+    if payload["exit_code"] == 0 and payload["errors"] == 0 then
+        notify("Compilation successful", "info", compile_notify_config)
+        if payload["warnings"] > 0 then
+            vim.api.nvim_command("bot copen")
+        else
+            vim.api.nvim_command("cclose")
+        end
+    else
+        notify("Compilation failed", "error", compile_notify_config)
+        vim.api.nvim_command("bot copen")
+    end
+end
+
+local notification_handlers =
+{
+    compile_diagnostics = nvim_cpp.on_compile_diagnostics,
+    compile_finished = nvim_cpp.on_compile_finished,
+    declarations_changed = nvim_cpp.apply_declarations,
+}
+
+-- the server pushes events by calling this through nvim_exec_lua
+function nvim_cpp.on_notification(event, payload)
+    local handler = notification_handlers[event]
+    if handler ~= nil then
+        vim.schedule(function() handler(payload) end)
+    end
+end
+
 function nvim_cpp.signature_help()
     local opts = 
     {
@@ -287,15 +370,68 @@ function nvim_cpp.signature_help()
     
     local word = line:sub(word_start, word_end)
     -- print(word)
-    local function_name = nvim_cpp.functions_cache[word]
-    if function_name ~= nil then
-        local fbuf, fwin = vim.lsp.util.open_floating_preview(function_name, '', opts)
+    if nvim_cpp.channel_id == nil then
+        return
+    end
+    local signatures = vim.fn.rpcrequest(nvim_cpp.channel_id, "GetSignature", word)
+    if #signatures > 0 then
+        local fbuf, fwin = vim.lsp.util.open_floating_preview(signatures, '', opts)
         -- vim.api.nvim_buf_add_highlight(fbuf, -1, "TelescopePreviewBlock", 0, 2, 4 )
         putils.highlighter(fbuf, "cpp", {})
     end
 
 end
 
+-- jumps straight to a single declaration, more than one goes to the quickfix list
+function nvim_cpp.go_to_definition()
+    if nvim_cpp.channel_id == nil then
+        return
+    end
+    local word = vim.fn.expand("<cword>")
+    local sites = vim.fn.rpcrequest(nvim_cpp.channel_id, "GoToDefinition", word)
+    if #sites == 0 then
+        notify("No declaration of " .. word, "warn")
+    elseif #sites == 1 then
+        vim.api.nvim_command("edit " .. vim.fn.fnameescape(sites[1]["file"]))
+        vim.api.nvim_win_set_cursor(0, {sites[1]["line"], 0})
+    else
+        local items = {}
+        for index, site in ipairs(sites) do
+            table.insert(items, {filename = site["file"], lnum = site["line"], text = site["kind"] .. " " .. word})
+        end
+        vim.fn.setqflist({}, " ", {title = "GoToDefinition " .. word, items = items})
+        vim.api.nvim_command("bot copen")
+    end
+end
+
+-- per phase timings of the server, in microseconds
+function nvim_cpp.show_stats()
+    if nvim_cpp.channel_id == nil then
+        return
+    end
+    local stats = vim.fn.rpcrequest(nvim_cpp.channel_id, "GetStats")
+    local lines = {string.format("%-16s %10s %10s %10s %10s", "phase", "count", "p50", "p99", "max")}
+    for name, phase in pairs(stats["phases"]) do
+        if phase["count"] > 0 then
+            table.insert(lines, string.format("%-16s %10d %10.1f %10.1f %10.1f", name, phase["count"],
+                phase["p50_ns"] / 1000, phase["p99_ns"] / 1000, phase["max_ns"] / 1000))
+        end
+    end
+    for name, value in pairs(stats["counters"]) do
+        table.insert(lines, name .. ": " .. value)
+    end
+    print(table.concat(lines, "\n"))
+end
+
+-- several queries in one round trip, e.g. {{"GetSignature", {"Foo"}}, {"GetFileDeclarations", {file}}},
+-- the results come back in the same order
+function nvim_cpp.batch(requests)
+    if nvim_cpp.channel_id == nil then
+        return {}
+    end
+    return vim.fn.rpcrequest(nvim_cpp.channel_id, "BatchRequest", requests)
+end
+
 function nvim_cpp.exit()
     if nvim_cpp.channel_id ~= nil then
         result = vim.fn.rpcrequest(nvim_cpp.channel_id, "Exit")
@@ -304,6 +440,7 @@ function nvim_cpp.exit()
     end
 end
 
+_G.NvimCpp = nvim_cpp
 nvim_cpp.setup()
 
 return nvim_cpp
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <float.h>
+#include <string.h>
 
 #define global_variable static
 #define local_persist   static
@@ -14,8 +15,8 @@ typedef int16_t s16;
 typedef uint16_t u16;
 typedef int32_t s32;
 typedef uint32_t u32;
-typedef int64_t s64;
-typedef uint64_t u64;
+typedef long long s64;
+typedef unsigned long long u64;
 
 typedef float f32;
 typedef double f64;
@@ -53,6 +54,12 @@ typedef size_t memory_index;
 
 #define ArrayCount( array ) ( ( int ) ( sizeof( array ) / sizeof( ( array )[ 0 ] ) ) )
 
+struct String
+{
+    u32 length;
+    char *content;
+};
+
 inline u32 SafeTruncateU64( u64 value )
 {
     Assert( value <= 0xFFFFFFFF );
@@ -82,3 +89,147 @@ inline int StringLength( char *string ) //NOLINT
     }
     return length;
 }
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+inline u64 RotateLeft64( u64 value, u32 shift )
+{
+    return ( value << shift ) | ( value >> ( 64 - shift ) );
+}
+
+inline u64 ReadU64( u8 *at )
+{
+    u64 result;
+    memcpy( &result, at, sizeof( result ) );
+    return result;
+}
+
+inline u32 ReadU32( u8 *at )
+{
+    u32 result;
+    memcpy( &result, at, sizeof( result ) );
+    return result;
+}
+
+inline u64 XXH64Round( u64 accumulator, u64 input )
+{
+    accumulator += input * XXH_PRIME64_2;
+    accumulator = RotateLeft64( accumulator, 31 );
+    accumulator *= XXH_PRIME64_1;
+    return accumulator;
+}
+
+inline u64 XXH64MergeRound( u64 accumulator, u64 value )
+{
+    accumulator ^= XXH64Round( 0, value );
+    accumulator = accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+    return accumulator;
+}
+
+// NOTE: XXH64 with seed 0, four independent lanes over 32 byte stripes so it runs at memory speed
+// instead of the one multiply per byte FNV needs
+inline u64 HashBytes( void *data, memory_index size )
+{
+    u8 *at = ( u8 * ) data;
+    u8 *end = at + size;
+    u64 result;
+
+    if ( size >= 32 )
+    {
+        u64 lane1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+        u64 lane2 = XXH_PRIME64_2;
+        u64 lane3 = 0;
+        u64 lane4 = 0 - XXH_PRIME64_1;
+        u8 *limit = end - 32;
+        do
+        {
+            lane1 = XXH64Round( lane1, ReadU64( at ) );
+            lane2 = XXH64Round( lane2, ReadU64( at + 8 ) );
+            lane3 = XXH64Round( lane3, ReadU64( at + 16 ) );
+            lane4 = XXH64Round( lane4, ReadU64( at + 24 ) );
+            at += 32;
+        } while ( at <= limit );
+
+        result = RotateLeft64( lane1, 1 ) + RotateLeft64( lane2, 7 ) + RotateLeft64( lane3, 12 ) + RotateLeft64( lane4, 18 );
+        result = XXH64MergeRound( result, lane1 );
+        result = XXH64MergeRound( result, lane2 );
+        result = XXH64MergeRound( result, lane3 );
+        result = XXH64MergeRound( result, lane4 );
+    }
+    else
+    {
+        result = XXH_PRIME64_5;
+    }
+
+    result += ( u64 ) size;
+
+    while ( at + 8 <= end )
+    {
+        result ^= XXH64Round( 0, ReadU64( at ) );
+        result = RotateLeft64( result, 27 ) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        at += 8;
+    }
+
+    if ( at + 4 <= end )
+    {
+        result ^= ( u64 ) ReadU32( at ) * XXH_PRIME64_1;
+        result = RotateLeft64( result, 23 ) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        at += 4;
+    }
+
+    while ( at < end )
+    {
+        result ^= ( *at ) * XXH_PRIME64_5;
+        result = RotateLeft64( result, 11 ) * XXH_PRIME64_1;
+        ++at;
+    }
+
+    result ^= result >> 33;
+    result *= XXH_PRIME64_2;
+    result ^= result >> 29;
+    result *= XXH_PRIME64_3;
+    result ^= result >> 32;
+    return result;
+}
+
+struct Memory_Arena
+{
+    memory_index size;
+    u8 *base;
+    memory_index used;
+
+    s32 tempCount;
+};
+
+inline void InitializeArena( Memory_Arena *arena, memory_index size, void *base )
+{
+    arena->size = size;
+    arena->base = ( u8 * ) base;
+    arena->used = 0;
+
+    arena->tempCount = 0;
+}
+
+#define PushStruct( arena, type )       ( type * ) _PushSize( arena, sizeof( type ) )
+#define PushArray( arena, count, type ) ( type * ) _PushSize( arena, count * sizeof( type ) )
+#define PushString( arena, size )       ( char * ) _PushSize( arena, size )
+#define PushSize( arena, size )         _PushSize( arena, size )
+inline void *_PushSize( Memory_Arena *arena, memory_index size )
+{
+    Assert( arena->used + size <= arena->size );
+    void *result = arena->base + arena->used;
+    arena->used += size;
+    return result;
+}
+
+inline void SubArena( Memory_Arena *result, Memory_Arena *parentArena, memory_index size )
+{
+    result->size = size;
+    result->base = ( u8 * ) PushSize( parentArena, size );
+    result->used = 0;
+    result->tempCount = 0;
+}
@@ -0,0 +1,197 @@
+#define WATCHER_MAX_DIRTY_PATHS 1024
+
+// NOTE: the watcher thread collects changed paths into a dirty set so GetDeclarations only has to
+// reparse those instead of walking and stat'ing the whole tree. If the watcher can't be started,
+// or it loses events, we fall back to the full ParseFiles scan.
+struct File_Watcher
+{
+    u32 volatile lock;
+    bool active;
+    bool needsFullScan;
+
+    u32 dirtyCount;
+    char dirtyPaths[ WATCHER_MAX_DIRTY_PATHS ][ 256 ];
+
+    char directory[ 256 ];
+    Platform_Directory_Watch watch;
+};
+
+internal void MarkPathDirty( File_Watcher *watcher, char *path )
+{
+    AcquireSpinLock( &watcher->lock );
+    bool alreadyDirty = false;
+    for ( u32 dirtyIndex = 0; dirtyIndex < watcher->dirtyCount; ++dirtyIndex )
+    {
+        if ( strcmp( watcher->dirtyPaths[ dirtyIndex ], path ) == 0 )
+        {
+            alreadyDirty = true;
+            break;
+        }
+    }
+
+    if ( !alreadyDirty )
+    {
+        if ( watcher->dirtyCount < WATCHER_MAX_DIRTY_PATHS )
+        {
+            strcpy_s( watcher->dirtyPaths[ watcher->dirtyCount++ ], sizeof( watcher->dirtyPaths[ 0 ] ), path );
+        }
+        else
+        {
+            watcher->needsFullScan = true;
+        }
+    }
+    ReleaseSpinLock( &watcher->lock );
+}
+
+PLATFORM_THREAD_PROC( WatcherThreadProc )
+{
+    File_Watcher *watcher = ( File_Watcher * ) parameter;
+    local_persist Platform_Watch_Event events[ WATCHER_MAX_DIRTY_PATHS ];
+
+    for ( ;; )
+    {
+        u32 eventCount = 0;
+        Platform_Watch_Result result = PlatformWaitForDirectoryChanges( &watcher->watch, events, WATCHER_MAX_DIRTY_PATHS, &eventCount );
+        if ( result == WatchResult_Failed )
+        {
+            printf( "Watching for changes failed: %d, falling back to polling\n", PlatformGetLastError() );
+            AcquireSpinLock( &watcher->lock );
+            watcher->active = false;
+            ReleaseSpinLock( &watcher->lock );
+            return 0;
+        }
+
+        if ( result == WatchResult_Overflow )
+        {
+            AcquireSpinLock( &watcher->lock );
+            watcher->needsFullScan = true;
+            ReleaseSpinLock( &watcher->lock );
+            continue;
+        }
+
+        for ( u32 eventIndex = 0; eventIndex < eventCount; ++eventIndex )
+        {
+            // NOTE: anything that isn't a source file only matters if it could be a directory
+            // appearing or going away, plain modifications of other files are ignored
+            Platform_Watch_Event *event = events + eventIndex;
+            if ( IsSourceFile( event->path ) || !event->contentOnly )
+            {
+                MarkPathDirty( watcher, event->path );
+            }
+        }
+    }
+}
+
+internal void StartFileWatcher( File_Watcher *watcher, char *directory )
+{
+    watcher->lock = 0;
+    strcpy_s( watcher->directory, sizeof( watcher->directory ), directory );
+    watcher->dirtyCount = 0;
+    watcher->needsFullScan = true;
+    watcher->active = false;
+
+    if ( PlatformStartDirectoryWatch( directory, &watcher->watch ) )
+    {
+        watcher->active = true;
+        PlatformStartThread( WatcherThreadProc, watcher );
+    }
+    else
+    {
+        printf( "Failed to watch %s: %d, falling back to polling\n", directory, PlatformGetLastError() );
+    }
+}
+
+// NOTE: true when ParseChangedFiles has something to look at. Without a running watcher every call
+// is a full scan, so nothing is ever reported as pending.
+internal bool WatcherHasChanges( File_Watcher *watcher )
+{
+    AcquireSpinLock( &watcher->lock );
+    bool result = watcher->active && ( watcher->needsFullScan || watcher->dirtyCount > 0 );
+    ReleaseSpinLock( &watcher->lock );
+    return result;
+}
+
+// NOTE: path is a directory that went away or a source file that isn't there anymore
+internal bool RemoveFilesUnder( Parse_State *state, char *path )
+{
+    bool result = false;
+    u32 pathLength = ( u32 ) strlen( path );
+    for ( u32 fileIndex = 0; fileIndex < state->files.count; ++fileIndex )
+    {
+        File_State *file = state->files.states[ fileIndex ];
+        if ( strncmp( file->name, path, pathLength ) == 0 &&
+             ( file->name[ pathLength ] == '\0' || file->name[ pathLength ] == PLATFORM_PATH_SEPARATOR ) &&
+             RemoveFile( state, file ) )
+        {
+            result = true;
+        }
+    }
+    return result;
+}
+
+// NOTE: replaces ParseFiles for GetDeclarations, only the paths the watcher saw change get looked at
+internal bool ParseChangedFiles( Parse_State *state, Memory_Arena *arena, File_Watcher *watcher )
+{
+    local_persist char changedPaths[ WATCHER_MAX_DIRTY_PATHS ][ 256 ];
+
+    AcquireSpinLock( &watcher->lock );
+    bool fullScan = !watcher->active || watcher->needsFullScan;
+    u32 changedCount = 0;
+    if ( fullScan )
+    {
+        watcher->needsFullScan = false;
+    }
+    else
+    {
+        changedCount = watcher->dirtyCount;
+        memcpy( changedPaths, watcher->dirtyPaths, changedCount * sizeof( changedPaths[ 0 ] ) );
+    }
+    watcher->dirtyCount = 0;
+    ReleaseSpinLock( &watcher->lock );
+
+    if ( fullScan )
+    {
+        return ParseFiles( state, arena, watcher->directory );
+    }
+
+    if ( changedCount == 0 )
+    {
+        return false;
+    }
+
+    bool result = false;
+    state->parseList = 0;
+    for ( u32 changedIndex = 0; changedIndex < changedCount; ++changedIndex )
+    {
+        char *path = changedPaths[ changedIndex ];
+        Platform_File_Info info;
+        if ( !PlatformGetFileInfo( path, &info ) )
+        {
+            if ( RemoveFilesUnder( state, path ) )
+            {
+                result = true;
+            }
+        }
+        else if ( info.isDirectory )
+        {
+            // NOTE: a new or renamed directory, pick up whatever is inside it
+            ParseDirectory( state, arena, path );
+        }
+        else if ( IsSourceFile( path ) )
+        {
+            QueueFile( state, arena, path );
+        }
+    }
+
+    if ( PublishParsedFiles( state ) )
+    {
+        result = true;
+    }
+    ReleaseRemovedFiles( state );
+
+    if ( result )
+    {
+        state->generation += 1;
+    }
+    return result;
+}
@@ -0,0 +1,676 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#define PLATFORM_PATH_SEPARATOR   '\\'
+#define PLATFORM_MAX_WAIT_SOCKETS FD_SETSIZE
+#define PLATFORM_BUILD_COMMAND    "build.bat"
+#define PLATFORM_INVALID_SOCKET   INVALID_SOCKET
+#define PLATFORM_ALLOCATION_HEADER 0
+#define PLATFORM_THREAD_PROC( name ) DWORD WINAPI name( LPVOID parameter )
+
+struct Mapped_File
+{
+    char *content;
+    u32 size;
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+};
+
+struct Platform_Directory
+{
+    HANDLE findHandle;
+    WIN32_FIND_DATA findData;
+    // NOTE: FindFirstFile already returns the first entry
+    bool hasEntry;
+    char name[ MAX_PATH ];
+};
+
+struct Platform_Directory_Watch
+{
+    HANDLE directoryHandle;
+    char directory[ 256 ];
+};
+
+struct Platform_Semaphore
+{
+    HANDLE handle;
+};
+
+struct Platform_Process
+{
+    HANDLE process;
+    HANDLE outputPipe;
+};
+
+typedef SOCKET Platform_Socket;
+typedef WSABUF Platform_Send_Buffer;
+
+inline void PlatformSetSendBuffer( Platform_Send_Buffer *buffer, void *data, u32 size )
+{
+    buffer->buf = ( char * ) data;
+    buffer->len = size;
+}
+
+// NOTE: select takes the whole set on every wait, which FD_SETSIZE keeps small anyway
+struct Platform_Socket_Set
+{
+    u32 count;
+    SOCKET sockets[ PLATFORM_MAX_WAIT_SOCKETS ];
+    u32 events[ PLATFORM_MAX_WAIT_SOCKETS ];
+    void *users[ PLATFORM_MAX_WAIT_SOCKETS ];
+};
+
+#include "platform.h"
+
+internal void *PlatformAllocateMemory( memory_index size )
+{
+    return VirtualAlloc( 0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+}
+
+internal void PlatformFreeMemory( void *memory )
+{
+    if ( memory )
+    {
+        VirtualFree( memory, 0, MEM_RELEASE );
+    }
+}
+
+internal u64 PlatformReadTimer()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter( &counter );
+    return ( u64 ) counter.QuadPart;
+}
+
+internal u64 PlatformGetTimerFrequency()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency( &frequency );
+    return ( u64 ) frequency.QuadPart;
+}
+
+internal u32 PlatformGetProcessorCount()
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo( &systemInfo );
+    return systemInfo.dwNumberOfProcessors;
+}
+
+internal bool PlatformStartThread( platform_thread_proc *proc, void *parameter )
+{
+    DWORD threadId;
+    HANDLE threadHandle = CreateThread( 0, 0, proc, parameter, 0, &threadId );
+    if ( !threadHandle )
+    {
+        return false;
+    }
+    CloseHandle( threadHandle );
+    return true;
+}
+
+internal void PlatformCreateSemaphore( Platform_Semaphore *semaphore, u32 maximumCount )
+{
+    semaphore->handle = CreateSemaphoreEx( 0, 0, maximumCount, 0, 0, SEMAPHORE_ALL_ACCESS );
+}
+
+internal void PlatformSignalSemaphore( Platform_Semaphore *semaphore )
+{
+    ReleaseSemaphore( semaphore->handle, 1, 0 );
+}
+
+internal void PlatformWaitSemaphore( Platform_Semaphore *semaphore )
+{
+    WaitForSingleObject( semaphore->handle, INFINITE );
+}
+
+internal void PlatformYieldThread()
+{
+    SwitchToThread();
+}
+
+internal int PlatformGetLastError()
+{
+    return ( int ) GetLastError();
+}
+
+internal void PlatformGetCurrentDirectory( char *buffer, u32 bufferSize )
+{
+    GetCurrentDirectory( bufferSize, buffer );
+}
+
+inline u64 FileTimeToU64( FILETIME time )
+{
+    u64 result = ( ( u64 ) time.dwHighDateTime << 32 ) | time.dwLowDateTime;
+    return result;
+}
+
+internal bool PlatformGetFileInfo( char *path, Platform_File_Info *info )
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if ( !GetFileAttributesEx( path, GetFileExInfoStandard, &data ) )
+    {
+        return false;
+    }
+
+    info->isDirectory = ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+    info->lastWrite = FileTimeToU64( data.ftLastWriteTime );
+    info->size = ( ( u64 ) data.nFileSizeHigh << 32 ) | data.nFileSizeLow;
+    return true;
+}
+
+internal bool MapEntireFile( char *path, Mapped_File *file )
+{
+    *file = {};
+    file->fileHandle = CreateFile( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, 0, 0 );
+    if ( file->fileHandle == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( file->fileHandle, &fileSize ) )
+    {
+        CloseHandle( file->fileHandle );
+        return false;
+    }
+
+    file->size = SafeTruncateU64( fileSize.QuadPart );
+    if ( file->size > 0 )
+    {
+        file->mappingHandle = CreateFileMapping( file->fileHandle, 0, PAGE_READONLY, 0, 0, 0 );
+        if ( file->mappingHandle )
+        {
+            file->content = ( char * ) MapViewOfFile( file->mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+        }
+
+        if ( !file->content )
+        {
+            if ( file->mappingHandle )
+            {
+                CloseHandle( file->mappingHandle );
+            }
+            CloseHandle( file->fileHandle );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+internal void UnmapFile( Mapped_File *file )
+{
+    if ( file->content )
+    {
+        UnmapViewOfFile( file->content );
+        CloseHandle( file->mappingHandle );
+    }
+    CloseHandle( file->fileHandle );
+    *file = {};
+}
+
+internal bool PlatformWriteEntireFile( char *path, void *data, u64 size )
+{
+    HANDLE fileHandle = CreateFile( path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0 );
+    if ( fileHandle == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    DWORD bytesWritten = 0;
+    DWORD totalSize = SafeTruncateU64( size );
+    bool result = WriteFile( fileHandle, data, totalSize, &bytesWritten, 0 ) && bytesWritten == totalSize;
+    CloseHandle( fileHandle );
+    return result;
+}
+
+internal bool PlatformReplaceFile( char *source, char *destination )
+{
+    return MoveFileEx( source, destination, MOVEFILE_REPLACE_EXISTING ) != 0;
+}
+
+internal bool PlatformDeleteFile( char *path )
+{
+    return DeleteFile( path ) != 0;
+}
+
+internal bool PlatformCreateDirectory( char *path )
+{
+    return CreateDirectory( path, 0 ) != 0;
+}
+
+internal bool PlatformOpenDirectory( char *path, Platform_Directory *directory )
+{
+    char pattern[ 256 ];
+    sprintf_s( pattern, sizeof( pattern ), "%s\\*", path );
+    directory->findHandle = FindFirstFile( pattern, &directory->findData );
+    directory->hasEntry = directory->findHandle != INVALID_HANDLE_VALUE;
+    return directory->hasEntry;
+}
+
+internal bool PlatformNextDirectoryEntry( Platform_Directory *directory, Platform_Directory_Entry *entry )
+{
+    while ( directory->hasEntry )
+    {
+        WIN32_FIND_DATA *data = &directory->findData;
+        bool dotEntry = strcmp( data->cFileName, "." ) == 0 || strcmp( data->cFileName, ".." ) == 0;
+        if ( !dotEntry )
+        {
+            // NOTE: findData is overwritten by the read ahead below
+            strcpy_s( directory->name, sizeof( directory->name ), data->cFileName );
+            entry->name = directory->name;
+            entry->isDirectory = ( data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+        }
+
+        directory->hasEntry = FindNextFile( directory->findHandle, data ) != 0;
+        if ( !dotEntry )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+internal void PlatformCloseDirectory( Platform_Directory *directory )
+{
+    if ( directory->findHandle != INVALID_HANDLE_VALUE )
+    {
+        FindClose( directory->findHandle );
+    }
+    *directory = {};
+}
+
+internal bool PlatformStartDirectoryWatch( char *path, Platform_Directory_Watch *watch )
+{
+    strcpy_s( watch->directory, sizeof( watch->directory ), path );
+    watch->directoryHandle = CreateFile( path, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                         0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0 );
+    return watch->directoryHandle != INVALID_HANDLE_VALUE;
+}
+
+internal Platform_Watch_Result PlatformWaitForDirectoryChanges( Platform_Directory_Watch *watch, Platform_Watch_Event *events,
+                                                                u32 maxEventCount, u32 *eventCount )
+{
+    local_persist DWORD notifyBuffer[ Kilobytes( 16 ) ];
+    *eventCount = 0;
+
+    DWORD bytesReturned = 0;
+    BOOL read = ReadDirectoryChangesW( watch->directoryHandle, notifyBuffer, sizeof( notifyBuffer ), TRUE,
+                                       FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                                       &bytesReturned, 0, 0 );
+    if ( !read )
+    {
+        return WatchResult_Failed;
+    }
+
+    if ( bytesReturned == 0 )
+    {
+        // NOTE: the system buffer overflowed and the events are lost
+        return WatchResult_Overflow;
+    }
+
+    // NOTE: the entries are variable sized, each one says where the next one starts
+    u8 *at = ( u8 * ) notifyBuffer;
+    for ( ;; )
+    {
+        FILE_NOTIFY_INFORMATION *info = ( FILE_NOTIFY_INFORMATION * ) at;
+
+        char name[ 256 ];
+        int nameLength = WideCharToMultiByte( CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof( WCHAR ),
+                                              name, sizeof( name ) - 1, 0, 0 );
+        name[ nameLength ] = '\0';
+
+        if ( nameLength > 0 )
+        {
+            if ( *eventCount == maxEventCount )
+            {
+                return WatchResult_Overflow;
+            }
+
+            Platform_Watch_Event *event = events + ( *eventCount )++;
+            sprintf_s( event->path, sizeof( event->path ), "%s\\%s", watch->directory, name );
+            event->contentOnly = info->Action == FILE_ACTION_MODIFIED;
+        }
+
+        if ( !info->NextEntryOffset )
+        {
+            break;
+        }
+        at += info->NextEntryOffset;
+    }
+
+    return WatchResult_Events;
+}
+
+internal bool PlatformStartProcess( char *commandLine, Platform_Process *process )
+{
+    SECURITY_ATTRIBUTES pipeAttributes = {};
+    pipeAttributes.nLength = sizeof( pipeAttributes );
+    pipeAttributes.bInheritHandle = TRUE;
+
+    HANDLE readPipe = 0;
+    HANDLE writePipe = 0;
+    if ( !CreatePipe( &readPipe, &writePipe, &pipeAttributes, 0 ) )
+    {
+        printf( "CreatePipe failed: %d\n", GetLastError() );
+        return false;
+    }
+    SetHandleInformation( readPipe, HANDLE_FLAG_INHERIT, 0 );
+
+    STARTUPINFO startInfo = {};
+    startInfo.cb = sizeof( startInfo );
+    startInfo.dwFlags = STARTF_USESTDHANDLES;
+    startInfo.hStdInput = 0;
+    startInfo.hStdOutput = writePipe;
+    startInfo.hStdError = writePipe;
+
+    PROCESS_INFORMATION processInfo = {};
+    char shellCommand[ 512 ];
+    sprintf_s( shellCommand, sizeof( shellCommand ), "cmd.exe /c %s", commandLine );
+    bool started = CreateProcess( 0, shellCommand, 0, 0, TRUE, CREATE_NO_WINDOW, 0, 0, &startInfo, &processInfo ) != 0;
+
+    // NOTE: only the child may hold the write end, otherwise the pipe never breaks
+    CloseHandle( writePipe );
+    if ( started )
+    {
+        CloseHandle( processInfo.hThread );
+        process->process = processInfo.hProcess;
+        process->outputPipe = readPipe;
+    }
+    else
+    {
+        printf( "CreateProcess failed: %d\n", GetLastError() );
+        CloseHandle( readPipe );
+    }
+    return started;
+}
+
+internal int PlatformReadProcessOutput( Platform_Process *process, void *buffer, u32 bufferSize )
+{
+    // NOTE: pipes don't do non-blocking reads, so we only read what's already there
+    DWORD available = 0;
+    if ( !PeekNamedPipe( process->outputPipe, 0, 0, 0, &available, 0 ) )
+    {
+        // NOTE: the pipe breaks once the process and everything it started have exited
+        return -1;
+    }
+    if ( available == 0 )
+    {
+        return 0;
+    }
+
+    DWORD bytesToRead = available < bufferSize ? available : bufferSize;
+    DWORD bytesRead = 0;
+    if ( !ReadFile( process->outputPipe, buffer, bytesToRead, &bytesRead, 0 ) || bytesRead == 0 )
+    {
+        return -1;
+    }
+    return ( int ) bytesRead;
+}
+
+internal u32 PlatformFinishProcess( Platform_Process *process )
+{
+    WaitForSingleObject( process->process, INFINITE );
+    DWORD exitCode = 0;
+    GetExitCodeProcess( process->process, &exitCode );
+    CloseHandle( process->process );
+    CloseHandle( process->outputPipe );
+    *process = {};
+    return exitCode;
+}
+
+internal bool PlatformInitializeSockets()
+{
+    WSADATA wsaData;
+    int result = WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+    if ( result != 0 )
+    {
+        printf( "WSAStartup failed: %d\n", result );
+        return false;
+    }
+    return true;
+}
+
+internal void PlatformShutdownSockets()
+{
+    WSACleanup();
+}
+
+internal int PlatformGetSocketError()
+{
+    return WSAGetLastError();
+}
+
+internal Platform_Socket PlatformListen( char *port )
+{
+    addrinfo *info;
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+
+    int result = getaddrinfo( 0, port, &hints, &info );
+    if ( result != 0 )
+    {
+        printf( "getaddrinfo failed %d\n", result );
+        return INVALID_SOCKET;
+    }
+
+    SOCKET listenSocket = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+    if ( listenSocket == INVALID_SOCKET )
+    {
+        printf( "Socket creation failed: %d\n", WSAGetLastError() );
+        freeaddrinfo( info );
+        return INVALID_SOCKET;
+    }
+
+    result = bind( listenSocket, info->ai_addr, ( int ) info->ai_addrlen );
+    freeaddrinfo( info );
+    if ( result == SOCKET_ERROR )
+    {
+        printf( "bind failed: %d\n", WSAGetLastError() );
+        closesocket( listenSocket );
+        return INVALID_SOCKET;
+    }
+
+    if ( listen( listenSocket, SOMAXCONN ) == SOCKET_ERROR )
+    {
+        printf( "Listen failed: %d\n", WSAGetLastError() );
+        closesocket( listenSocket );
+        return INVALID_SOCKET;
+    }
+
+    u_long nonBlocking = 1;
+    ioctlsocket( listenSocket, FIONBIO, &nonBlocking );
+    return listenSocket;
+}
+
+internal Platform_Socket PlatformAccept( Platform_Socket listenSocket )
+{
+    // NOTE: accepted sockets inherit non-blocking from the listening socket
+    SOCKET result = accept( listenSocket, 0, 0 );
+    return result;
+}
+
+internal Platform_Socket PlatformConnect( char *host, char *port )
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo *info = 0;
+    SOCKET result = INVALID_SOCKET;
+    if ( getaddrinfo( host, port, &hints, &info ) == 0 )
+    {
+        result = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+        if ( result != INVALID_SOCKET && connect( result, info->ai_addr, ( int ) info->ai_addrlen ) == SOCKET_ERROR )
+        {
+            closesocket( result );
+            result = INVALID_SOCKET;
+        }
+        freeaddrinfo( info );
+    }
+    return result;
+}
+
+internal void PlatformCloseSocket( Platform_Socket socket )
+{
+    closesocket( socket );
+}
+
+internal void PlatformShutdownSocket( Platform_Socket socket )
+{
+    shutdown( socket, SD_SEND );
+}
+
+internal int PlatformReceive( Platform_Socket socket, void *buffer, u32 bufferSize )
+{
+    return recv( socket, ( char * ) buffer, ( int ) bufferSize, 0 );
+}
+
+internal bool PlatformSend( Platform_Socket socket, void *data, u32 size )
+{
+    u32 sent = 0;
+    while ( sent < size )
+    {
+        int result = send( socket, ( char * ) data + sent, ( int ) ( size - sent ), 0 );
+        if ( result == SOCKET_ERROR )
+        {
+            return false;
+        }
+        sent += ( u32 ) result;
+    }
+    return true;
+}
+
+internal bool PlatformSendGathered( Platform_Socket socket, Platform_Send_Buffer *buffers, u32 bufferCount, u32 *bytesSent )
+{
+    DWORD sent = 0;
+    if ( WSASend( socket, buffers, bufferCount, &sent, 0, 0, 0 ) == SOCKET_ERROR )
+    {
+        *bytesSent = 0;
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+    }
+    *bytesSent = sent;
+    return true;
+}
+
+inline u32 FindSelectSocket( Platform_Socket_Set *set, Platform_Socket socket )
+{
+    u32 result = 0;
+    while ( result < set->count && set->sockets[ result ] != socket )
+    {
+        ++result;
+    }
+    return result;
+}
+
+internal bool PlatformCreateSocketSet( Platform_Socket_Set *set )
+{
+    set->count = 0;
+    return true;
+}
+
+internal void PlatformDestroySocketSet( Platform_Socket_Set *set )
+{
+    set->count = 0;
+}
+
+internal bool PlatformAddSocket( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events )
+{
+    if ( set->count == PLATFORM_MAX_WAIT_SOCKETS )
+    {
+        return false;
+    }
+    set->sockets[ set->count ] = socket;
+    set->events[ set->count ] = events;
+    set->users[ set->count ] = user;
+    set->count += 1;
+    return true;
+}
+
+internal bool PlatformChangeSocketEvents( Platform_Socket_Set *set, Platform_Socket socket, void *user, u32 events )
+{
+    u32 socketIndex = FindSelectSocket( set, socket );
+    if ( socketIndex == set->count )
+    {
+        return false;
+    }
+    set->events[ socketIndex ] = events;
+    set->users[ socketIndex ] = user;
+    return true;
+}
+
+internal void PlatformRemoveSocket( Platform_Socket_Set *set, Platform_Socket socket )
+{
+    u32 socketIndex = FindSelectSocket( set, socket );
+    if ( socketIndex < set->count )
+    {
+        set->count -= 1;
+        set->sockets[ socketIndex ] = set->sockets[ set->count ];
+        set->events[ socketIndex ] = set->events[ set->count ];
+        set->users[ socketIndex ] = set->users[ set->count ];
+    }
+}
+
+internal int PlatformWaitForSocketEvents( Platform_Socket_Set *set, Platform_Socket_Event *events, u32 maxEventCount,
+                                          int timeoutMilliseconds )
+{
+    // NOTE: select fails on an empty set instead of just waiting
+    if ( set->count == 0 )
+    {
+        Sleep( timeoutMilliseconds < 0 ? INFINITE : ( DWORD ) timeoutMilliseconds );
+        return 0;
+    }
+
+    // NOTE: a failed connect or send shows up in the except set, hung up sockets are readable
+    fd_set readSet;
+    fd_set writeSet;
+    fd_set exceptSet;
+    FD_ZERO( &readSet );
+    FD_ZERO( &writeSet );
+    FD_ZERO( &exceptSet );
+    for ( u32 socketIndex = 0; socketIndex < set->count; ++socketIndex )
+    {
+        if ( set->events[ socketIndex ] & SocketEvent_Read )
+        {
+            FD_SET( set->sockets[ socketIndex ], &readSet );
+        }
+        if ( set->events[ socketIndex ] & SocketEvent_Write )
+        {
+            FD_SET( set->sockets[ socketIndex ], &writeSet );
+        }
+        FD_SET( set->sockets[ socketIndex ], &exceptSet );
+    }
+
+    timeval timeout = { timeoutMilliseconds / 1000, ( timeoutMilliseconds % 1000 ) * 1000 };
+    if ( select( 0, &readSet, &writeSet, &exceptSet, timeoutMilliseconds < 0 ? 0 : &timeout ) == SOCKET_ERROR )
+    {
+        return -1;
+    }
+
+    u32 eventCount = 0;
+    for ( u32 socketIndex = 0; socketIndex < set->count && eventCount < maxEventCount; ++socketIndex )
+    {
+        SOCKET socket = set->sockets[ socketIndex ];
+        bool failed = FD_ISSET( socket, &exceptSet ) != 0;
+        u32 readyEvents = 0;
+        if ( failed || FD_ISSET( socket, &readSet ) )
+        {
+            readyEvents |= SocketEvent_Read;
+        }
+        if ( failed || FD_ISSET( socket, &writeSet ) )
+        {
+            readyEvents |= SocketEvent_Write;
+        }
+        if ( readyEvents )
+        {
+            events[ eventCount ].user = set->users[ socketIndex ];
+            events[ eventCount ].events = readyEvents;
+            eventCount += 1;
+        }
+    }
+    return ( int ) eventCount;
+}
@@ -0,0 +1,149 @@
+#define SPIN_LOCK_MAX_PAUSES 64
+
+// NOTE: waits twice as long each time it finds the lock taken, and past SPIN_LOCK_MAX_PAUSES gives
+// the core away instead. With more threads than cores the holder may not be running at all, and
+// spinning would only keep it from getting the core back to release the lock.
+inline void AcquireSpinLock( u32 volatile *lock )
+{
+    u32 pauseCount = 1;
+    while ( *lock || AtomicCompareExchangeU32( lock, 1, 0 ) != 0 )
+    {
+        if ( pauseCount <= SPIN_LOCK_MAX_PAUSES )
+        {
+            for ( u32 pauseIndex = 0; pauseIndex < pauseCount; ++pauseIndex )
+            {
+                SpinPause();
+            }
+            pauseCount *= 2;
+        }
+        else
+        {
+            PlatformYieldThread();
+        }
+    }
+}
+
+inline void ReleaseSpinLock( u32 volatile *lock )
+{
+    AtomicExchangeU32( lock, 0 );
+}
+
+struct Work_Queue;
+#define WORK_QUEUE_CALLBACK( name ) void name( Work_Queue *queue, void *data )
+typedef WORK_QUEUE_CALLBACK( work_queue_callback );
+
+struct Work_Queue_Entry
+{
+    work_queue_callback *callback;
+    void *data;
+};
+
+struct Work_Queue
+{
+    u32 volatile completionGoal;
+    u32 volatile completionCount;
+
+    u32 volatile nextEntryToWrite;
+    u32 volatile nextEntryToRead;
+    Platform_Semaphore semaphore;
+    // NOTE: signaled when an entry completes the goal, CompleteAllWork sleeps on it once there is
+    // nothing left for it to pick up
+    Platform_Semaphore completionSemaphore;
+
+    u32 threadCount;
+    Work_Queue_Entry entries[ 1024 ];
+};
+
+// NOTE: returns true when there was nothing to do so the caller can go to sleep
+internal bool DoNextWorkQueueEntry( Work_Queue *queue )
+{
+    bool shouldSleep = false;
+
+    u32 originalNextEntryToRead = queue->nextEntryToRead;
+    u32 newNextEntryToRead = ( originalNextEntryToRead + 1 ) % ArrayCount( queue->entries );
+    if ( originalNextEntryToRead != queue->nextEntryToWrite )
+    {
+        u32 index = AtomicCompareExchangeU32( &queue->nextEntryToRead, newNextEntryToRead, originalNextEntryToRead );
+        if ( index == originalNextEntryToRead )
+        {
+            Work_Queue_Entry entry = queue->entries[ index ];
+            entry.callback( queue, entry.data );
+            if ( AtomicAddU32( &queue->completionCount, 1 ) + 1 == queue->completionGoal )
+            {
+                PlatformSignalSemaphore( &queue->completionSemaphore );
+            }
+        }
+    }
+    else
+    {
+        shouldSleep = true;
+    }
+
+    return shouldSleep;
+}
+
+internal void AddWorkQueueEntry( Work_Queue *queue, work_queue_callback *callback, void *data )
+{
+    u32 newNextEntryToWrite = ( queue->nextEntryToWrite + 1 ) % ArrayCount( queue->entries );
+    while ( newNextEntryToWrite == queue->nextEntryToRead )
+    {
+        // NOTE: queue is full, help the workers drain it instead of waiting
+        DoNextWorkQueueEntry( queue );
+    }
+
+    Work_Queue_Entry *entry = queue->entries + queue->nextEntryToWrite;
+    entry->callback = callback;
+    entry->data = data;
+    ++queue->completionGoal;
+
+    CompletePreviousWritesBeforeFutureWrites();
+    queue->nextEntryToWrite = newNextEntryToWrite;
+    PlatformSignalSemaphore( &queue->semaphore );
+}
+
+// NOTE: the semaphore can be left signaled from an earlier batch, or by a worker that completed
+// everything added so far while more was still being added. Waking up for it only costs another
+// look at the queue.
+internal void CompleteAllWork( Work_Queue *queue )
+{
+    while ( queue->completionGoal != queue->completionCount )
+    {
+        if ( DoNextWorkQueueEntry( queue ) )
+        {
+            PlatformWaitSemaphore( &queue->completionSemaphore );
+        }
+    }
+
+    queue->completionGoal = 0;
+    queue->completionCount = 0;
+}
+
+PLATFORM_THREAD_PROC( WorkQueueThreadProc )
+{
+    Work_Queue *queue = ( Work_Queue * ) parameter;
+    for ( ;; )
+    {
+        if ( DoNextWorkQueueEntry( queue ) )
+        {
+            PlatformWaitSemaphore( &queue->semaphore );
+        }
+    }
+}
+
+// NOTE: the thread that calls CompleteAllWork also does work, so threadCount 0 means everything
+// runs on the caller
+internal void InitializeWorkQueue( Work_Queue *queue, u32 threadCount )
+{
+    queue->completionGoal = 0;
+    queue->completionCount = 0;
+    queue->nextEntryToWrite = 0;
+    queue->nextEntryToRead = 0;
+    queue->threadCount = threadCount;
+
+    PlatformCreateSemaphore( &queue->semaphore, threadCount + 1 );
+    PlatformCreateSemaphore( &queue->completionSemaphore, 1 );
+    for ( u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+    {
+        PlatformStartThread( WorkQueueThreadProc, queue );
+    }
+}
@@ -0,0 +1,251 @@
+// NOTE: writes a synthetic source tree for the benchmark. Everything comes out of a fixed seed, so
+// the same settings always produce the same files and runs on different versions parse the same
+// input. The files only have to look like C++ to our parser, they are never compiled.
+
+struct Workspace_Config
+{
+    u32 fileCount;
+    // NOTE: average bytes per file, each file is within a quarter of it
+    u32 fileSize;
+    // NOTE: declarations per kilobyte of source, the rest is function bodies and comments
+    u32 declarationDensity;
+    // NOTE: share of the headers, in percent, that are almost nothing but macros
+    u32 macroHeaderPercent;
+    // NOTE: directory levels under the root, every level fans out four ways
+    u32 directoryDepth;
+    // NOTE: how deep the blocks inside generated function bodies go
+    u32 blockNesting;
+    u32 seed;
+};
+
+struct Workspace_Summary
+{
+    u32 fileCount;
+    u32 directoryCount;
+    u64 totalBytes;
+    u64 declarationCount;
+};
+
+struct Text_Buffer
+{
+    char *base;
+    u32 size;
+    u32 used;
+};
+
+struct Random_Series
+{
+    u64 state;
+};
+
+inline u32 NextRandom( Random_Series *series )
+{
+    // NOTE: xorshift64*, plenty for picking shapes of declarations
+    series->state ^= series->state >> 12;
+    series->state ^= series->state << 25;
+    series->state ^= series->state >> 27;
+    return ( u32 ) ( ( series->state * 0x2545F4914F6CDD1Dull ) >> 32 );
+}
+
+inline u32 RandomBetween( Random_Series *series, u32 min, u32 max )
+{
+    return min + NextRandom( series ) % ( max - min + 1 );
+}
+
+internal void Append( Text_Buffer *buffer, char *format, ... )
+{
+    va_list arguments;
+    va_start( arguments, format );
+    int written = vsnprintf( buffer->base + buffer->used, buffer->size - buffer->used, format, arguments );
+    va_end( arguments );
+
+    if ( written > 0 && buffer->used + ( u32 ) written < buffer->size )
+    {
+        buffer->used += ( u32 ) written;
+    }
+    else
+    {
+        // NOTE: out of room, drop the partial write and leave the file a bit shorter
+        buffer->base[ buffer->used ] = '\0';
+    }
+}
+
+global_variable char *GeneratedBaseTypes[] =
+{
+    "int", "u32", "u64", "float", "f64", "bool", "char *", "void *", "String", "Memory_Arena *",
+};
+
+inline char *PickType( Random_Series *series, char ( *structNames )[ 64 ], u32 structCount, char *scratch, u32 scratchSize )
+{
+    char *result = GeneratedBaseTypes[ NextRandom( series ) % ArrayCount( GeneratedBaseTypes ) ];
+    if ( structCount > 0 && NextRandom( series ) % 3 == 0 )
+    {
+        snprintf( scratch, scratchSize, "%s *", structNames[ NextRandom( series ) % structCount ] );
+        result = scratch;
+    }
+    return result;
+}
+
+internal void AppendBlock( Text_Buffer *buffer, Random_Series *series, u32 depth, u32 maxDepth )
+{
+    u32 statementCount = RandomBetween( series, 1, 4 );
+    for ( u32 statementIndex = 0; statementIndex < statementCount; ++statementIndex )
+    {
+        Append( buffer, "%*sresult += value%u * %u;\n", ( depth + 1 ) * 4, "", NextRandom( series ) % 4, NextRandom( series ) % 100 );
+    }
+
+    if ( depth < maxDepth )
+    {
+        Append( buffer, "%*sif ( result > %u )\n%*s{\n", ( depth + 1 ) * 4, "", NextRandom( series ) % 1000, ( depth + 1 ) * 4, "" );
+        AppendBlock( buffer, series, depth + 1, maxDepth );
+        Append( buffer, "%*s}\n", ( depth + 1 ) * 4, "" );
+    }
+}
+
+// NOTE: one translation unit or header, returns how many declarations went into it
+internal u32 GenerateSourceFile( Text_Buffer *buffer, Random_Series *series, Workspace_Config *config, u32 fileIndex, bool header, bool macroHeavy )
+{
+    local_persist char structNames[ 256 ][ 64 ];
+    u32 structCount = 0;
+    u32 declarationCount = 0;
+    char typeScratch[ 96 ];
+
+    buffer->used = 0;
+    u32 targetSize = config->fileSize * 3 / 4 + NextRandom( series ) % ( config->fileSize / 2 + 1 );
+    u32 bytesPerDeclaration = 1024 / ( config->declarationDensity ? config->declarationDensity : 1 );
+
+    if ( header )
+    {
+        Append( buffer, "#pragma once\n\n" );
+    }
+    else
+    {
+        Append( buffer, "#include \"file%u.h\"\n\n", fileIndex ^ 1 );
+    }
+
+    while ( buffer->used < targetSize && buffer->used + Kilobytes( 4 ) < buffer->size )
+    {
+        u32 startUsed = buffer->used;
+        u32 shape = macroHeavy ? 0 : NextRandom( series ) % 10;
+        u32 declarationIndex = declarationCount++;
+
+        if ( shape < 2 )
+        {
+            // NOTE: macros, some of them continued over several lines
+            u32 continuationCount = macroHeavy ? NextRandom( series ) % 4 : 0;
+            Append( buffer, "#define MACRO_%u_%u( x ) \\\n", fileIndex, declarationIndex );
+            for ( u32 lineIndex = 0; lineIndex < continuationCount; ++lineIndex )
+            {
+                Append( buffer, "    ( ( x ) * %u + %u ) + \\\n", NextRandom( series ) % 64, lineIndex );
+            }
+            Append( buffer, "    ( x )\n" );
+        }
+        else if ( shape < 5 )
+        {
+            char *keyword = ( char * ) ( NextRandom( series ) % 8 == 0 ? "union" : "struct" );
+            char *name = structNames[ structCount % ArrayCount( structNames ) ];
+            snprintf( name, sizeof( structNames[ 0 ] ), "Struct_%u_%u", fileIndex, declarationIndex );
+            structCount = structCount < ArrayCount( structNames ) ? structCount + 1 : structCount;
+
+            Append( buffer, "%s %s\n{\n", keyword, name );
+            u32 fieldCount = RandomBetween( series, 1, 8 );
+            for ( u32 fieldIndex = 0; fieldIndex < fieldCount; ++fieldIndex )
+            {
+                Append( buffer, "    %s field%u;\n", PickType( series, structNames, structCount - 1, typeScratch, sizeof( typeScratch ) ), fieldIndex );
+            }
+            Append( buffer, "};\n\n" );
+        }
+        else if ( shape < 6 )
+        {
+            Append( buffer, "enum Enum_%u_%u\n{\n", fileIndex, declarationIndex );
+            u32 valueCount = RandomBetween( series, 2, 10 );
+            for ( u32 valueIndex = 0; valueIndex < valueCount; ++valueIndex )
+            {
+                Append( buffer, "    Enum_%u_%u_Value%u,\n", fileIndex, declarationIndex, valueIndex );
+            }
+            Append( buffer, "};\n\n" );
+        }
+        else
+        {
+            // NOTE: every so often a name that exists in many files, GoToDefinition has to list them all
+            char name[ 64 ];
+            if ( NextRandom( series ) % 16 == 0 )
+            {
+                snprintf( name, sizeof( name ), "SharedFunction%u", NextRandom( series ) % 32 );
+            }
+            else
+            {
+                snprintf( name, sizeof( name ), "Function_%u_%u", fileIndex, declarationIndex );
+            }
+
+            Append( buffer, "internal %s %s(", PickType( series, structNames, structCount, typeScratch, sizeof( typeScratch ) ), name );
+            u32 argumentCount = RandomBetween( series, 0, 4 );
+            for ( u32 argumentIndex = 0; argumentIndex < argumentCount; ++argumentIndex )
+            {
+                Append( buffer, "%s %s value%u", argumentIndex ? "," : "", PickType( series, structNames, structCount, typeScratch, sizeof( typeScratch ) ), argumentIndex );
+            }
+            Append( buffer, ( char * ) ( argumentCount ? " )\n{\n    u32 result = 0;\n" : ")\n{\n    u32 result = 0;\n" ) );
+            AppendBlock( buffer, series, 0, config->blockNesting );
+            Append( buffer, "    return result;\n}\n\n" );
+        }
+
+        // NOTE: comments pad each declaration out to the density asked for
+        while ( buffer->used - startUsed < bytesPerDeclaration && buffer->used < targetSize && buffer->used + 256 < buffer->size )
+        {
+            Append( buffer, "// NOTE: filler comment %u, the tokenizer still has to walk over every byte of it\n", NextRandom( series ) );
+        }
+    }
+
+    return declarationCount;
+}
+
+// NOTE: file i goes to root/dA/dB/... where every level takes the next two bits of i, so the files
+// spread evenly over 4^depth leaf directories
+internal bool GenerateWorkspace( char *root, Workspace_Config *config, Workspace_Summary *summary )
+{
+    *summary = {};
+    Random_Series series = { config->seed ? config->seed : 0x1234567u };
+
+    Text_Buffer buffer = {};
+    buffer.size = config->fileSize * 2 + Kilobytes( 16 );
+    buffer.base = ( char * ) PlatformAllocateMemory( buffer.size );
+    if ( !buffer.base )
+    {
+        return false;
+    }
+
+    PlatformCreateDirectory( root );
+    bool result = true;
+    for ( u32 fileIndex = 0; fileIndex < config->fileCount && result; ++fileIndex )
+    {
+        char path[ 256 ];
+        u32 pathLength = ( u32 ) snprintf( path, sizeof( path ), "%s", root );
+        for ( u32 level = 0; level < config->directoryDepth; ++level )
+        {
+            pathLength += ( u32 ) snprintf( path + pathLength, sizeof( path ) - pathLength, "%cd%u", PLATFORM_PATH_SEPARATOR, ( fileIndex >> ( 2 * level ) ) & 3 );
+            if ( PlatformCreateDirectory( path ) )
+            {
+                summary->directoryCount += 1;
+            }
+        }
+
+        bool header = ( fileIndex & 1 ) == 0;
+        bool macroHeavy = header && NextRandom( &series ) % 100 < config->macroHeaderPercent;
+        summary->declarationCount += GenerateSourceFile( &buffer, &series, config, fileIndex, header, macroHeavy );
+
+        snprintf( path + pathLength, sizeof( path ) - pathLength, "%cfile%u.%s", PLATFORM_PATH_SEPARATOR, fileIndex, header ? "h" : "cpp" );
+        if ( PlatformWriteEntireFile( path, buffer.base, buffer.used ) )
+        {
+            summary->fileCount += 1;
+            summary->totalBytes += buffer.used;
+        }
+        else
+        {
+            printf( "Failed to write %s\n", path );
+            result = false;
+        }
+    }
+
+    PlatformFreeMemory( buffer.base );
+    return result;
+}